@@ -0,0 +1,10 @@
+// Drawing into an offscreen Graphics buffer
+var g = Graphics.createArrayBuffer(128,64,1);
+for (i=0;i<20;i++) {
+  g.clear();
+  g.drawRect(i,i,127-i,63-i);
+  g.fillRect(10,10,10+i,20);
+  g.drawLine(0,0,127,i*3);
+  g.drawCircle(64,32,i);
+  g.drawString("Frame "+i,20,40);
+}
@@ -0,0 +1,7 @@
+// JSON.stringify and JSON.parse of a medium-sized object
+var o = { name : "sensor", readings : [], meta : { unit : "C", ok : true } };
+for (i=0;i<50;i++) o.readings.push({ t : i*1000, v : Math.sin(i)*20, tag : "r"+i });
+for (i=0;i<10;i++) {
+  var s = JSON.stringify(o);
+  var p = JSON.parse(s);
+}
@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+
+# This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+#
+# Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+#
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+#
+# ----------------------------------------------------------------------------------------
+# Run the benchmarks in this directory on the Linux build of Espruino (no
+# device needed), and output the results as JSON. Results can be compared
+# against a previous run to spot performance regressions.
+#
+# For each benchmark this reports:
+#   time         - time taken to run the benchmark code (ms, from getTime())
+#   wall         - wall-clock time for the whole process, including startup (ms)
+#   instructions - instructions executed by the process (if 'perf' works, otherwise null)
+#   usage        - memory in use after the benchmark (blocks, from process.memory())
+#   peak         - the most memory in use at once while running (blocks)
+#   gcs          - number of full garbage collections while running
+#
+# Times are the median of --repeat runs, everything else is from the first run.
+#
+# USAGE:
+#   make                                      # build ./espruino for Linux
+#   benchmark/linux_benchmark.py -o base.json # save a baseline
+#   ... make changes, rebuild ...
+#   benchmark/linux_benchmark.py --compare base.json
+# ----------------------------------------------------------------------------------------
+
+import argparse
+import glob
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+BENCHMARK_DIR = os.path.dirname(os.path.abspath(__file__))
+MARKER_START = "<<<<<"
+MARKER_END = ">>>>>"
+
+# Code wrapped around each benchmark. process.memory() runs a GC (which is
+# counted in 'gccount') and resets the memory peak
+WRAPPER_START = "var ___m=process.memory();var ___start=getTime();{\n"
+WRAPPER_END = ("\n}var ___end=getTime();var ___m2=process.memory();"
+               "print('"+MARKER_START[0]+"'+'"+MARKER_START[1:]+"',JSON.stringify({"
+               "time:(___end-___start)*1000,usage:___m2.usage,peak:___m2.peak,"
+               "gcs:___m2.gccount-___m.gccount-1}),'"+MARKER_END[0]+"'+'"+MARKER_END[1:]+"');\n")
+
+def perf_works():
+  if not shutil.which("perf"): return False
+  try:
+    r = subprocess.run(["perf", "stat", "-x,", "-e", "instructions:u", "true"],
+                       stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, timeout=10)
+  except Exception:
+    return False
+  return r.returncode==0 and b"<not" not in r.stderr
+
+def run_once(binary, jsfile, workdir, use_perf, timeout):
+  cmd = [binary, jsfile]
+  perf_out = os.path.join(workdir, "perf.txt")
+  if use_perf:
+    cmd = ["perf", "stat", "-x,", "-e", "instructions:u", "-o", perf_out, "--"] + cmd
+  start = time.time()
+  # Run in a temporary directory so Storage's espruino.flash doesn't pollute the tree
+  r = subprocess.run(cmd, cwd=workdir, stdin=subprocess.DEVNULL,
+                     stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=timeout)
+  wall = (time.time()-start)*1000
+  out = r.stdout.decode("utf-8", "replace")
+  if MARKER_START not in out or MARKER_END not in out:
+    return None, out
+  result = json.loads(out[out.find(MARKER_START)+len(MARKER_START):out.find(MARKER_END)])
+  result["wall"] = wall
+  result["instructions"] = None
+  if use_perf and os.path.exists(perf_out):
+    for line in open(perf_out):
+      fields = line.strip().split(",")
+      if len(fields)>2 and fields[2].startswith("instructions") and fields[0].isdigit():
+        result["instructions"] = int(fields[0])
+  return result, out
+
+def median(values):
+  values = sorted(values)
+  return values[len(values)//2]
+
+def run_benchmark(binary, filename, repeat, use_perf, timeout):
+  workdir = tempfile.mkdtemp(prefix="espruino_bench_")
+  try:
+    jsfile = os.path.join(workdir, "benchmark.js")
+    with open(jsfile, "w") as f:
+      f.write(WRAPPER_START + open(filename).read() + WRAPPER_END)
+    runs = []
+    for i in range(repeat):
+      result, out = run_once(binary, jsfile, workdir, use_perf, timeout)
+      if result is None:
+        sys.stderr.write("FAILED: "+filename+"\n"+out+"\n")
+        return None
+      runs.append(result)
+    result = runs[0]
+    result["time"] = median([r["time"] for r in runs])
+    result["wall"] = median([r["wall"] for r in runs])
+    return result
+  finally:
+    shutil.rmtree(workdir, ignore_errors=True)
+
+def compare(baseline, results, threshold):
+  """ Print a comparison with the baseline, return True if anything got worse by more than threshold % """
+  regressed = False
+  print("%-20s %-12s %14s %14s %8s" % ("benchmark", "metric", "baseline", "now", "change"))
+  for name in sorted(results):
+    if name not in baseline["results"]: continue
+    old = baseline["results"][name]
+    new = results[name]
+    for metric in ["time", "instructions", "peak", "gcs"]:
+      if old.get(metric) is None or new.get(metric) is None: continue
+      if old[metric]==0:
+        change = 0 if new[metric]==0 else 100
+      else:
+        change = (new[metric]-old[metric])*100.0/old[metric]
+      flag = ""
+      # tiny times are too noisy to compare
+      if change>threshold and not (metric=="time" and old[metric]<5):
+        flag = " REGRESSION"
+        regressed = True
+      print("%-20s %-12s %14.2f %14.2f %+7.1f%%%s" % (name, metric, old[metric], new[metric], change, flag))
+  return regressed
+
+def main():
+  parser = argparse.ArgumentParser(description="Run Espruino benchmarks on the Linux build")
+  parser.add_argument("files", nargs="*", help="Benchmarks to run (default: all benchmark/*.js)")
+  parser.add_argument("-b", "--binary", default=os.path.join(BENCHMARK_DIR, "..", "espruino"),
+                      help="Espruino binary to use (default: ./espruino)")
+  parser.add_argument("-r", "--repeat", type=int, default=3, help="How many times to run each benchmark")
+  parser.add_argument("-o", "--output", help="Write the results to this JSON file (default: stdout)")
+  parser.add_argument("-c", "--compare", help="Compare the results with this JSON file from an earlier run")
+  parser.add_argument("-t", "--threshold", type=float, default=5, help="%% change counted as a regression when comparing")
+  parser.add_argument("--timeout", type=float, default=120, help="Seconds to allow each run")
+  parser.add_argument("--no-perf", action="store_true", help="Don't count instructions with 'perf'")
+  args = parser.parse_args()
+
+  binary = os.path.abspath(args.binary)
+  if not os.path.exists(binary):
+    sys.stderr.write("Espruino binary "+binary+" not found - build it with 'make' first\n")
+    return 1
+  files = args.files or sorted(glob.glob(os.path.join(BENCHMARK_DIR, "*.js")))
+  use_perf = not args.no_perf and perf_works()
+
+  results = {}
+  failed = False
+  for filename in files:
+    name = os.path.basename(filename)
+    sys.stderr.write("Running "+name+"...\n")
+    result = run_benchmark(binary, filename, args.repeat, use_perf, args.timeout)
+    if result is None:
+      failed = True
+    else:
+      results[name] = result
+
+  output = { "binary" : binary, "repeat" : args.repeat, "results" : results }
+  if args.output:
+    with open(args.output, "w") as f:
+      json.dump(output, f, indent=2, sort_keys=True)
+  elif not args.compare:
+    print(json.dumps(output, indent=2, sort_keys=True))
+
+  if args.compare:
+    if compare(json.load(open(args.compare)), results, args.threshold):
+      failed = True
+  return 1 if failed else 0
+
+if __name__ == "__main__":
+  sys.exit(main())
@@ -0,0 +1,9 @@
+// Regular expression matching and replacing
+var lines = [];
+for (i=0;i<50;i++) lines.push("GPS,"+i+",51."+i+"N,0.1"+i+"W,fix="+(i&3));
+var n = 0;
+for (i=0;i<lines.length;i++) {
+  var m = lines[i].match(/GPS,(\d+),([\d.]+)N,([\d.]+)W/);
+  if (m) n += parseInt(m[1]);
+  lines[i] = lines[i].replace(/fix=\d/, "fix=?");
+}
@@ -0,0 +1,9 @@
+// Writing, reading and erasing files in Storage
+var s = require("Storage");
+var data = "";
+for (i=0;i<64;i++) data += String.fromCharCode(65+(i%26));
+for (i=0;i<20;i++) s.write("bench"+i, data);
+for (i=0;i<20;i++) s.read("bench"+i).length;
+s.list(/^bench/).length;
+for (i=0;i<20;i++) s.erase("bench"+i);
+s.compact();
@@ -18,6 +18,7 @@ info = {
  'name' : "Normal Linux Compile",
  'default_console' : "EV_USBSERIAL",
  'variables' :  0, # 0 = resizable variables, rather than fixed
+ 'io_buffer_size' : 1024, # bigger IO queue so bursts of input aren't lost
  'binary_name' : 'espruino',
  'build' : {
    'libraries' : [
@@ -34,6 +35,22 @@ info = {
 #     'CFLAGS+=-m32', 'LDFLAGS+=-m32', 'DEFINES+=-DUSE_CALLFUNCTION_HACK', # For testing 32 bit builds
      'DEFINES+=-DUSE_FONT_6X8 -DGRAPHICS_PALETTED_IMAGES -DGRAPHICS_ANTIALIAS',
      'DEFINES+=-DSPIFLASH_BASE=0 -DSPIFLASH_LENGTH=FLASH_SAVED_CODE_LENGTH', # For Testing Flash Strings
+     'DEFINES+=-DESPR_FUNCTION_TOKEN_CACHE=16', # Keep tokenised code for the last 16 functions called
+     'DEFINES+=-DJSVAR_HASH_INDEX_THRESHOLD=32', # Build a hash index of child names for large objects
+     'DEFINES+=-DJSVAR_ARRAY_INDEX_THRESHOLD=32', # Index the elements of large arrays
+     'DEFINES+=-DJSPARSE_LOOKUP_CACHE_SIZE=64', # Cache lookups of built-in methods
+     'DEFINES+=-DJSVAR_GC_IDLE_SLICE=256', # Idle garbage collection gives way to incoming events
+     'DEFINES+=-DJSVAR_NURSERY_SIZE=512', # Allocate new variables from a nursery that is garbage collected on its own
+     'DEFINES+=-DJSVAR_STRING_TAIL_CACHE_SIZE=8', # Remember where long strings end, so appending is quick
+     'DEFINES+=-DESPR_STORAGE_INDEX_SIZE=1024', # Keep an index of where files are in Storage
+     'DEFINES+=-DESPR_STORAGE_IDLE_COMPACT=4', # Compact Storage a few pages at a time when idle if it's getting full
+     'DEFINES+=-DESPR_STORAGEFILE_CACHE_SIZE=8', # Remember where the last few StorageFiles end
+     'DEFINES+=-DESPR_VARIMAGE_BLOCK_SIZE=4096', # save() in blocks, only writing what changed
+     'DEFINES+=-DESPR_FLASH_STRING_CACHE=16', # Cache flash when reading Flash Strings
+     'DEFINES+=-DESPR_STORAGE_STATS=256', # Count flash erases/writes and file lookups for Storage.getStats
+     'DEFINES+=-DESPR_TIMER_HEAP_SIZE=256', # Keep timers sorted in a heap so the idle loop doesn't scan them all
+     'DEFINES+=-DESPR_WATCH_INDEX_SIZE=64', # Index watches by pin so each edge doesn't scan them all
+     'DEFINES+=-DESPR_IO_STATS=1', # Count events lost from the IO queue and how full the queues get, for E.getIOStats
      'LINUX=1',
    ]
  }
@@ -362,17 +362,24 @@ else:
 
 if 'util_timer_tasks' in board.info:
   bufferSizeTimer = board.info['util_timer_tasks']
-
-codeOut("#define IOBUFFERMASK "+str(bufferSizeIO-1)+" // (max 255) amount of items in event buffer - events take 5 bytes each")
-codeOut("#define TXBUFFERMASK "+str(bufferSizeTX-1)+" // (max 255) amount of items in the transmit buffer - 2 bytes each")
+if 'io_buffer_size' in board.info:
+  bufferSizeIO = board.info['io_buffer_size']
+if 'tx_buffer_size' in board.info:
+  bufferSizeTX = board.info['tx_buffer_size']
+for size in [bufferSizeIO, bufferSizeTX]:
+  if size<2 or size>65536 or (size & (size-1))!=0:
+    die("IO/TX buffer sizes must be a power of 2 between 2 and 65536, got "+str(size))
+
+codeOut("#define IOBUFFERMASK "+str(bufferSizeIO-1)+" // amount of items in event buffer (power of 2, minus 1) - events take 5 bytes each")
+codeOut("#define TXBUFFERMASK "+str(bufferSizeTX-1)+" // amount of items in the transmit buffer (power of 2, minus 1) - 2 bytes each")
 codeOut("#define UTILTIMERTASK_TASKS ("+str(bufferSizeTimer)+") // Must be power of 2 - and max 256")
 
 codeOut("");
 
 codeOut("// When to send the message that the IO buffer is getting full")
-codeOut("#define IOBUFFER_XOFF ((TXBUFFERMASK)*"+str(xoff_thresh)+"/8)")
+codeOut("#define IOBUFFER_XOFF ((IOBUFFERMASK)*"+str(xoff_thresh)+"/8)")
 codeOut("// When to send the message that we can start receiving again")
-codeOut("#define IOBUFFER_XON ((TXBUFFERMASK)*"+str(xon_thresh)+"/8)")
+codeOut("#define IOBUFFER_XON ((IOBUFFERMASK)*"+str(xon_thresh)+"/8)")
 
 codeOut("");
 
@@ -43,6 +43,13 @@ typedef struct {
   unsigned char data; //!< data to transmit
 } PACKED_FLAGS TxBufferItem;
 
+/// Index into txBuffer - 16 bits if the buffer is bigger than 256 items
+#if TXBUFFERMASK>255
+typedef uint16_t TxBufferIdx;
+#else
+typedef unsigned char TxBufferIdx;
+#endif
+
 /**
  * An array of items to transmit.
  */
@@ -51,7 +58,7 @@ volatile TxBufferItem txBuffer[TXBUFFERMASK+1];
 /**
  * The head and tail of the list.
  */
-volatile unsigned char txHead=0, txTail=0;
+volatile TxBufferIdx txHead=0, txTail=0;
 
 typedef enum {
   SDS_NONE,
@@ -73,8 +80,29 @@ Pin jshSerialDeviceCTSPins[JSHSERIALDEVICESTATUSES];
 
 // ----------------------------------------------------------------------------
 //                                                              IO EVENT BUFFER
+/// Index into ioBuffer - 16 bits if the buffer is bigger than 256 items
+#if IOBUFFERMASK>255
+typedef uint16_t IOBufferIdx;
+#else
+typedef unsigned char IOBufferIdx;
+#endif
 volatile IOEvent ioBuffer[IOBUFFERMASK+1];
-volatile unsigned char ioHead=0, ioTail=0;
+volatile IOBufferIdx ioHead=0, ioTail=0;
+
+#if ESPR_IO_STATS
+/// For each device, how many events (or characters, for serial data) were lost because ioBuffer was full
+volatile uint32_t ioDropped[EV_TYPE_MASK+1];
+/// The most items ioBuffer has had in it
+volatile IOBufferIdx ioHighWater;
+/// The most items txBuffer has had in it
+volatile TxBufferIdx txHighWater;
+
+/// Update txHighWater after txHead has moved on
+static void jshTxUpdateHighWater() {
+  TxBufferIdx used = (TxBufferIdx)((txHead - txTail) & TXBUFFERMASK);
+  if (used > txHighWater) txHighWater = used;
+}
+#endif
 
 // ----------------------------------------------------------------------------
 
@@ -169,6 +197,41 @@ void jshResetDevices() {
 
 // ----------------------------------------------------------------------------
 
+/**
+ * Wait for there to be space in the transmit buffer. Returns the device
+ * that should now be written to (which may have changed if we were printing
+ * to EV_LIMBO), or EV_NONE if we can't wait (eg. we're in an IRQ).
+ */
+static IOEventFlags jshTransmitWaitForSpace(IOEventFlags device) {
+  jsiSetBusy(BUSY_TRANSMIT, true);
+  bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
+  while (((txHead+1)&TXBUFFERMASK)==txTail) {
+    // wait for send to finish as buffer is about to overflow
+    if (jshIsInInterrupt()) {
+      // if we're printing from an IRQ, don't wait - it's unlikely TX will ever finish
+      jsErrorFlags |= JSERR_BUFFER_FULL;
+      jsiSetBusy(BUSY_TRANSMIT, false);
+      return EV_NONE;
+    }
+    jshBusyIdle();
+#ifdef USB
+    // just in case USB was unplugged while we were waiting!
+    if (!jshIsUSBSERIALConnected()) jshTransmitClearDevice(EV_USBSERIAL);
+#endif
+  }
+  if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
+    /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
+    Basically we must have printed a bunch of stuff to LIMBO and blocked
+    with our output buffer full. But then jsiOneSecondAfterStartup
+    switches to the right console device and swaps everything we wrote
+    over to that device too. Only we're now here, still writing to the
+    old device when really we should be writing to the new one. */
+    device = jsiGetConsoleDevice();
+  }
+  jsiSetBusy(BUSY_TRANSMIT, false);
+  return device;
+}
+
 /**
  * Queue a character for transmission.
  */
@@ -210,8 +273,7 @@ void jshTransmit(
 #endif
 #else // if PC, just put to stdout
   if (device==DEFAULT_CONSOLE_DEVICE) {
-    fputc(data, stdout);
-    fflush(stdout);
+    jshConsoleWrite(&data, 1);
     return;
   }
 #endif
@@ -221,45 +283,88 @@ void jshTransmit(
   // The txHead global points to the current item in the txBuffer.  Since we are adding a new
   // character, we increment the head pointer.   If it has caught up with the tail, then that means
   // we have filled the array backing the list.  What we do next is to wait for space to free up.
-  unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
+  TxBufferIdx txHeadNext = (TxBufferIdx)((txHead+1)&TXBUFFERMASK);
   if (txHeadNext==txTail) {
-    jsiSetBusy(BUSY_TRANSMIT, true);
-    bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
-    while (txHeadNext==txTail) {
-      // wait for send to finish as buffer is about to overflow
-      if (jshIsInInterrupt()) {
-        // if we're printing from an IRQ, don't wait - it's unlikely TX will ever finish
-        jsErrorFlags |= JSERR_BUFFER_FULL;
-        return;
-      }
-      jshBusyIdle();
-#ifdef USB
-      // just in case USB was unplugged while we were waiting!
-      if (!jshIsUSBSERIALConnected()) jshTransmitClearDevice(EV_USBSERIAL);
-#endif
-    }
-    if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
-      /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
-      Basically we must have printed a bunch of stuff to LIMBO and blocked
-      with our output buffer full. But then jsiOneSecondAfterStartup
-      switches to the right console device and swaps everything we wrote
-      over to that device too. Only we're now here, still writing to the
-      old device when really we should be writing to the new one. */
-      device = jsiGetConsoleDevice();
-    }
-    jsiSetBusy(BUSY_TRANSMIT, false);
+    device = jshTransmitWaitForSpace(device);
+    if (device==EV_NONE) return;
   }
   // Save the device and data for the new character to be transmitted.
   txBuffer[txHead].flags = device;
   txBuffer[txHead].data = data;
   txHead = txHeadNext;
+#if ESPR_IO_STATS
+  jshTxUpdateHighWater();
+#endif
 
   jshUSARTKick(device); // set up interrupts if required
 }
 
+/**
+ * Queue a block of characters for transmission. This is the same as calling
+ * jshTransmit for each character, but it fills as much of txBuffer as it can
+ * in one go and only kicks the hardware once per block rather than per byte.
+ */
+void jshTransmitBuffer(IOEventFlags device, const unsigned char *data, size_t len) {
+  if (device==EV_LOOPBACKA || device==EV_LOOPBACKB
+#ifdef USE_TELNET
+      || device==EV_TELNET
+#endif
+#ifdef USE_TERMINAL
+      || device==EV_TERMINAL
+#endif
+      ) {
+    // these don't go via txBuffer, so just handle them a character at a time
+    while (len--) jshTransmit(device, *(data++));
+    return;
+  }
+#ifndef LINUX
+#ifdef USB
+  if (device==EV_USBSERIAL && !jshIsUSBSERIALConnected()) {
+    jshTransmitClearDevice(EV_USBSERIAL); // clear out stuff already waiting
+    return;
+  }
+#endif
+#ifdef BLUETOOTH
+  if (device==EV_BLUETOOTH && !jsble_has_peripheral_connection()) {
+    jshTransmitClearDevice(EV_BLUETOOTH); // clear out stuff already waiting
+    return;
+  }
+#endif
+#else // if PC, just put to stdout
+  if (device==DEFAULT_CONSOLE_DEVICE) {
+    jshConsoleWrite(data, len);
+    return;
+  }
+#endif
+  if (device==EV_NONE) return;
+
+  while (len) {
+    if (((txHead+1)&TXBUFFERMASK)==txTail) {
+      device = jshTransmitWaitForSpace(device);
+      if (device==EV_NONE) return;
+    }
+    /* txBuffer items hold the device as well as the data so we can't just
+    memcpy, but we can fill all the free space we have with one update of txHead */
+    TxBufferIdx head = txHead;
+    unsigned int space = (unsigned int)((txTail - head - 1) & TXBUFFERMASK);
+    if (space > len) space = (unsigned int)len;
+    len -= space;
+    while (space--) {
+      txBuffer[head].flags = device;
+      txBuffer[head].data = *(data++);
+      head = (TxBufferIdx)((head+1)&TXBUFFERMASK);
+    }
+    txHead = head;
+#if ESPR_IO_STATS
+    jshTxUpdateHighWater();
+#endif
+    jshUSARTKick(device); // set up interrupts if required
+  }
+}
+
 static void jshTransmitPrintfCallback(const char *str, void *user_data) {
   IOEventFlags device = (IOEventFlags)user_data;
-  while (*str) jshTransmit(device, (unsigned char)*(str++));
+  jshTransmitBuffer(device, (const unsigned char *)str, strlen(str));
 }
 
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...) {
@@ -294,24 +399,24 @@ int jshGetCharToTransmit(
     }
   }
 
-  unsigned char tempTail = txTail;
+  TxBufferIdx tempTail = txTail;
   while (txHead != tempTail) {
     if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == device) {
       unsigned char data = txBuffer[tempTail].data;
       if (tempTail != txTail) { // so we weren't right at the back of the queue
         // we need to work back from tempTail (until we hit tail), shifting everything forwards
-        unsigned char this = tempTail;
-        unsigned char last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
+        TxBufferIdx this = tempTail;
+        TxBufferIdx last = (TxBufferIdx)((this+TXBUFFERMASK)&TXBUFFERMASK);
         while (this!=txTail) { // if this==txTail, then last is before it, so stop here
           txBuffer[this] = txBuffer[last];
           this = last;
-          last = (unsigned char)((this+TXBUFFERMASK)&TXBUFFERMASK);
+          last = (TxBufferIdx)((this+TXBUFFERMASK)&TXBUFFERMASK);
         }
       }
-      txTail = (unsigned char)((txTail+1)&TXBUFFERMASK); // advance the tail
+      txTail = (TxBufferIdx)((txTail+1)&TXBUFFERMASK); // advance the tail
       return data; // return data
     }
-    tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+    tempTail = (TxBufferIdx)((tempTail+1)&TXBUFFERMASK);
   }
   return -1; // no data :(
 }
@@ -345,12 +450,12 @@ void jshTransmitMove(IOEventFlags from, IOEventFlags to) {
   } else {
     // Otherwise just rename the contents of the buffer
     jshInterruptOff();
-    unsigned char tempTail = txTail;
+    TxBufferIdx tempTail = txTail;
     while (tempTail != txHead) {
       if (IOEVENTFLAGS_GETTYPE(txBuffer[tempTail].flags) == from) {
         txBuffer[tempTail].flags = (txBuffer[tempTail].flags&~EV_TYPE_MASK) | to;
       }
-      tempTail = (unsigned char)((tempTail+1)&TXBUFFERMASK);
+      tempTail = (TxBufferIdx)((tempTail+1)&TXBUFFERMASK);
     }
     jshInterruptOn();
   }
@@ -380,20 +485,28 @@ void CALLED_FROM_INTERRUPT jshPushEvent(IOEvent *evt) {
    * USB and USART data to be coming in at the same time, and it can trip
    * things up if one IRQ interrupts another. */
   jshInterruptOff();
-  unsigned char nextHead = (unsigned char)((ioHead+1) & IOBUFFERMASK);
+  IOBufferIdx nextHead = (IOBufferIdx)((ioHead+1) & IOBUFFERMASK);
   if (ioTail == nextHead) {
+#if ESPR_IO_STATS
+    IOEventFlags device = IOEVENTFLAGS_GETTYPE(evt->flags);
+    ioDropped[device] += DEVICE_IS_SERIAL(device) ? (uint32_t)IOEVENTFLAGS_GETCHARS(evt->flags) : 1;
+#endif
     jshInterruptOn();
     jshIOEventOverflowed();
     return; // queue full - dump this event!
   }
   ioBuffer[ioHead] = *evt;
   ioHead = nextHead;
+#if ESPR_IO_STATS
+  IOBufferIdx used = (IOBufferIdx)((ioHead - ioTail) & IOBUFFERMASK);
+  if (used > ioHighWater) ioHighWater = used;
+#endif
   jshInterruptOn();
 }
 
 /// Attempt to push characters onto an existing event
 static bool jshPushIOCharEventAppend(IOEventFlags channel, char charData) {
-  unsigned char lastHead = (unsigned char)((ioHead+IOBUFFERMASK) & IOBUFFERMASK); // one behind head
+  IOBufferIdx lastHead = (IOBufferIdx)((ioHead+IOBUFFERMASK) & IOBUFFERMASK); // one behind head
   if (ioHead!=ioTail && lastHead!=ioTail) {
     // we can do this because we only read in main loop, and we're in an interrupt here
     if (IOEVENTFLAGS_GETTYPE(ioBuffer[lastHead].flags) == channel) {
@@ -503,7 +616,7 @@ void CALLED_FROM_INTERRUPT jshPushIOEvent(
 bool jshPopIOEvent(IOEvent *result) {
   if (ioHead==ioTail) return false;
   *result = ioBuffer[ioTail];
-  ioTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+  ioTail = (IOBufferIdx)((ioTail+1) & IOBUFFERMASK);
   return true;
 }
 
@@ -513,7 +626,7 @@ bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
   if (IOEVENTFLAGS_GETTYPE(ioBuffer[ioTail].flags) == eventType)
     return jshPopIOEvent(result);
   // Now check non-top
-  unsigned char i = ioTail;
+  IOBufferIdx i = ioTail;
   while (ioHead!=i) {
     if (IOEVENTFLAGS_GETTYPE(ioBuffer[i].flags) == eventType) {
       /* We need IRQ off for this, because if we get data it's possible
@@ -522,18 +635,18 @@ bool jshPopIOEventOfType(IOEventFlags eventType, IOEvent *result) {
       jshInterruptOff();
       *result = ioBuffer[i];
       // work back and shift all items in out queue
-      unsigned char n = (unsigned char)((i+IOBUFFERMASK) & IOBUFFERMASK);
+      IOBufferIdx n = (IOBufferIdx)((i+IOBUFFERMASK) & IOBUFFERMASK);
       while (n!=ioTail) {
         ioBuffer[i] = ioBuffer[n];
         i = n;
-        n = (unsigned char)((n+IOBUFFERMASK) & IOBUFFERMASK);
+        n = (IOBufferIdx)((n+IOBUFFERMASK) & IOBUFFERMASK);
       }
       // finally update the tail pointer, and return
-      ioTail = (unsigned char)((ioTail+1) & IOBUFFERMASK);
+      ioTail = (IOBufferIdx)((ioTail+1) & IOBUFFERMASK);
       jshInterruptOn();
       return true;
     }
-    i = (unsigned char)((i+1) & IOBUFFERMASK);
+    i = (IOBufferIdx)((i+1) & IOBUFFERMASK);
   }
   return false;
 }
@@ -564,6 +677,47 @@ bool jshHasEventSpaceForChars(int n) {
   return spaceLeft > spacesNeeded;
 }
 
+#ifndef SAVE_ON_FLASH
+/// Return an object containing information about the IO and transmit queues (see E.getIOStats). If reset, counters are reset afterwards
+JsVar *jshGetIOStats(bool reset) {
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  jsvObjectSetChildAndUnLock(obj, "ioSize", jsvNewFromInteger(IOBUFFERMASK+1));
+  jsvObjectSetChildAndUnLock(obj, "ioUsed", jsvNewFromInteger(jshGetEventsUsed()));
+  jsvObjectSetChildAndUnLock(obj, "txSize", jsvNewFromInteger(TXBUFFERMASK+1));
+  jsvObjectSetChildAndUnLock(obj, "txUsed", jsvNewFromInteger((txHead - txTail) & TXBUFFERMASK));
+#if ESPR_IO_STATS
+  jsvObjectSetChildAndUnLock(obj, "ioHighWater", jsvNewFromInteger(ioHighWater));
+  jsvObjectSetChildAndUnLock(obj, "txHighWater", jsvNewFromInteger(txHighWater));
+  JsVar *dropped = jsvNewObject();
+  if (dropped) {
+    unsigned int i;
+    for (i=0;i<=EV_TYPE_MASK;i++) {
+      if (!ioDropped[i]) continue;
+      const char *name = jshGetDeviceString((IOEventFlags)i);
+      if (!name[0]) name = (i>=EV_EXTI0 && i<=EV_EXTI_MAX) ? "EXTI" : "Other";
+      // EXTI channels (and anything else without a name) are added together
+      JsVar *count = jsvObjectGetChild(dropped, name, 0);
+      long long n = (long long)ioDropped[i] + (count ? jsvGetLongInteger(count) : 0);
+      jsvUnLock(count);
+      jsvObjectSetChildAndUnLock(dropped, name, jsvNewFromLongInteger(n));
+    }
+    jsvObjectSetChildAndUnLock(obj, "dropped", dropped);
+  }
+  if (reset) {
+    jshInterruptOff();
+    memset((void*)ioDropped, 0, sizeof(ioDropped));
+    ioHighWater = 0;
+    txHighWater = 0;
+    jshInterruptOn();
+  }
+#else
+  NOT_USED(reset);
+#endif
+  return obj;
+}
+#endif
+
 // ----------------------------------------------------------------------------
 //                                                                      DEVICES
 
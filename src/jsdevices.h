@@ -203,6 +203,11 @@ int jshGetEventsUsed();
 /// Do we have enough space for N characters?
 bool jshHasEventSpaceForChars(int n);
 
+#ifndef SAVE_ON_FLASH
+/// Return an object containing information about the IO and transmit queues (see E.getIOStats). If reset, counters are reset afterwards
+JsVar *jshGetIOStats(bool reset);
+#endif
+
 const char *jshGetDeviceString(IOEventFlags device);
 IOEventFlags jshFromDeviceString(const char *device);
 
@@ -213,6 +218,8 @@ JsVar *jshGetDeviceObject(IOEventFlags device);
 //                                                         DATA TRANSMIT BUFFER
 /// Queue a character for transmission
 void jshTransmit(IOEventFlags device, unsigned char data);
+/// Queue a block of characters for transmission (faster than calling jshTransmit for each one)
+void jshTransmitBuffer(IOEventFlags device, const unsigned char *data, size_t len);
 // Queue a formatted string for transmission
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...);
 /// Wait for transmit to finish
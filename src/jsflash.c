@@ -53,70 +53,197 @@
 
 #define JSF_CACHE_NOT_FOUND 0xFFFFFFFF
 
-#if ESPR_USE_STORAGE_CACHE
+#if ESPR_STORAGE_INDEX_SIZE || ESPR_USE_STORAGE_CACHE
+/// Hash a filename (FNV-1a) to find where it goes in the index/cache
+static uint32_t jsfFileNameHash(JsfFileName *name) {
+  uint32_t h = 2166136261u;
+  for (size_t i=0;i<sizeof(name->c) && name->c[i];i++)
+    h = (h ^ (unsigned char)name->c[i]) * 16777619u;
+  return h;
+}
+#endif
+
+#if ESPR_STORAGE_INDEX_SIZE
+/* An index of where every file in Storage is, kept in RAM. It's built with
+one scan of Storage the first time a file is looked up and then kept up to
+date as files are created and erased, so finding a file (or finding it isn't
+there) doesn't need a scan. Entries are only hints - the header is always
+read back and checked - so a stale entry can't return the wrong file.
+
+Compaction moves files, so it throws the index away and it is rebuilt on
+the next lookup. If there are more files than will fit, we go back to
+scanning until the next time it's rebuilt.
+
+To use this, add '-DESPR_STORAGE_INDEX_SIZE=1024' or some other power of 2
+to the BOARD.py file. Each entry uses 8 bytes of RAM, and up to 3/4 of the
+entries can be used.
+*/
+typedef struct {
+  uint32_t addr; ///< Address as returned by jsfFindFile, or JSF_INDEX_EMPTY/JSF_INDEX_DELETED
+  uint32_t hash; ///< jsfFileNameHash of the filename
+} JsfIndexEntry;
+#define JSF_INDEX_EMPTY 0
+#define JSF_INDEX_DELETED 0xFFFFFFFF
+#define JSF_INDEX_MASK (ESPR_STORAGE_INDEX_SIZE-1)
+
+typedef enum {
+  JSFI_NONE,    ///< Not built yet (or thrown away)
+  JSFI_BUILT,   ///< Built, and contains every file
+  JSFI_TOO_BIG, ///< Too many files to fit in the index
+} JsfIndexState;
+
+JsfIndexEntry jsfIndex[ESPR_STORAGE_INDEX_SIZE];
+uint32_t jsfIndexUsed = 0; ///< Entries that aren't JSF_INDEX_EMPTY
+JsfIndexState jsfIndexState = JSFI_NONE;
+
+static void jsfIndexBuild();
+char jsfStripDriveFromName(JsfFileName *name);
+
+/// Add a file to the index, return false (and give up on the index) if it's too full
+static bool jsfIndexAdd(uint32_t hash, uint32_t addr) {
+  uint32_t i = hash & JSF_INDEX_MASK;
+  while (jsfIndex[i].addr!=JSF_INDEX_EMPTY && jsfIndex[i].addr!=JSF_INDEX_DELETED)
+    i = (i+1) & JSF_INDEX_MASK;
+  if (jsfIndex[i].addr==JSF_INDEX_EMPTY) {
+    if (jsfIndexUsed >= ESPR_STORAGE_INDEX_SIZE*3/4) {
+      jsfIndexState = JSFI_TOO_BIG;
+      return false;
+    }
+    jsfIndexUsed++;
+  }
+  jsfIndex[i].addr = addr;
+  jsfIndex[i].hash = hash;
+  return true;
+}
+
+/// Find the index entry for a file (checking its header in flash), or return -1
+static int jsfIndexFind(JsfFileName *name, JsfFileHeader *returnedHeader) {
+  uint32_t hash = jsfFileNameHash(name);
+  uint32_t i = hash & JSF_INDEX_MASK;
+  while (jsfIndex[i].addr!=JSF_INDEX_EMPTY) {
+    if (jsfIndex[i].hash==hash && jsfIndex[i].addr!=JSF_INDEX_DELETED) {
+      JsfFileHeader header;
+      jshFlashRead(&header, jsfIndex[i].addr-(uint32_t)sizeof(JsfFileHeader), sizeof(JsfFileHeader));
+      if (memcmp(header.name.c, name->c, sizeof(name->c))==0) {
+        if (returnedHeader) *returnedHeader = header;
+        return (int)i;
+      }
+    }
+    i = (i+1) & JSF_INDEX_MASK;
+  }
+  return -1;
+}
+
+static void jsfCacheClear() {
+  jsfIndexState = JSFI_NONE;
+}
+static void jsfCacheClearFile(JsfFileName name) {
+  if (jsfIndexState!=JSFI_BUILT) return;
+  jsfStripDriveFromName(&name);
+  int i = jsfIndexFind(&name, NULL);
+  if (i>=0) jsfIndex[i].addr = JSF_INDEX_DELETED;
+}
+// Find an item in the index - returns JSF_CACHE_NOT_FOUND if there's no index (so we must scan)
+static uint32_t jsfCacheFind(JsfFileName name, JsfFileHeader *returnedHeader) {
+  if (jsfIndexState==JSFI_NONE)
+    jsfIndexBuild();
+  if (jsfIndexState!=JSFI_BUILT)
+    return JSF_CACHE_NOT_FOUND;
+  int i = jsfIndexFind(&name, returnedHeader);
+  if (i>=0) return jsfIndex[i].addr;
+  if (returnedHeader) {
+    memset(returnedHeader, 0, sizeof(JsfFileHeader));
+    returnedHeader->name = name;
+  }
+  return 0; // the index has every file, so it's definitely not there
+}
+static void jsfCachePut(JsfFileHeader *header, uint32_t addr) {
+  if (jsfIndexState==JSFI_BUILT && addr)
+    jsfIndexAdd(jsfFileNameHash(&header->name), addr);
+}
+#elif ESPR_USE_STORAGE_CACHE
 /* Filename lookups can take over 1ms per file even on a reasonably empty SPI Flash memory,
 so we can have a cache of the most used file *addresses* in RAM. The data is still in
-flash but not having to do the search really helps us.
+flash but not having to do the search really helps us. Files that don't exist are
+cached too (with addr=0), as apps often check for files with `read(x)===undefined`.
 
-To use this, add '-DESPR_USE_STORAGE_CACHE=32' or some other number to the BOARD.py file
+Entries are found with a hash of the filename, and a file can be in any of the
+JSF_CACHE_WAYS entries after its hash. Each entry has a score that goes up every time
+it's used. When a new file is added the lowest scoring entry is replaced and the
+others lose a point, so files that are used all the time (like settings.json) stay
+in the cache even when lots of other files are read. jsfListFiles also puts the files
+it goes past into any empty entries.
 
-TODO: we could potentially have some scoring system such that the most used files
-like settings.js are never ever taken out of the cache. Right now reading
-ESPR_USE_STORAGE_CACHE different files will flush out the cache.
+To use this, add '-DESPR_USE_STORAGE_CACHE=32' or some other number to the BOARD.py file
 */
 typedef struct {
-  uint32_t addr; ///< Address as returned by jsfFindFile
+  uint32_t addr; ///< Address as returned by jsfFindFile (0 if the file doesn't exist)
   JsfFileHeader header; ///< The file header
+  uint8_t score; ///< How useful this entry has been. 0 = unused
 } JsfCacheEntry;
+#define JSF_CACHE_WAYS ((ESPR_USE_STORAGE_CACHE<4) ? ESPR_USE_STORAGE_CACHE : 4)
+#define JSF_CACHE_SCORE_MAX 255
+#define JSF_CACHE_SCORE_NEW 2 ///< Score for a file we just looked up
+#define JSF_CACHE_SCORE_LIST 1 ///< Score for a file we found in jsfListFiles
 
 JsfCacheEntry jsfCache[ESPR_USE_STORAGE_CACHE];
-uint8_t jsfCacheEntries = 0;
+
+/// Return the index of the entry for this file, or -1
+static int jsfCacheFindEntry(JsfFileName *name, uint32_t hash) {
+  for (int w=0;w<JSF_CACHE_WAYS;w++) {
+    int i = (int)((hash+(uint32_t)w) % ESPR_USE_STORAGE_CACHE);
+    if (jsfCache[i].score && memcmp(jsfCache[i].header.name.c, name->c, sizeof(name->c))==0)
+      return i;
+  }
+  return -1;
+}
 
 static void jsfCacheClear() {
-  jsfCacheEntries = 0;
+  memset(jsfCache, 0, sizeof(jsfCache));
 }
 static void jsfCacheClearFile(JsfFileName name) {
-  for (int i=0;i<jsfCacheEntries;i++) {
-    if (memcmp(jsfCache[i].header.name.c, name.c, sizeof(name.c))!=0)
-      continue;
-    // if found, shift subsequent files forward over this one
-    for (;i<jsfCacheEntries-1;i++)
-      jsfCache[i] = jsfCache[i+1];
-    // reduce amount of entries
-    jsfCacheEntries--;
-    return;
-  }
+  int i = jsfCacheFindEntry(&name, jsfFileNameHash(&name));
+  if (i>=0) jsfCache[i].score = 0;
 }
 
 // Find an item in the cache - returns JSF_CACHE_NOT_FOUND on failure as it's handy to know about files that don't exist too
 static uint32_t jsfCacheFind(JsfFileName name, JsfFileHeader *returnedHeader) {
-  for (int i=0;i<jsfCacheEntries;i++)
-    if (memcmp(jsfCache[i].header.name.c, name.c, sizeof(name.c))==0) {
-      JsfCacheEntry curr = jsfCache[i];
-      if (i) { // if not at front, put to front
-        // shift others forward
-        for (int j=i-1;j>=0;j--)
-          jsfCache[j+1] = jsfCache[j];
-        // put at front
-        jsfCache[0].header = curr.header;
-        jsfCache[0].addr = curr.addr;
+  int i = jsfCacheFindEntry(&name, jsfFileNameHash(&name));
+  if (i<0) return JSF_CACHE_NOT_FOUND;
+  if (jsfCache[i].score < JSF_CACHE_SCORE_MAX)
+    jsfCache[i].score++;
+  if (returnedHeader)
+    *returnedHeader = jsfCache[i].header;
+  return jsfCache[i].addr;
+}
+/** Add a file to the cache with the given score. If onlyIfFree, only add it if it's already
+ * in the cache or there's an unused entry, otherwise replace the least useful entry */
+static void jsfCacheAdd(JsfFileHeader *header, uint32_t addr, uint8_t score, bool onlyIfFree) {
+  uint32_t hash = jsfFileNameHash(&header->name);
+  int i = jsfCacheFindEntry(&header->name, hash);
+  if (i<0) {
+    for (int w=0;w<JSF_CACHE_WAYS;w++) {
+      int j = (int)((hash+(uint32_t)w) % ESPR_USE_STORAGE_CACHE);
+      if (i<0 || jsfCache[j].score < jsfCache[i].score) i = j;
+    }
+    if (jsfCache[i].score) {
+      if (onlyIfFree) return;
+      // everything else here is now a bit less useful
+      for (int w=0;w<JSF_CACHE_WAYS;w++) {
+        int j = (int)((hash+(uint32_t)w) % ESPR_USE_STORAGE_CACHE);
+        if (jsfCache[j].score>1) jsfCache[j].score--;
       }
-      if (returnedHeader)
-        *returnedHeader = curr.header;
-      return curr.addr;
     }
-
-  return JSF_CACHE_NOT_FOUND;
+    jsfCache[i].score = score;
+  }
+  jsfCache[i].header = *header;
+  jsfCache[i].addr = addr;
 }
 static void jsfCachePut(JsfFileHeader *header, uint32_t addr) {
-  // TODO: ListFiles could lazily fill the list with all
-  // files it finds at the end...
-  if (jsfCacheEntries<ESPR_USE_STORAGE_CACHE)
-    jsfCacheEntries++;
-  for (int i=jsfCacheEntries-2;i>=0;i--)
-    jsfCache[i+1] = jsfCache[i];
-  jsfCache[0].header = *header;
-  jsfCache[0].addr = addr;
+  jsfCacheAdd(header, addr, JSF_CACHE_SCORE_NEW, false);
+}
+static void jsfCachePutFromList(JsfFileHeader *header, uint32_t addr) {
+  jsfCacheAdd(header, addr, JSF_CACHE_SCORE_LIST, true);
 }
 #else // no cache, just stub with code that does nothing
 static void jsfCacheClear() {}
@@ -124,6 +251,9 @@ static void jsfCacheClearFile(JsfFileName name) {}
 static uint32_t jsfCacheFind(JsfFileName name, JsfFileHeader *header) { return JSF_CACHE_NOT_FOUND; }
 static void jsfCachePut(JsfFileHeader *header, uint32_t addr) { }
 #endif
+#if !ESPR_USE_STORAGE_CACHE || ESPR_STORAGE_INDEX_SIZE
+static void jsfCachePutFromList(JsfFileHeader *header, uint32_t addr) { } // the index is built from a scan anyway
+#endif
 
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
@@ -138,6 +268,50 @@ static uint32_t jsfAlignAddress(uint32_t addr) {
   return (addr + (JSF_ALIGNMENT-1)) & (uint32_t)~(JSF_ALIGNMENT-1);
 }
 
+#if ESPR_STORAGE_STATS
+/* Counts of what Storage has done to flash (and how hard it was to find files)
+since startup or the last Storage.getStats(true), to help tune how apps use
+Storage and to estimate how long flash will last */
+typedef struct {
+  uint32_t erases;         ///< Pages erased
+  uint32_t written;        ///< Bytes written (including headers and compaction)
+  uint32_t compactWritten; ///< Bytes written while compacting
+  uint32_t compactions;    ///< Times we compacted a bank (or part of one, from idle)
+  uint32_t lookups;        ///< Calls to jsfFindFile
+  uint32_t cacheHits;      ///< Lookups answered by the index/cache
+  uint32_t scanned;        ///< File headers read while scanning flash for files
+  uint32_t pageErases[ESPR_STORAGE_STATS]; ///< Erases of each page, from the start of Storage
+} JsfStats;
+static JsfStats jsfStats;
+#define JSF_STATS_INC(FIELD, AMOUNT) jsfStats.FIELD += (uint32_t)(AMOUNT)
+#else
+#define JSF_STATS_INC(FIELD, AMOUNT)
+#endif
+
+/* All writes/erases of Storage go through these, so we can keep stats and
+ * make sure Flash Strings don't read old data from the cache */
+static void jsfFlashWrite(void *buf, uint32_t addr, uint32_t len) {
+  jshFlashWrite(buf, addr, len);
+  jsvFlashStringCacheClear();
+  JSF_STATS_INC(written, len);
+}
+static void jsfFlashWriteAligned(void *buf, uint32_t addr, uint32_t len) {
+  jshFlashWriteAligned(buf, addr, len); // clears the Flash String cache
+  JSF_STATS_INC(written, len);
+}
+static void jsfFlashErasePage(uint32_t addr) {
+  jshFlashErasePage(addr);
+  jsvFlashStringCacheClear();
+#if ESPR_STORAGE_STATS
+  jsfStats.erases++;
+  uint32_t pageAddr, pageLen;
+  if (addr>=JSF_START_ADDRESS && jshFlashGetPage(addr, &pageAddr, &pageLen) && pageLen) {
+    uint32_t page = (pageAddr-JSF_START_ADDRESS) / pageLen;
+    if (page < ESPR_STORAGE_STATS) jsfStats.pageErases[page]++;
+  }
+#endif
+}
+
 JsfFileName jsfNameFromString(const char *name) {
   assert(strlen(name)<=sizeof(JsfFileName));
   char nameBuf[sizeof(JsfFileName)+1];
@@ -246,7 +420,7 @@ static bool jsfEraseArea(uint32_t startAddr, uint32_t endAddr) {
     return false;
   while (addr<endAddr && !jspIsInterrupted()) {
     if (!jsfIsErased(addr,len))
-      jshFlashErasePage(addr);
+      jsfFlashErasePage(addr);
     if (!jshFlashGetPage(addr+len, &addr, &len))
       return true;
     // Erasing can take a while, so kick the watchdog throughout
@@ -272,7 +446,7 @@ static void jsfEraseFileInternal(uint32_t addr, JsfFileHeader *header) {
   addr -= (uint32_t)sizeof(JsfFileHeader);
   addr += (uint32_t)((char*)&header->name.firstChars - (char*)header);
   header->name.firstChars = 0;
-  jshFlashWrite(&header->name.firstChars,addr,(uint32_t)sizeof(header->name.firstChars));
+  jsfFlashWrite(&header->name.firstChars,addr,(uint32_t)sizeof(header->name.firstChars));
 }
 
 bool jsfEraseFile(JsfFileName name) {
@@ -410,7 +584,7 @@ static void memcpy_circular(char *dst, uint32_t *dstIndex, uint32_t dstSize, cha
   }
 }
 
-static void jsfCompactWriteBuffer(uint32_t *writeAddress, uint32_t readAddress, char *swapBuffer, uint32_t swapBufferSize, uint32_t *swapBufferUsed, uint32_t *swapBufferTail) {
+static void jsfCompactWriteBuffer(uint32_t *writeAddress, uint32_t readAddress, char *swapBuffer, uint32_t swapBufferSize, uint32_t *swapBufferUsed, uint32_t *swapBufferTail, uint32_t *pagesErased) {
   uint32_t endAddr = jsfGetBankEndAddress(*writeAddress);
   uint32_t nextFlashPage = jsfGetAddressOfNextPage(*writeAddress);
   if (nextFlashPage==0) nextFlashPage=endAddr;
@@ -432,12 +606,14 @@ static void jsfCompactWriteBuffer(uint32_t *writeAddress, uint32_t readAddress,
     uint32_t pAddr, pLen;
     if (jshFlashGetPage(*writeAddress, &pAddr, &pLen) &&  (pAddr == *writeAddress)) {
       jsDebug(DBG_INFO,"compact> erase page 0x%08x\n", *writeAddress);
-      jshFlashErasePage(*writeAddress);
+      jsfFlashErasePage(*writeAddress);
+      (*pagesErased)++;
     }
     assert(jsfIsErased(*writeAddress, s)); 
     //if (!jsfIsErased(*writeAddress, s)) jsiConsolePrintf("ERROR: AREA NOT ERASED 0x%08x => 0x%08x\n", *writeAddress, *writeAddress + s);
     jsDebug(DBG_INFO,"compact> write 0x%08x => 0x%08x\n", *writeAddress, *writeAddress + s);
-    jshFlashWrite(&swapBuffer[*swapBufferTail], *writeAddress, s);
+    jsfFlashWrite(&swapBuffer[*swapBufferTail], *writeAddress, s);
+    JSF_STATS_INC(compactWritten, s);
     *writeAddress += s;
     nextFlashPage = jsfGetAddressOfNextPage(*writeAddress);
     if (nextFlashPage==0) nextFlashPage=endAddr;
@@ -448,18 +624,59 @@ static void jsfCompactWriteBuffer(uint32_t *writeAddress, uint32_t readAddress,
   }
 }
 
-/* Try and compact saved data so it'll fit in Flash again.
+/* If we're compacting and have stopped at a file (readAddress) with nothing
+ * left in the swap buffer, see if we can leave Storage in a valid state here
+ * and carry on later. Everything up to writeAddress has been written, and we
+ * skip to the next page (the rest of this one is erased). That page must have
+ * been completely read so we can erase it and write a header for a deleted
+ * file that covers everything up to readAddress. Returns true if we paused. */
+static bool jsfCompactPause(uint32_t writeAddress, uint32_t readAddress) {
+  uint32_t pageAddr, pageLen;
+  if (!jshFlashGetPage(writeAddress, &pageAddr, &pageLen)) return false;
+  if (pageAddr != writeAddress) { // part way through a page that we erased when we started writing to it
+    pageAddr = jsfGetAddressOfNextPage(writeAddress);
+    if (!pageAddr || !jshFlashGetPage(pageAddr, &pageAddr, &pageLen)) return false;
+  }
+  if (readAddress == pageAddr) // nothing to skip, the next file is right at the start of the page
+    return true;
+  if (readAddress < pageAddr+pageLen) // we haven't finished reading this page so can't erase it
+    return false;
+  jsDebug(DBG_INFO,"compact> pause, deleted file 0x%08x => 0x%08x\n", pageAddr, readAddress);
+  jsfFlashErasePage(pageAddr);
+  JsfFileHeader header;
+  memset(&header, 0, sizeof(header)); // name of all 0s = deleted
+  header.size = readAddress - (pageAddr + (uint32_t)sizeof(JsfFileHeader));
+  jsfFlashWrite(&header, pageAddr, (uint32_t)sizeof(JsfFileHeader));
+  return true;
+}
+
+/* Try and compact saved data so it'll fit in Flash again. startAddress is
+ * the first file to move - anything before it in the same page is rewritten
+ * where it was. If maxPages!=0, we stop once we've erased that many pages
+ * (as soon as Storage is in a valid state) and *paused is set.
  */
-static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t swapBufferSize) {
-  uint32_t writeAddress = startAddress;
+static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t swapBufferSize, uint32_t maxPages, bool *paused) {
+  uint32_t pageAddr, pageLen;
+  if (!jshFlashGetPage(startAddress, &pageAddr, &pageLen)) return false;
+  uint32_t writeAddress = pageAddr;
+  uint32_t pagesErased = 0;
+  *paused = false;
   jsDebug(DBG_INFO,"Compacting from 0x%08x (%d byte buffer)\n", startAddress, swapBufferSize);
-  uint32_t swapBufferHead = 0;
+  // Whatever is in the page before startAddress stays where it is
+  uint32_t swapBufferUsed = startAddress - pageAddr;
+  uint32_t swapBufferHead = swapBufferUsed;
   uint32_t swapBufferTail = 0;
-  uint32_t swapBufferUsed = 0;
+  if (swapBufferUsed > swapBufferSize) return false;
+  if (swapBufferUsed) jshFlashRead(swapBuffer, pageAddr, swapBufferUsed);
   JsfFileHeader header;
   memset(&header,0,sizeof(JsfFileHeader));
   uint32_t addr = startAddress;
   if (jsfGetFileHeader(addr, &header, true)) do {
+    if (maxPages && pagesErased>=maxPages && !swapBufferUsed &&
+        jsfCompactPause(writeAddress, addr)) {
+      *paused = true;
+      return true;
+    }
     if (header.name.firstChars != 0) { // if not replaced
       jsDebug(DBG_INFO,"compact> copying file at 0x%08x\n", addr);
       // Rewrite file position for any JsVars that used this file *if* the file changed position
@@ -473,7 +690,7 @@ static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t
       // Write the contents
       uint32_t alignedSize = jsfAlignAddress(jsfGetFileSize(&header));
       uint32_t alignedPtr = addr+(uint32_t)sizeof(JsfFileHeader);
-      jsfCompactWriteBuffer(&writeAddress, alignedPtr, swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail);
+      jsfCompactWriteBuffer(&writeAddress, alignedPtr, swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail, &pagesErased);
       while (alignedSize) {
         // How much space do we have available in our swapBuffer
         uint32_t s = swapBufferSize-swapBufferUsed;
@@ -493,20 +710,21 @@ static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t
         swapBufferUsed += s;
         swapBufferHead = (swapBufferHead+s) % swapBufferSize;
         // Is the buffer big enough to write?
-        jsfCompactWriteBuffer(&writeAddress, alignedPtr, swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail);
+        jsfCompactWriteBuffer(&writeAddress, alignedPtr, swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail, &pagesErased);
       }
     }
   } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
   jsDebug(DBG_INFO,"compact> finished reading...\n");
   // try and write the remaining
-  jsfCompactWriteBuffer(&writeAddress, jsfGetBankEndAddress(writeAddress), swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail);
+  jsfCompactWriteBuffer(&writeAddress, jsfGetBankEndAddress(writeAddress), swapBuffer, swapBufferSize, &swapBufferUsed, &swapBufferTail, &pagesErased);
   // Finished - erase remaining
   jsDebug(DBG_INFO,"compact> almost there - erase remaining pages\n");
-  if (writeAddress!=startAddress)
+  if (writeAddress!=pageAddr)
     writeAddress = jsfGetAddressOfNextPage(writeAddress-1);
   if (writeAddress) {
+    // addr is the address of the last area in flash (or 0 if the last file went right up to the end)
+    if (!addr) addr = jsfGetBankEndAddress(writeAddress);
     jsDebug(DBG_INFO,"compact> erase 0x%08x => 0x%08x\n", writeAddress, addr);
-    // addr is the address of the last area in flash
     jsfEraseArea(writeAddress, addr);
   }
   jsDebug(DBG_INFO,"Compaction Complete\n");
@@ -514,41 +732,64 @@ static bool jsfCompactInternal(uint32_t startAddress, char *swapBuffer, uint32_t
 }
 #endif
 
-bool jsfBankCompact(uint32_t startAddress) {
 #ifndef SAVE_ON_FLASH
+/* Get the address to start compacting from - the first deleted file, as
+ * everything before it is already compacted. Returns 0 if there's nothing to compact */
+static uint32_t jsfGetCompactStartAddress(uint32_t addr) {
+  JsfFileHeader header;
+  memset(&header,0,sizeof(JsfFileHeader));
+  if (jsfGetFileHeader(addr, &header, false)) do {
+    if (header.name.firstChars == 0) // replaced
+      return addr;
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+  return 0;
+}
+
+/* Compact the bank starting at bankAddress. If maxPages!=0, stop after
+ * erasing roughly that many pages and set *paused if there's more to do */
+static bool jsfBankCompactInternal(uint32_t bankAddress, uint32_t maxPages, bool *paused) {
+  *paused = false;
   jsDebug(DBG_INFO,"Compacting\n");
+  JSF_STATS_INC(compactions, 1);
+  uint32_t startAddress = jsfGetCompactStartAddress(bankAddress);
+  if (!startAddress) {
+    jsDebug(DBG_INFO,"Already fully compacted\n");
+    return true;
+  }
   uint32_t pageAddr,pageSize;
   if (!jshFlashGetPage(startAddress, &pageAddr, &pageSize))
     return 0;
   uint32_t maxRequired = pageSize + (uint32_t)sizeof(JsfFileHeader);
-  // TODO: We could skip forward pages if we think they are already fully compacted?
 
-  uint32_t uncompacted = 0;
-  uint32_t allocated = jsfGetAllocatedSpace(startAddress, true, &uncompacted);
-  if (!uncompacted) {
-    jsDebug(DBG_INFO,"Already fully compacted\n");
-    return true;
-  }
+  // we also have to rewrite whatever was in the page before startAddress
+  uint32_t allocated = jsfGetAllocatedSpace(startAddress, true, NULL) + (startAddress - pageAddr);
   uint32_t swapBufferSize = allocated;
   if (swapBufferSize > maxRequired) swapBufferSize=maxRequired;
   // See if we have enough memory...
   if (swapBufferSize+256 < jsuGetFreeStack()) {
     jsDebug(DBG_INFO,"Enough stack for %d byte buffer\n", swapBufferSize);
     char *swapBuffer = alloca(swapBufferSize);
-    return jsfCompactInternal(startAddress, swapBuffer, swapBufferSize);
+    return jsfCompactInternal(startAddress, swapBuffer, swapBufferSize, maxPages, paused);
   } else {
     jsDebug(DBG_INFO,"Not enough stack for (%d bytes)\n", swapBufferSize);
     JsVar *buf = jsvNewFlatStringOfLength(swapBufferSize);
     if (buf) {
       jsDebug(DBG_INFO,"Allocated data in JsVars\n");
       char *swapBuffer = jsvGetFlatStringPointer(buf);
-      bool r = jsfCompactInternal(startAddress, swapBuffer, swapBufferSize);
+      bool r = jsfCompactInternal(startAddress, swapBuffer, swapBufferSize, maxPages, paused);
       jsvUnLock(buf);
       return r;
     }
   }
   jsDebug(DBG_INFO,"Not enough memory to compact anything\n");
+  return false;
+}
+#endif
 
+bool jsfBankCompact(uint32_t startAddress) {
+#ifndef SAVE_ON_FLASH
+  bool paused;
+  return jsfBankCompactInternal(startAddress, 0, &paused);
 #else
   /* If low on flash assume we only have a tiny bit of flash. Chances
    * are there'll only be one file so just erasing flash will do it. */
@@ -557,12 +798,20 @@ bool jsfBankCompact(uint32_t startAddress) {
     jsfEraseAll();
     return true;
   }
-#endif
   return false;
+#endif
 }
 
+#if ESPR_VARIMAGE_BLOCK_SIZE>0 && !defined(ESPR_NO_VARIMAGE)
+/// Incremented whenever we compact, as compaction can change JsVars that point to flash
+static unsigned int jsfCompactCount = 0;
+#endif
+
 // Try and compact saved data so it'll fit in Flash again
 bool jsfCompact() {
+#if ESPR_VARIMAGE_BLOCK_SIZE>0 && !defined(ESPR_NO_VARIMAGE)
+  jsfCompactCount++;
+#endif
   jsfCacheClear();
   bool compacted = jsfBankCompact(JSF_START_ADDRESS);
 #ifdef JSF_BANK2_START_ADDRESS
@@ -570,6 +819,33 @@ bool jsfCompact() {
 #endif
   return compacted;
 }
+
+#if ESPR_STORAGE_IDLE_COMPACT>0 && !defined(SAVE_ON_FLASH)
+typedef enum {
+  JSFIC_NONE,    ///< Nothing to do
+  JSFIC_CHECK,   ///< Check if Storage is getting full
+  JSFIC_COMPACT, ///< A file was created near the end of Storage, or an idle compaction paused
+} JsfIdleCompactState;
+/// We check after startup in case we lost power part way through compacting
+static JsfIdleCompactState jsfIdleCompactState = JSFIC_CHECK;
+
+bool jsfIdleCompact() {
+  if (jsfIdleCompactState==JSFIC_CHECK)
+    jsfIdleCompactState = (jsfGetFreeSpace(0, true) < ESPR_STORAGE_IDLE_COMPACT_FREE) ? JSFIC_COMPACT : JSFIC_NONE;
+  if (jsfIdleCompactState!=JSFIC_COMPACT) return false;
+  jsDebug(DBG_INFO,"Idle compact\n");
+  jsfCacheClear();
+  bool paused = false;
+  bool ok = jsfBankCompactInternal(JSF_START_ADDRESS, ESPR_STORAGE_IDLE_COMPACT, &paused);
+#ifdef JSF_BANK2_START_ADDRESS
+  if (ok && !paused)
+    ok = jsfBankCompactInternal(JSF_BANK2_START_ADDRESS, ESPR_STORAGE_IDLE_COMPACT, &paused);
+#endif
+  // if compaction failed don't keep trying - jsfCreateFile will compact when it needs to
+  jsfIdleCompactState = (ok && paused) ? JSFIC_COMPACT : JSFIC_NONE;
+  return jsfIdleCompactState==JSFIC_COMPACT;
+}
+#endif
 char jsfStripDriveFromName(JsfFileName *name){
   if (name->c[1]==':') { // if a 'drive' is specified like "C:foobar.js"
     char drive = name->c[0];
@@ -595,15 +871,8 @@ void jsfGetDriveBankAddress(char drive, uint32_t *bankStartAddr, uint32_t *bankE
   *bankStartAddr=JSF_DEFAULT_START_ADDRESS;
   *bankEndAddr=JSF_DEFAULT_END_ADDRESS;
 }
-/// Create a new 'file' in the memory store - DOES NOT remove existing files with same name. Return the address of data start, or 0 on error
-static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flags, JsfFileHeader *returnedHeader) {
-  jsDebug(DBG_INFO,"CreateFile (%d bytes)\n", size);
-  jsfCacheClearFile(name);
-  char drive = jsfStripDriveFromName(&name);
-  uint32_t bankStartAddress,bankEndAddress;
-  jsfGetDriveBankAddress(drive,&bankStartAddress,&bankEndAddress);
-
-  uint32_t requiredSize = jsfAlignAddress(size)+(uint32_t)sizeof(JsfFileHeader);
+/// Find a free area of requiredSize bytes in the bank (compacting if needed). Return the address, or 0 if there isn't enough space
+static uint32_t jsfBankFindFreeSpace(uint32_t bankStartAddress, uint32_t requiredSize) {
   bool compacted = false;
   uint32_t addr = 0;
   JsfFileHeader header;
@@ -638,9 +907,23 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
       }
     }
   };
+  return freeAddr;
+}
+
+/// Create a new 'file' in the memory store - DOES NOT remove existing files with same name. Return the address of data start, or 0 on error
+static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flags, JsfFileHeader *returnedHeader) {
+  jsDebug(DBG_INFO,"CreateFile (%d bytes)\n", size);
+  jsfCacheClearFile(name);
+  char drive = jsfStripDriveFromName(&name);
+  uint32_t bankStartAddress,bankEndAddress;
+  jsfGetDriveBankAddress(drive,&bankStartAddress,&bankEndAddress);
+
+  uint32_t requiredSize = jsfAlignAddress(size)+(uint32_t)sizeof(JsfFileHeader);
+  uint32_t addr = jsfBankFindFreeSpace(bankStartAddress, requiredSize);
+  if (!addr) return 0;
+  JsfFileHeader header;
   // If we were going to straddle the next page and there's enough space,
   // push this file forwards so it starts on a clean page boundary
-  addr = freeAddr;
   uint32_t spaceAvailable = jsfGetSpaceLeftInPage(addr);
   uint32_t nextPage = jsfGetAddressOfNextPage(addr);
   if (nextPage && // there is a next page
@@ -656,11 +939,15 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
   header.size = size | (flags<<24);
   header.name = name;
   jsDebug(DBG_INFO,"CreateFile write header\n");
-  jshFlashWrite(&header,addr,(uint32_t)sizeof(JsfFileHeader));
+  jsfFlashWrite(&header,addr,(uint32_t)sizeof(JsfFileHeader));
   jsDebug(DBG_INFO,"CreateFile written header\n");
   if (returnedHeader) *returnedHeader = header;
   addr += (uint32_t)sizeof(JsfFileHeader); // address of actual file data
   jsfCachePut(&header, addr);
+#if ESPR_STORAGE_IDLE_COMPACT>0 && !defined(SAVE_ON_FLASH)
+  if (bankEndAddress - (addr+size) < ESPR_STORAGE_IDLE_COMPACT_FREE)
+    jsfIdleCompactState = JSFIC_COMPACT; // getting full - compact when we're idle
+#endif
   return addr;
 }
 
@@ -669,8 +956,10 @@ static uint32_t jsfBankFindFile(uint32_t bankAddress, uint32_t bankEndAddress, J
   JsfFileHeader header;
   memset(&header,0,sizeof(JsfFileHeader));
   if (jsfGetFileHeader(addr, &header, false)) do {
+    JSF_STATS_INC(scanned, 1);
     // check for something with the same first 4 chars of name that hasn't been replaced.
-    if (header.name.firstChars == name.firstChars) {
+    if (header.name.firstChars == name.firstChars &&
+        !(jsfGetFileFlags(&header)&JSFF_PENDING)) {
       // Now load the whole header (with name) and check properly
       jsfGetFileHeader(addr, &header, true);
       if (memcmp(header.name.c, name.c, sizeof(name.c))==0) {
@@ -686,11 +975,41 @@ static uint32_t jsfBankFindFile(uint32_t bankAddress, uint32_t bankEndAddress, J
   return 0;
 }
 
+#if ESPR_STORAGE_INDEX_SIZE
+static void jsfBankIndexFiles(uint32_t addr) {
+  JsfFileHeader header;
+  memset(&header,0,sizeof(JsfFileHeader));
+  if (jsfGetFileHeader(addr, &header, true)) do {
+    JSF_STATS_INC(scanned, 1);
+    if (header.name.firstChars != 0 && // if not replaced
+        !(jsfGetFileFlags(&header)&JSFF_PENDING) &&
+        !jsfIndexAdd(jsfFileNameHash(&header.name), addr+(uint32_t)sizeof(JsfFileHeader)))
+      return; // too many files
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
+}
+
+/// Scan Storage and add every file to the index
+static void jsfIndexBuild() {
+  memset(jsfIndex, 0, sizeof(jsfIndex));
+  jsfIndexUsed = 0;
+  jsfIndexState = JSFI_BUILT;
+  jsfBankIndexFiles(JSF_START_ADDRESS);
+#ifdef JSF_BANK2_START_ADDRESS
+  if (jsfIndexState==JSFI_BUILT)
+    jsfBankIndexFiles(JSF_BANK2_START_ADDRESS);
+#endif
+}
+#endif
+
 /// Find a 'file' in the memory store. Return the address of data start (and header if returnedHeader!=0). Returns 0 if not found
 uint32_t jsfFindFile(JsfFileName name, JsfFileHeader *returnedHeader) {
   char drive = jsfStripDriveFromName(&name);
+  JSF_STATS_INC(lookups, 1);
   uint32_t a = jsfCacheFind(name, returnedHeader);
-  if (a!=JSF_CACHE_NOT_FOUND) return a;
+  if (a!=JSF_CACHE_NOT_FOUND) {
+    JSF_STATS_INC(cacheHits, 1);
+    return a;
+  }
   JsfFileHeader header;
 
 #ifdef JSF_BANK2_START_ADDRESS
@@ -706,7 +1025,10 @@ uint32_t jsfFindFile(JsfFileName name, JsfFileHeader *returnedHeader) {
 #else
   a = jsfBankFindFile(JSF_START_ADDRESS, JSF_END_ADDRESS, name, &header);
 #endif
-  if (!a) header.name = name;
+  if (!a) {
+    memset(&header,0,sizeof(JsfFileHeader));
+    header.name = name;
+  }
   jsfCachePut(&header, a); // we put the file in even if it's not found, as that's handy too
   if (returnedHeader) *returnedHeader = header;
   return a;
@@ -859,10 +1181,18 @@ bool jsfIsStorageEmpty() {
   return true;
 }
 
+#if defined(USE_HEATSHRINK) && !defined(SAVE_ON_FLASH)
+static JsVar *jsfReadCompressedFile(uint32_t addr, int offset, int length);
+#endif
+
 JsVar *jsfReadFile(JsfFileName name, int offset, int length) {
   JsfFileHeader header;
   uint32_t addr = jsfFindFile(name, &header);
   if (!addr) return 0;
+#if defined(USE_HEATSHRINK) && !defined(SAVE_ON_FLASH)
+  if (jsfGetFileFlags(&header) & JSFF_BLOCKCOMPRESSED)
+    return jsfReadCompressedFile(addr, offset, length);
+#endif
   // clip requested read lengths
   if (offset<0) offset=0;
   int fileLen = (int)jsfGetFileSize(&header);
@@ -884,7 +1214,9 @@ JsVar* jsvAddressToVar(size_t addr, uint32_t length) {
   }
 #endif
 #ifdef LINUX
-  // linux fakes flash with a file, so we can't just return a pointer to it!
+  // linux fakes flash with a file - if it's not memory-mapped we can't just return a pointer to it!
+  if (mappedAddr)
+    return jsvNewNativeString((char*)mappedAddr, length);
   uint32_t alignedSize = jsfAlignAddress((uint32_t)length);
   char *d = (char*)malloc(alignedSize);
   jshFlashRead(d, addr, alignedSize);
@@ -952,17 +1284,167 @@ bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt of
     jsExceptionHere(JSET_ERROR, "Too much data for file size");
     return false;
   }
+  if (jsfGetFileFlags(&header) & JSFF_BLOCKCOMPRESSED) {
+    jsExceptionHere(JSET_ERROR, "Can't write part of a compressed file");
+    return false;
+  }
   addr += (uint32_t)offset;
   if (!jsfIsErased(addr, (uint32_t)dLen)) {
     jsExceptionHere(JSET_ERROR, "File already written with different data");
     return false;
   }
   jsDebug(DBG_INFO,"jsfWriteFile write contents\n");
-  jshFlashWriteAligned(dPtr, addr, (uint32_t)dLen);
+  jsfFlashWriteAligned(dPtr, addr, (uint32_t)dLen);
   jsDebug(DBG_INFO,"jsfWriteFile written contents\n");
   return true;
 }
 
+#ifndef SAVE_ON_FLASH
+/* jsfWriteFiles writes all of its files one after the other in a single free area
+of Storage, with JSFF_PENDING set so they can't be found yet. It then writes a
+JSF_WRITEFILES_MARKER file, and once that exists the files are committed. Older
+versions of the files are then erased, JSFF_PENDING is cleared on the new ones
+(flash bits can always be cleared without an erase) and the marker is erased.
+
+If power is lost part way through, jsfRecoverWriteFiles finishes the job if the
+marker had been written, or erases the pending files if not. */
+#define JSF_WRITEFILES_MARKER ".wfiles"
+
+/// Is the data the same as the file that's already in Storage?
+static bool jsfWriteFilesIsUnchanged(JsfFileName name, JsVar *data) {
+  JsfFileHeader header;
+  uint32_t addr = jsfFindFile(name, &header);
+  if (!addr || jsfGetFileFlags(&header)!=JSFF_NONE) return false;
+  JSV_GET_AS_CHAR_ARRAY(dPtr, dLen, data);
+  return dPtr && dLen==jsfGetFileSize(&header) &&
+         jsfIsEqual(addr, (unsigned char*)dPtr, (uint32_t)dLen);
+}
+
+/// Write a file with JSFF_PENDING set at addr (the address of the header). Return false if we couldn't get the data
+static bool jsfWriteFilesWritePending(uint32_t addr, JsfFileName name, JsVar *data) {
+  JSV_GET_AS_CHAR_ARRAY(dPtr, dLen, data);
+  if (!dPtr) return false;
+  JsfFileHeader header;
+  header.size = (uint32_t)dLen | ((uint32_t)JSFF_PENDING<<24);
+  header.name = name;
+  jsfFlashWrite(&header, addr, (uint32_t)sizeof(JsfFileHeader));
+  jsfFlashWriteAligned(dPtr, addr+(uint32_t)sizeof(JsfFileHeader), (uint32_t)dLen);
+  return true;
+}
+
+/// Erase any older file with the same name and clear JSFF_PENDING. addr is the address of the header
+static void jsfWriteFilesPublish(uint32_t addr, JsfFileHeader *header) {
+  jsfEraseFile(header->name); // pending files can't be found, so this is the old one
+  header->size &= ~((uint32_t)JSFF_PENDING<<24);
+  jsfFlashWrite(&header->size, addr, (uint32_t)sizeof(header->size));
+  jsfCachePut(header, addr+(uint32_t)sizeof(JsfFileHeader));
+}
+
+bool jsfWriteFiles(JsVar *files) {
+  // Work out how much space we need, and remove files that haven't changed
+  uint32_t count = 0;
+  uint32_t requiredSize = (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(sizeof(count)); // marker
+  uint32_t bankStartAddress = 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, files);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsfFileName name = jsfNameFromVarAndUnLock(jsvObjectIteratorGetKey(&it));
+    JsVar *data = jsvObjectIteratorGetValue(&it);
+    uint32_t size = jsvIterateCallbackCount(data);
+    bool unchanged = size && jsfWriteFilesIsUnchanged(name, data);
+    jsvUnLock(data);
+    if (!size || size>0x00FFFFFF) {
+      jsvObjectIteratorFree(&it);
+      jsExceptionHere(JSET_ERROR, size ? "File too big" : "Can't create zero length file");
+      return false;
+    }
+    if (unchanged) {
+      jsvObjectIteratorRemoveAndGotoNext(&it, files);
+      continue;
+    }
+    uint32_t startAddr, endAddr;
+    jsfGetDriveBankAddress(jsfStripDriveFromName(&name), &startAddr, &endAddr);
+    if (count && startAddr!=bankStartAddress) {
+      jsvObjectIteratorFree(&it);
+      jsExceptionHere(JSET_ERROR, "All files must be in the same bank");
+      return false;
+    }
+    bankStartAddress = startAddr;
+    requiredSize += (uint32_t)sizeof(JsfFileHeader) + jsfAlignAddress(size);
+    count++;
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  if (!count) return true; // nothing to do
+  // Find space for everything at once
+  uint32_t startAddr = jsfBankFindFreeSpace(bankStartAddress, requiredSize);
+  if (!startAddr) {
+    jsExceptionHere(JSET_ERROR, "Not enough free space for files");
+    return false;
+  }
+  // Write all the files, but so they can't be found yet
+  uint32_t addr = startAddr;
+  bool ok = true;
+  jsvObjectIteratorNew(&it, files);
+  while (ok && jsvObjectIteratorHasValue(&it)) {
+    JsfFileName name = jsfNameFromVarAndUnLock(jsvObjectIteratorGetKey(&it));
+    jsfStripDriveFromName(&name);
+    JsVar *data = jsvObjectIteratorGetValue(&it);
+    uint32_t size = jsvIterateCallbackCount(data);
+    ok = jsfWriteFilesWritePending(addr, name, data);
+    jsvUnLock(data);
+    addr = jsfAlignAddress(addr + (uint32_t)sizeof(JsfFileHeader) + size);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  if (!ok) { // remove what we wrote - there'll already be an exception
+    jsfRecoverWriteFiles();
+    return false;
+  }
+  // Write the marker - after this the files are committed
+  JsfFileHeader header;
+  header.size = (uint32_t)sizeof(count);
+  header.name = jsfNameFromString(JSF_WRITEFILES_MARKER);
+  jsfFlashWrite(&header, addr, (uint32_t)sizeof(JsfFileHeader));
+  jsfFlashWriteAligned(&count, addr+(uint32_t)sizeof(JsfFileHeader), (uint32_t)sizeof(count));
+  jsfCachePut(&header, addr+(uint32_t)sizeof(JsfFileHeader));
+  // Replace the old files with the new ones
+  addr = startAddr;
+  jsfGetFileHeader(addr, &header, true);
+  for (uint32_t i=0;i<count;i++) {
+    jsfWriteFilesPublish(addr, &header);
+    jsfGetNextFileHeader(&addr, &header, GNFH_GET_EMPTY);
+  }
+  jsfEraseFile(header.name); // the marker
+#if ESPR_STORAGE_IDLE_COMPACT>0
+  if (jsfGetBankEndAddress(startAddr) - (startAddr+requiredSize) < ESPR_STORAGE_IDLE_COMPACT_FREE)
+    jsfIdleCompactState = JSFIC_COMPACT; // getting full - compact when we're idle
+#endif
+  return true;
+}
+
+static void jsfBankRecoverWriteFiles(uint32_t addr, bool committed) {
+  JsfFileHeader header;
+  memset(&header,0,sizeof(JsfFileHeader));
+  if (jsfGetFileHeader(addr, &header, true)) do {
+    if (header.name.firstChars != 0 && (jsfGetFileFlags(&header)&JSFF_PENDING)) {
+      if (committed) jsfWriteFilesPublish(addr, &header);
+      else jsfEraseFileInternal(addr+(uint32_t)sizeof(JsfFileHeader), &header);
+    }
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
+}
+
+void jsfRecoverWriteFiles() {
+  JsfFileName marker = jsfNameFromString(JSF_WRITEFILES_MARKER);
+  bool committed = jsfFindFile(marker, NULL)!=0;
+  jsfBankRecoverWriteFiles(JSF_START_ADDRESS, committed);
+#ifdef JSF_BANK2_START_ADDRESS
+  jsfBankRecoverWriteFiles(JSF_BANK2_START_ADDRESS, committed);
+#endif
+  if (committed) jsfEraseFile(marker);
+}
+#endif
+
 /** Return all files in flash as a JsVar array of names. If regex is supplied, it is used to filter the filenames using String.match(regexp)
  * If containing!=0, file flags must contain one of the 'containing' argument's bits.
  * Flags can't contain any bits in the 'notContaining' argument
@@ -973,6 +1455,8 @@ static void jsfBankListFiles(JsVar *files, uint32_t addr, JsVar *regex, JsfFileF
   if (jsfGetFileHeader(addr, &header, true)) do {
     if (header.name.firstChars != 0) { // if not replaced
       JsfFileFlags flags = jsfGetFileFlags(&header);
+      if (flags&JSFF_PENDING) continue;
+      jsfCachePutFromList(&header, addr+(uint32_t)sizeof(JsfFileHeader));
       if (notContaining&flags) continue;
       if (containing && !(containing&flags)) continue;
       if (flags&JSFF_STORAGEFILE) {
@@ -1033,6 +1517,68 @@ uint32_t jsfHashFiles(JsVar *regex, JsfFileFlags containing, JsfFileFlags notCon
   return hash;
 }
 
+#ifndef SAVE_ON_FLASH
+static void jsfBankGetStats(uint32_t addr, uint32_t *fileBytes, uint32_t *fileCount, uint32_t *trashBytes, uint32_t *trashCount) {
+  JsfFileHeader header;
+  memset(&header,0,sizeof(JsfFileHeader));
+  if (jsfGetFileHeader(addr, &header, false)) do {
+    uint32_t size = jsfAlignAddress(jsfGetFileSize(&header)) + (uint32_t)sizeof(JsfFileHeader);
+    if (header.name.firstChars != 0) { // if not replaced
+      *fileBytes += size;
+      (*fileCount)++;
+    } else {
+      *trashBytes += size;
+      (*trashCount)++;
+    }
+  } while (jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL|GNFH_READ_ONLY_FILENAME_START));
+}
+
+/// Return an object containing information about how Storage is being used (see Storage.getStats). If reset, counters are reset afterwards
+JsVar *jsfGetStats(bool reset) {
+  JsVar *obj = jsvNewObject();
+  if (!obj) return 0;
+  uint32_t totalBytes = JSF_END_ADDRESS-JSF_START_ADDRESS;
+  uint32_t fileBytes = 0, fileCount = 0, trashBytes = 0, trashCount = 0;
+  jsfBankGetStats(JSF_START_ADDRESS, &fileBytes, &fileCount, &trashBytes, &trashCount);
+#ifdef JSF_BANK2_START_ADDRESS
+  totalBytes += JSF_BANK2_END_ADDRESS-JSF_BANK2_START_ADDRESS;
+  jsfBankGetStats(JSF_BANK2_START_ADDRESS, &fileBytes, &fileCount, &trashBytes, &trashCount);
+#endif
+  jsvObjectSetChildAndUnLock(obj, "totalBytes", jsvNewFromInteger((JsVarInt)totalBytes));
+  jsvObjectSetChildAndUnLock(obj, "freeBytes", jsvNewFromInteger((JsVarInt)jsfGetFreeSpace(0,true)));
+  jsvObjectSetChildAndUnLock(obj, "fileBytes", jsvNewFromInteger((JsVarInt)fileBytes));
+  jsvObjectSetChildAndUnLock(obj, "fileCount", jsvNewFromInteger((JsVarInt)fileCount));
+  jsvObjectSetChildAndUnLock(obj, "trashBytes", jsvNewFromInteger((JsVarInt)trashBytes));
+  jsvObjectSetChildAndUnLock(obj, "trashCount", jsvNewFromInteger((JsVarInt)trashCount));
+#if ESPR_STORAGE_STATS
+  jsvObjectSetChildAndUnLock(obj, "erases", jsvNewFromInteger((JsVarInt)jsfStats.erases));
+  jsvObjectSetChildAndUnLock(obj, "written", jsvNewFromInteger((JsVarInt)jsfStats.written));
+  jsvObjectSetChildAndUnLock(obj, "compactWritten", jsvNewFromInteger((JsVarInt)jsfStats.compactWritten));
+  jsvObjectSetChildAndUnLock(obj, "compactions", jsvNewFromInteger((JsVarInt)jsfStats.compactions));
+  jsvObjectSetChildAndUnLock(obj, "lookups", jsvNewFromInteger((JsVarInt)jsfStats.lookups));
+  jsvObjectSetChildAndUnLock(obj, "cacheHits", jsvNewFromInteger((JsVarInt)jsfStats.cacheHits));
+  jsvObjectSetChildAndUnLock(obj, "scanned", jsvNewFromInteger((JsVarInt)jsfStats.scanned));
+  uint32_t pageAddr, pageLen, pages = 0;
+  if (jshFlashGetPage(JSF_START_ADDRESS, &pageAddr, &pageLen) && pageLen)
+    pages = (JSF_END_ADDRESS-JSF_START_ADDRESS) / pageLen;
+  if (pages > ESPR_STORAGE_STATS) pages = ESPR_STORAGE_STATS;
+  JsVar *pageErases = jsvNewTypedArray(ARRAYBUFFERVIEW_UINT32, (JsVarInt)pages);
+  if (pageErases) {
+    JsvArrayBufferIterator it;
+    jsvArrayBufferIteratorNew(&it, pageErases, 0);
+    for (uint32_t i=0;i<pages;i++) {
+      jsvArrayBufferIteratorSetIntegerValue(&it, (JsVarInt)jsfStats.pageErases[i]);
+      jsvArrayBufferIteratorNext(&it);
+    }
+    jsvArrayBufferIteratorFree(&it);
+    jsvObjectSetChildAndUnLock(obj, "pageErases", pageErases);
+  }
+  if (reset) memset(&jsfStats, 0, sizeof(jsfStats));
+#endif
+  return obj;
+}
+#endif
+
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------------------------------
 // ------------------------------------------------------------------------ For loading/saving code to flash
@@ -1064,7 +1610,7 @@ void jsfSaveToFlash_writecb(unsigned char ch, uint32_t *cbdata) {
   jsfcbData *data = (jsfcbData*)cbdata;
   data->buffer[data->bufferCnt++] = ch;
   if (data->bufferCnt>=(uint32_t)sizeof(data->buffer)) {
-    jshFlashWrite(data->buffer, data->address, data->bufferCnt);
+    jsfFlashWrite(data->buffer, data->address, data->bufferCnt);
     data->address += data->bufferCnt;
     data->bufferCnt = 0;
     if ((data->address&1023)==0) jsiConsolePrint(".");
@@ -1075,7 +1621,7 @@ void jsfSaveToFlash_finish(jsfcbData *data) {
   while (data->bufferCnt & (JSF_ALIGNMENT-1))
     data->buffer[data->bufferCnt++] = 0xFF;
   // write
-  jshFlashWrite(data->buffer, data->address, data->bufferCnt);
+  jsfFlashWrite(data->buffer, data->address, data->bufferCnt);
 }
 
 // cbdata = struct jsfcbData
@@ -1094,10 +1640,321 @@ int jsfLoadFromFlash_readcb(uint32_t *cbdata) {
   return data->buffer[data->bufferCnt++];
 }
 
+#if ESPR_VARIMAGE_BLOCK_SIZE>0 && !defined(ESPR_NO_VARIMAGE)
+/* Rather than one big compressed file, the RAM image is saved as a series of
+ * files each containing ESPR_VARIMAGE_BLOCK_SIZE bytes of JsVars, compressed
+ * separately. When saving we only rewrite the blocks that have changed since
+ * the last save. The SAVED_CODE_VARIMAGE file is written last and contains a
+ * JsfVarImageInfo - if it's not there (or it's an old-style compressed image)
+ * the blocks are ignored. */
+typedef struct {
+  uint32_t hash;      ///< getBuildHash()
+  uint32_t varSize;   ///< Size of the RAM image
+  uint32_t blockSize; ///< ESPR_VARIMAGE_BLOCK_SIZE
+} JsfVarImageInfo;
+
+/// Get the name of the file that contains the given block of the RAM image
+static JsfFileName jsfGetVarImageBlockName(unsigned int block) {
+  char name[16] = SAVED_CODE_VARIMAGE;
+  itostr((JsVarInt)block, &name[strlen(name)], 10);
+  return jsfNameFromString(name);
+}
+
+/// Erase all blocks of the RAM image, starting at the given one
+static void jsfEraseVarImageBlocks(unsigned int block) {
+  while (jsfEraseFile(jsfGetVarImageBlockName(block)))
+    block++;
+}
+
+typedef struct {
+  unsigned char *buffer;
+  uint32_t bufferSize;
+  uint32_t length;
+} JsfVarImageBlockBuffer;
+// cbdata = JsfVarImageBlockBuffer - write as much as fits, but count everything
+static void jsfSaveVarImageBlock_writecb(unsigned char ch, uint32_t *cbdata) {
+  JsfVarImageBlockBuffer *data = (JsfVarImageBlockBuffer*)cbdata;
+  if (data->length < data->bufferSize)
+    data->buffer[data->length] = ch;
+  data->length++;
+}
+
+/* Write each block of the RAM image that has changed. Returns the number of
+ * blocks written, or -1 if we ran out of space, or -2 if Storage got compacted
+ * (which can change JsVars that point to flash, so we have to check again) */
+static int jsfSaveVarImageBlocks(unsigned char *buffer, uint32_t bufferSize, uint32_t *compressedSize) {
+  unsigned int varSize = jsvGetMemoryTotal() * (unsigned int)sizeof(JsVar);
+  unsigned char* varPtr = (unsigned char *)_jsvGetAddressOf(1);
+  unsigned int compactCount = jsfCompactCount;
+  int written = 0;
+  *compressedSize = 0;
+  unsigned int block = 0;
+  for (unsigned int offset=0;offset<varSize;offset+=ESPR_VARIMAGE_BLOCK_SIZE,block++) {
+    unsigned int len = varSize-offset;
+    if (len>ESPR_VARIMAGE_BLOCK_SIZE) len=ESPR_VARIMAGE_BLOCK_SIZE;
+    // Compress into RAM if it'll fit - it usually will
+    JsfVarImageBlockBuffer cbBuffer;
+    cbBuffer.buffer = buffer;
+    cbBuffer.bufferSize = bufferSize;
+    cbBuffer.length = 0;
+    COMPRESS(&varPtr[offset], len, jsfSaveVarImageBlock_writecb, (uint32_t*)&cbBuffer);
+    uint32_t size = cbBuffer.length;
+    *compressedSize += size;
+    bool inBuffer = size <= bufferSize;
+    JsfFileName name = jsfGetVarImageBlockName(block);
+    JsfFileHeader header;
+    uint32_t addr = jsfFindFile(name, &header);
+    if (addr && inBuffer &&
+        jsfGetFileSize(&header)==size &&
+        jsfIsEqual(addr, buffer, size))
+      continue; // unchanged since the last save
+    if (addr) jsfEraseFileInternal(addr, &header);
+    addr = jsfCreateFile(name, size, JSFF_COMPRESSED, NULL);
+    if (!addr) return -1;
+    if (inBuffer) {
+      jsfFlashWriteAligned(buffer, addr, size);
+    } else { // compress again, straight into flash
+      jsfcbData cbData;
+      memset(&cbData, 0, sizeof(cbData));
+      cbData.address = addr;
+      cbData.endAddress = jsfAlignAddress(addr+size);
+      COMPRESS(&varPtr[offset], len, jsfSaveToFlash_writecb, (uint32_t*)&cbData);
+      jsfSaveToFlash_finish(&cbData);
+    }
+    jsiConsolePrint(".");
+    written++;
+    if (jsfCompactCount != compactCount) return -2;
+  }
+  // remove any blocks left over from a bigger image
+  jsfEraseVarImageBlocks(block);
+  return written;
+}
+
+/// Save the RAM image to flash in blocks, only writing what has changed
+static void jsfSaveToFlashBlocks() {
+  JsfFileName name = jsfNameFromString(SAVED_CODE_VARIMAGE);
+  // Remove the info first, so if we lose power part way through the image isn't used
+  jsfEraseFile(name);
+  uint32_t bufferSize = ESPR_VARIMAGE_BLOCK_SIZE + (ESPR_VARIMAGE_BLOCK_SIZE/8) + 16; // worst case for compression
+  if (bufferSize+256 > jsuGetFreeStack())
+    bufferSize = 0; // we'll have to compress each block twice
+  unsigned char *buffer = bufferSize ? alloca(bufferSize) : NULL;
+  jsiConsolePrint("Writing..");
+  uint32_t compressedSize;
+  bool freedMemory = false;
+  int written = jsfSaveVarImageBlocks(buffer, bufferSize, &compressedSize);
+  while (written<0) {
+    if (written==-1) {
+      if (freedMemory) {
+        jsiConsolePrintf("\nERROR: Too big to save to flash\n");
+        if (jsfGetAllocatedSpace(JSF_DEFAULT_START_ADDRESS, true, 0))
+          jsiConsolePrint("Not enough free space to save. Try require('Storage').eraseAll()\n");
+        else
+          jsiConsolePrint("Code is too big to save to Flash.\n");
+        jsfEraseVarImageBlocks(0);
+        return;
+      }
+      freedMemory = true;
+      jsvSoftInit();
+      jspSoftInit();
+      jsiConsolePrint("\nDeleting command history and trying again...\n");
+      while (jsiFreeMoreMemory());
+      jspSoftKill();
+      jsvSoftKill();
+    }
+    // Storage was compacted (or we freed memory) - start again
+    written = jsfSaveVarImageBlocks(buffer, bufferSize, &compressedSize);
+  }
+  // Finally write the info that says the image is valid
+  JsfVarImageInfo info;
+  info.hash = getBuildHash();
+  info.varSize = jsvGetMemoryTotal() * (unsigned int)sizeof(JsVar);
+  info.blockSize = ESPR_VARIMAGE_BLOCK_SIZE;
+  uint32_t addr = jsfCreateFile(name, sizeof(info), JSFF_NONE, NULL);
+  if (!addr) {
+    jsiConsolePrint("\nERROR: Unable to save to flash\n");
+    return;
+  }
+  jsfFlashWriteAligned(&info, addr, (uint32_t)sizeof(info));
+  jsiConsolePrintf("\nCompressed %d bytes to %d (%d of %d blocks written)\n", info.varSize, compressedSize,
+                   written, (info.varSize+ESPR_VARIMAGE_BLOCK_SIZE-1)/ESPR_VARIMAGE_BLOCK_SIZE);
+}
+
+/// Load the RAM image from flash when it was saved in blocks
+static void jsfLoadStateFromFlashBlocks(uint32_t infoAddr) {
+  JsfVarImageInfo info;
+  jshFlashRead(&info, infoAddr, sizeof(info));
+  if (info.hash != getBuildHash()) {
+    jsiConsolePrintf("Not loading saved code from different Espruino firmware.\n");
+    return;
+  }
+  unsigned int varSize = jsvGetMemoryTotal() * (unsigned int)sizeof(JsVar);
+  if (info.varSize != varSize || info.blockSize != ESPR_VARIMAGE_BLOCK_SIZE) {
+    jsiConsolePrintf("Not loading saved code with different memory size.\n");
+    return;
+  }
+  unsigned int blocks = (varSize+ESPR_VARIMAGE_BLOCK_SIZE-1)/ESPR_VARIMAGE_BLOCK_SIZE;
+  // Check everything is there before we overwrite anything
+  for (unsigned int block=0;block<blocks;block++) {
+    if (!jsfFindFile(jsfGetVarImageBlockName(block), NULL)) {
+      jsiConsolePrintf("Saved code is incomplete, not loading.\n");
+      return;
+    }
+  }
+  unsigned char* varPtr = (unsigned char *)_jsvGetAddressOf(1);
+  jsiConsolePrintf("Loading %d bytes from flash...\n", varSize);
+  for (unsigned int block=0;block<blocks;block++) {
+    JsfFileHeader header;
+    uint32_t addr = jsfFindFile(jsfGetVarImageBlockName(block), &header);
+    jsfcbData cbData;
+    memset(&cbData, 0, sizeof(cbData));
+    cbData.address = addr;
+    cbData.endAddress = addr+jsfGetFileSize(&header);
+    DECOMPRESS(jsfLoadFromFlash_readcb, (uint32_t*)&cbData, &varPtr[block*ESPR_VARIMAGE_BLOCK_SIZE]);
+  }
+}
+#endif
+
+#ifndef SAVE_ON_FLASH
+#ifdef USE_HEATSHRINK
+/* Files written with jsfWriteCompressedFile (JSFF_BLOCKCOMPRESSED) start with a
+ * JsfCompressedFileInfo, then the offset (from the start of the file) of the end
+ * of each block, then the blocks themselves. Each block is JSF_COMPRESSED_BLOCK_SIZE
+ * bytes of data compressed separately, so reading part of a file only needs the
+ * blocks that contain it decompressing */
+#define JSF_COMPRESSED_BLOCK_SIZE 1024
+typedef struct {
+  uint32_t length;    ///< Length of the uncompressed data
+  uint32_t blockSize; ///< Uncompressed size of each block
+} JsfCompressedFileInfo;
+
+typedef struct {
+  unsigned char *ptr;
+  uint32_t len, maxLen;
+} JsfDecompressBuffer;
+// cbdata = JsfDecompressBuffer
+static void jsfReadCompressedFile_writecb(unsigned char ch, uint32_t *cbdata) {
+  JsfDecompressBuffer *buf = (JsfDecompressBuffer*)cbdata;
+  if (buf->len < buf->maxLen) buf->ptr[buf->len++] = ch;
+}
+
+static JsVar *jsfReadCompressedFile(uint32_t addr, int offset, int length) {
+  JsfCompressedFileInfo info;
+  jshFlashRead(&info, addr, sizeof(info));
+  if (!info.blockSize || info.blockSize>JSF_COMPRESSED_BLOCK_SIZE) return 0; // corrupt
+  // clip requested read lengths
+  int fileLen = (int)info.length;
+  if (offset<0) offset=0;
+  if (length<=0) length=fileLen;
+  if (offset>fileLen) offset=fileLen;
+  if (offset+length>fileLen) length=fileLen-offset;
+  JsVar *result = jsvNewFromEmptyString();
+  if (!result || length<=0) return result;
+  unsigned char data[JSF_COMPRESSED_BLOCK_SIZE];
+  uint32_t endsAddr = addr + (uint32_t)sizeof(info);
+  uint32_t block = (uint32_t)offset / info.blockSize;
+  uint32_t blockStart = endsAddr + ((info.length+info.blockSize-1)/info.blockSize)*4 - addr;
+  if (block) jshFlashRead(&blockStart, endsAddr+(block-1)*4, 4);
+  while (length>0) {
+    uint32_t blockEnd;
+    jshFlashRead(&blockEnd, endsAddr+block*4, 4);
+    jsfcbData cbData;
+    memset(&cbData, 0, sizeof(cbData));
+    cbData.address = addr+blockStart;
+    cbData.endAddress = addr+blockEnd;
+    JsfDecompressBuffer buf;
+    buf.ptr = data;
+    buf.len = 0;
+    buf.maxLen = info.blockSize;
+    heatshrink_decode_cb(jsfLoadFromFlash_readcb, (uint32_t*)&cbData, jsfReadCompressedFile_writecb, (uint32_t*)&buf);
+    uint32_t o = (uint32_t)offset - block*info.blockSize;
+    if (o>=buf.len) break; // corrupt
+    uint32_t l = buf.len - o;
+    if (l>(uint32_t)length) l=(uint32_t)length;
+    jsvAppendStringBuf(result, (char*)&data[o], l);
+    offset += (int)l;
+    length -= (int)l;
+    block++;
+    blockStart = blockEnd;
+  }
+  return result;
+}
+
+// cbdata = struct jsfcbData - like jsfSaveToFlash_writecb but without the progress dots
+static void jsfWriteCompressedFile_writecb(unsigned char ch, uint32_t *cbdata) {
+  jsfcbData *data = (jsfcbData*)cbdata;
+  data->buffer[data->bufferCnt++] = ch;
+  if (data->bufferCnt>=(uint32_t)sizeof(data->buffer)) {
+    jsfFlashWrite(data->buffer, data->address, data->bufferCnt);
+    data->address += data->bufferCnt;
+    data->bufferCnt = 0;
+  }
+}
+#endif
+
+bool jsfWriteCompressedFile(JsfFileName name, JsVar *data) {
+#ifdef USE_HEATSHRINK
+  JSV_GET_AS_CHAR_ARRAY(dPtr, dLen, data);
+  if (!dPtr) {
+    jsExceptionHere(JSET_ERROR, "Can't get pointer to data to write");
+    return false;
+  }
+  uint32_t blocks = ((uint32_t)dLen+JSF_COMPRESSED_BLOCK_SIZE-1)/JSF_COMPRESSED_BLOCK_SIZE;
+  if (!blocks) return jsfWriteFile(name, data, JSFF_NONE, 0, 0); // will fail for zero length
+  JsVar *endsVar = jsvNewFlatStringOfLength(blocks*4);
+  if (!endsVar) return false; // out of memory - there will already be an error
+  uint32_t *ends = (uint32_t*)jsvGetFlatStringPointer(endsVar);
+  // Work out how big each block is when compressed
+  uint32_t size = (uint32_t)sizeof(JsfCompressedFileInfo) + blocks*4;
+  for (uint32_t b=0;b<blocks;b++) {
+    size_t l = dLen - b*JSF_COMPRESSED_BLOCK_SIZE;
+    if (l>JSF_COMPRESSED_BLOCK_SIZE) l=JSF_COMPRESSED_BLOCK_SIZE;
+    size += heatshrink_encode((unsigned char*)&dPtr[b*JSF_COMPRESSED_BLOCK_SIZE], l, NULL, NULL);
+    ends[b] = size;
+  }
+  if (size >= dLen) { // it doesn't compress - just write it normally
+    jsvUnLock(endsVar);
+    return jsfWriteFile(name, data, JSFF_NONE, 0, 0);
+  }
+  jsfEraseFile(name);
+  uint32_t addr = jsfCreateFile(name, size, JSFF_BLOCKCOMPRESSED, NULL);
+  if (!addr) {
+    jsvUnLock(endsVar);
+    jsExceptionHere(JSET_ERROR, "Unable to find or create file");
+    return false;
+  }
+  jsfcbData cbData;
+  memset(&cbData, 0, sizeof(cbData));
+  cbData.address = addr;
+  cbData.endAddress = jsfAlignAddress(addr+size);
+  JsfCompressedFileInfo info;
+  info.length = (uint32_t)dLen;
+  info.blockSize = JSF_COMPRESSED_BLOCK_SIZE;
+  for (uint32_t i=0;i<sizeof(info);i++)
+    jsfWriteCompressedFile_writecb(((unsigned char*)&info)[i], (uint32_t*)&cbData);
+  for (uint32_t i=0;i<blocks*4;i++)
+    jsfWriteCompressedFile_writecb(((unsigned char*)ends)[i], (uint32_t*)&cbData);
+  jsvUnLock(endsVar);
+  for (uint32_t b=0;b<blocks;b++) {
+    size_t l = dLen - b*JSF_COMPRESSED_BLOCK_SIZE;
+    if (l>JSF_COMPRESSED_BLOCK_SIZE) l=JSF_COMPRESSED_BLOCK_SIZE;
+    heatshrink_encode((unsigned char*)&dPtr[b*JSF_COMPRESSED_BLOCK_SIZE], l, jsfWriteCompressedFile_writecb, (uint32_t*)&cbData);
+  }
+  jsfSaveToFlash_finish(&cbData);
+  return true;
+#else
+  // no compression in this build
+  return jsfWriteFile(name, data, JSFF_NONE, 0, 0);
+#endif
+}
+#endif
+
 /// Save the RAM image to flash (this is the actual interpreter state)
 void jsfSaveToFlash() {
 #ifdef ESPR_NO_VARIMAGE
   jsiConsolePrint("Not implemented in this build\n");
+#elif ESPR_VARIMAGE_BLOCK_SIZE>0
+  jsfSaveToFlashBlocks();
 #else
   unsigned int varSize = jsvGetMemoryTotal() * (unsigned int)sizeof(JsVar);
   unsigned char* varPtr = (unsigned char *)_jsvGetAddressOf(1);
@@ -1159,6 +2016,12 @@ void jsfLoadStateFromFlash() {
   if (!savedCode) {
     return;
   }
+#if ESPR_VARIMAGE_BLOCK_SIZE>0
+  if (!(jsfGetFileFlags(&header) & JSFF_COMPRESSED)) {
+    jsfLoadStateFromFlashBlocks(savedCode);
+    return;
+  }
+#endif
 
   //  unsigned int dataSize = jsvGetMemoryTotal() * sizeof(JsVar);
   unsigned char* varPtr = (unsigned char *)_jsvGetAddressOf(1);
@@ -1231,6 +2094,9 @@ void jsfRemoveCodeFromFlash() {
   jsiConsolePrint("Erasing saved code.");
 #ifndef ESPR_NO_VARIMAGE
   jsfEraseFile(jsfNameFromString(SAVED_CODE_VARIMAGE));
+#if ESPR_VARIMAGE_BLOCK_SIZE>0
+  jsfEraseVarImageBlocks(0);
+#endif
 #endif
   jsfEraseFile(jsfNameFromString(SAVED_CODE_BOOTCODE));
   jsfEraseFile(jsfNameFromString(SAVED_CODE_BOOTCODE_RESET));
@@ -1247,7 +2113,7 @@ void jsfResetStorage() {
   jsiConsolePrintf("Writing initial storage contents...\n");
   extern const char jsfStorageInitialContents[];
   extern const int jsfStorageInitialContentLength;
-  jshFlashWrite(jsfStorageInitialContents, FLASH_SAVED_CODE_START, jsfStorageInitialContentLength);
+  jsfFlashWrite(jsfStorageInitialContents, FLASH_SAVED_CODE_START, jsfStorageInitialContentLength);
   jsiConsolePrintf("Write complete.\n");
 #endif
 }
@@ -33,6 +33,8 @@ typedef struct {
 
 typedef enum {
   JSFF_NONE,
+  JSFF_PENDING = 16,      // Written by jsfWriteFiles but not committed yet - ignored when looking up files
+  JSFF_BLOCKCOMPRESSED = 32, // This file is compressed in blocks (created by Storage.writeCompressed)
   JSFF_STORAGEFILE = 64,  // This file is a 'storage file' created by Storage.open
   JSFF_COMPRESSED = 128   // This file contains compressed data (used only for .varimg currently)
 } JsfFileFlags; // these are stored in the top 8 bits of JsfFileHeader.size
@@ -61,12 +63,28 @@ JsVar* jsvAddressToVar(size_t addr, uint32_t length);
 JsVar *jsfReadFile(JsfFileName name, int offset, int length);
 /// Write a file. For simple stuff just leave offset and size as 0
 bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt offset, JsVarInt _size);
+#ifndef SAVE_ON_FLASH
+/// Write a file compressed in blocks, so it can still be read from any offset with jsfReadFile
+bool jsfWriteCompressedFile(JsfFileName name, JsVar *data);
+#endif
+#ifndef SAVE_ON_FLASH
+/** Write several files at once ({filename:data,...}). Either all the files are written, or
+ * none are (even if power is lost) - existing files are only replaced once all new ones are
+ * written. Files that are unchanged are removed from 'files' and aren't rewritten */
+bool jsfWriteFiles(JsVar *files);
+/// If power was lost while jsfWriteFiles was running, finish writing the files or remove them
+void jsfRecoverWriteFiles();
+#endif
 /// Erase the given file, return true on success
 bool jsfEraseFile(JsfFileName name);
 /// Erase the entire contents of the memory store
 bool jsfEraseAll();
 /// Try and compact saved data so it'll fit in Flash again
 bool jsfCompact();
+#if ESPR_STORAGE_IDLE_COMPACT>0 && !defined(SAVE_ON_FLASH)
+/// If Storage is getting full, compact a few pages of it. Return true if there's more to do
+bool jsfIdleCompact();
+#endif
 /** Return all files in flash as a JsVar array of names. If regex is supplied, it is used to filter the filenames using String.match(regexp)
  * If containing!=0, file flags must contain one of the 'containing' argument's bits.
  * Flags can't contain any bits in the 'notContaining' argument
@@ -98,6 +116,10 @@ bool jsfIsStorageValid(JsfStorageTestType testType);
 bool jsfIsStorageEmpty();
 // Get the amount of space free in this page (or all pages). addr=0 uses start page
 uint32_t jsfGetFreeSpace(uint32_t addr, bool allPages);
+#ifndef SAVE_ON_FLASH
+/// Return an object containing information about how Storage is being used (see Storage.getStats). If reset, counters are reset afterwards
+JsVar *jsfGetStats(bool reset);
+#endif
 
 // ------------------------------------------------------------------------ For loading/saving code to flash
 /// Save contents of JsVars into Flash.
@@ -459,6 +459,15 @@ void jshVirtualPinSetState(Pin pin, JshPinState state);
 JshPinState jshVirtualPinGetState(Pin pin);
 #endif
 
+#ifdef LINUX
+/// Write a block of data to the console (stdout). Unless unbuffered, this is only flushed on newline (for terminals), idle or exit
+void jshConsoleWrite(const unsigned char *data, size_t len);
+/// Write any buffered console output to stdout now
+void jshConsoleFlush();
+/// Set whether console output is buffered, or written out straight away (the default is buffered)
+void jshConsoleSetBuffered(bool buffered);
+#endif
+
 /** Hacky definition of wait cycles used for WAIT_UNTIL.
  * TODO: make this depend on known system clock speed? */
 #if defined(STM32F401xx) || defined(STM32F411xx)
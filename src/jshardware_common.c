@@ -13,6 +13,7 @@
  */
 #include "jshardware.h"
 #include "jsinteractive.h"
+#include "jsvariterator.h"
 #include "platform_config.h"
 
 void jshUSARTInitInfo(JshUSARTInfo *inf) {
@@ -51,6 +52,7 @@ void jshI2CInitInfo(JshI2CInfo *inf) {
 }
 
 void jshFlashWriteAligned(void *buf, uint32_t addr, uint32_t len) {
+  jsvFlashStringCacheClear(); // we don't read the cache here, so it's fine to clear it first
 #ifdef SPIFLASH_BASE
   if ((addr >= SPIFLASH_BASE) && (addr < (SPIFLASH_BASE+SPIFLASH_LENGTH))) {
     // If using external flash it doesn't care about alignment, so don't bother
@@ -69,6 +69,25 @@ Pin pinSleepIndicator = DEFAULT_SLEEP_PIN_INDICATOR;
 #endif
 JsiStatus jsiStatus = 0;
 JsSysTime jsiLastIdleTime;  ///< The last time we went around the idle loop - use this for timers
+JsSysTime jsiTimerBaseTime; ///< A timer's "time" is the system time it is due at, minus this
+#if ESPR_TIMER_HEAP_SIZE
+/// An entry in jsiTimerHeap
+typedef struct {
+  JsSysTime time; ///< When the timer is due (relative to jsiTimerBaseTime)
+  JsVarRef name;  ///< The timer's name in timerArray
+} JsiTimerHeapEntry;
+/// Binary min-heap of timers in timerArray, soonest first. Rebuilt whenever JSIS_TIMERS_CHANGED is set
+static JsiTimerHeapEntry jsiTimerHeap[ESPR_TIMER_HEAP_SIZE];
+static int jsiTimerHeapCount = -1; ///< Timers in jsiTimerHeap, or -1 if they didn't all fit (so we scan timerArray instead)
+#endif
+#if ESPR_WATCH_INDEX_SIZE
+/// Names of watches in watchArray, grouped by EXTI channel. Rebuilt whenever JSIS_WATCHES_CHANGED is set
+static JsVarRef jsiWatchIndex[ESPR_WATCH_INDEX_SIZE];
+/// Watches for EV_EXTI0+n are jsiWatchIndex[jsiWatchIndexStart[n]] up to jsiWatchIndex[jsiWatchIndexStart[n+1]-1]
+static uint16_t jsiWatchIndexStart[EXTI_COUNT+1];
+static bool jsiWatchIndexValid = false; ///< False if the watches didn't all fit (so we scan watchArray instead)
+#endif
+static bool jsiWatchesPending = false; ///< Do any watches have coalesced edges waiting to be reported?
 uint32_t jsiTimeSinceCtrlC;
 // ----------------------------------------------------------------------------
 JsVar *inputLine = 0; ///< The current input line
@@ -220,14 +239,29 @@ NO_INLINE void jsiConsolePrintChar(char data) {
   jshTransmit(consoleDevice, (unsigned char)data);
 }
 
+/**
+ * Send a block of characters to the console, converting '\n' to '\r\n' and
+ * adding newLineCh after each newline (if it's not 0). Everything between
+ * newlines is sent in one go with jshTransmitBuffer.
+ */
+static void jsiConsolePrintBuffer(const char *str, size_t len, char newLineCh) {
+  while (len) {
+    const char *nl = memchr(str, '\n', len);
+    size_t n = nl ? (size_t)(nl - str) : len;
+    if (n) jshTransmitBuffer(consoleDevice, (const unsigned char*)str, n);
+    if (!nl) return;
+    char eol[3] = { '\r', '\n', newLineCh };
+    jshTransmitBuffer(consoleDevice, (const unsigned char*)eol, newLineCh ? 3 : 2);
+    str += n+1;
+    len -= n+1;
+  }
+}
+
 /**
  * \breif Send a NULL terminated string to the console.
  */
 NO_INLINE void jsiConsolePrintString(const char *str) {
-  while (*str) {
-    if (*str == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(*(str++));
-  }
+  jsiConsolePrintBuffer(str, strlen(str), 0);
 }
 
 #ifdef USE_FLASH_MEMORY
@@ -288,10 +322,10 @@ void jsiConsolePrintStringVarWithNewLineChar(JsVar *v, size_t fromCharacter, cha
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, fromCharacter);
   while (jsvStringIteratorHasChar(&it)) {
-    char ch = jsvStringIteratorGetCharAndNext(&it);
-    if (ch == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(ch);
-    if (ch == '\n' && newLineCh) jsiConsolePrintChar(newLineCh);
+    unsigned char *data;
+    unsigned int len;
+    jsvStringIteratorGetPtrAndNext(&it, &data, &len);
+    jsiConsolePrintBuffer((const char*)data, len, newLineCh);
   }
   jsvStringIteratorFree(&it);
 }
@@ -459,6 +493,8 @@ void jsiSoftInit(bool hasBeenReset) {
   // Make sure we set up lastIdleTime, as this could be used
   // when adding an interval from onInit (called below)
   jsiLastIdleTime = jshGetSystemTime();
+  jsiTimerBaseTime = jsiLastIdleTime; // jsiSoftKill made timers relative to when it was called
+  jsiTimersChanged();
   jsiTimeSinceCtrlC = 0xFFFFFFFF;
 
   // Set up interpreter flags and remove
@@ -496,6 +532,7 @@ void jsiSoftInit(bool hasBeenReset) {
     jsvObjectIteratorFree(&it);
     jsvUnLock(watchArrayPtr);
   }
+  jsiWatchesChanged();
 
   // Timers are stored by time in the future now, so no need
   // to fiddle with them.
@@ -729,6 +766,20 @@ void jsiSoftKill() {
     events=0;
   }
   if (timerArray) {
+    // Make timers relative to now, so they can be restored by jsiSoftInit (even after a reboot)
+    JsSysTime timeOffset = jsiTimerBaseTime - jshGetSystemTime();
+    JsVar *timerArrayPtr = jsvLock(timerArray);
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, timerArrayPtr);
+    while (jsvObjectIteratorHasValue(&it)) {
+      JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+      JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+      jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime + timeOffset));
+      jsvUnLock(timerPtr);
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+    jsvUnLock(timerArrayPtr);
     jsvUnRefRef(timerArray);
     timerArray=0;
   }
@@ -802,6 +853,8 @@ void jsiSemiInit(bool autoLoad, JsfFileName *loadedFilename) {
       jsiConsolePrintf("Storage Ok.\n");
 #endif
     }
+    // If power was lost while writing a batch of files, finish writing it or remove it
+    jsfRecoverWriteFiles();
   }
 #endif
 
@@ -1800,6 +1853,12 @@ bool jsiShouldExecuteWatch(JsVar *watchPtr, bool pinIsHigh) {
       (!pinIsHigh && watchEdge<0); // falling edge
 }
 
+/// Should edges for this watch that arrive together be reported in one callback?
+static bool jsiShouldCoalesceWatch(JsVar *watchPtr) {
+  return jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "coalesce", 0)) &&
+         jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "recur", 0));
+}
+
 bool jsiIsWatchingPin(Pin pin) {
   if (jshGetPinShouldStayWatched(pin))
     return true;
@@ -1879,6 +1938,354 @@ void jsiHandleIOEventForConsole(IOEvent *event) {
   jsiSetBusy(BUSY_INTERACTIVE, false);
 }
 
+/// Execute callbacks for all watches that have had edges coalesced
+static void jsiExecutePendingWatches() {
+  jsiWatchesPending = false;
+  JsVar *watchArrayPtr = jsvLock(watchArray);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, watchArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    bool hasDeletedWatch = false;
+    JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
+    JsVar *data = jsvObjectGetChild(watchPtr, "pending", 0);
+    if (data) {
+      jsvObjectRemoveChild(watchPtr, "pending");
+      JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
+      if (!jsiExecuteEventCallback(0, watchCallback, 1, &data)) {
+        jsError("Ctrl-C while processing watch - removing it.");
+        jsErrorFlags |= JSERR_CALLBACK;
+        Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+        jsvObjectIteratorRemoveAndGotoNext(&it, watchArrayPtr);
+        hasDeletedWatch = true;
+        jsiWatchesChanged();
+        if (!jsiIsWatchingPin(pin))
+          jshPinWatch(pin, false);
+      }
+      jsvUnLock2(watchCallback, data);
+    }
+    jsvUnLock(watchPtr);
+    if (!hasDeletedWatch)
+      jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(watchArrayPtr);
+}
+
+/** Handle an EXTI event for the given watch on the given pin. Returns true if the watch
+ * should now be removed from watchArray (it wasn't recurring) */
+static bool jsiHandleWatchEvent(IOEvent *event, JsVar *watchPtr, Pin pin) {
+  bool removeWatch = false;
+  /** Work out event time. Events time is only stored in 32 bits, so we need to
+   * use the correct 'high' 32 bits from the current time.
+   *
+   * We know that the current time is always newer than the event time, so
+   * if the bottom 32 bits of the current time is less than the bottom
+   * 32 bits of the event time, we need to subtract a full 32 bits worth
+   * from the current time.
+   */
+  JsSysTime time = jshGetSystemTime();
+  if (((unsigned int)time) < (unsigned int)event->data.time)
+    time = time - 0x100000000LL;
+  // finally, mask in the event's time
+  JsSysTime eventTime = (time & ~0xFFFFFFFFLL) | (JsSysTime)event->data.time;
+
+  // Now actually process the event
+  bool pinIsHigh = (event->flags&EV_EXTI_IS_HIGH)!=0;
+
+  bool executeNow = false;
+  JsVarInt debounce = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
+  if (debounce<=0) {
+    executeNow = true;
+  } else { // Debouncing - use timeouts to ensure we only fire at the right time
+    // store the current state of the pin
+    bool oldWatchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state",0));
+    JsVar *timeout = jsvObjectGetChild(watchPtr, "timeout", 0);
+    if (timeout) { // if we had a timeout, update the callback time
+      JsSysTime timeoutTime = jsiTimerGetTime(timeout);
+      jsiTimerSetTime(timeout, eventTime + debounce);
+      jsiTimersChanged();
+      jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
+      if (eventTime > timeoutTime && pinIsHigh!=oldWatchState) {
+        // timeout should have fired, but we didn't get around to executing it!
+        // Do it now (with the old timeout time)
+        executeNow = true;
+        eventTime = timeoutTime - debounce;
+        jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(pinIsHigh));
+        // Remove the timeout
+        JsVar *idArr = jsvNewArray(&timeout, 1);
+        jswrap_interface_clearTimeout(idArr);
+        jsvUnLock(idArr);
+        jsvObjectRemoveChild(watchPtr, "timeout");
+      }
+    } else if (pinIsHigh!=oldWatchState) { // else create a new timeout
+      timeout = jsvNewObject();
+      if (timeout) {
+        jsvObjectSetChild(timeout, "watch", watchPtr); // no unlock
+        jsiTimerSetTime(timeout, eventTime + debounce);
+        jsvObjectSetChildAndUnLock(timeout, "callback", jsvObjectGetChild(watchPtr, "callback", 0));
+        jsvObjectSetChildAndUnLock(timeout, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
+        jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
+        jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
+        // Add to timer array
+        jsiTimerAdd(timeout);
+        // Add to our watch
+        jsvObjectSetChild(watchPtr, "timeout", timeout); // no unlock
+      }
+    }
+    jsvUnLock(timeout);
+  }
+
+  // If we want to execute this watch right now...
+  if (executeNow) {
+    JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000);
+    if (jsiShouldExecuteWatch(watchPtr, pinIsHigh) && jsiShouldCoalesceWatch(watchPtr)) {
+      // add this edge to the callback that'll be made when all events have been handled
+      JsVar *data = jsvObjectGetChild(watchPtr, "pending", 0);
+      if (!data) {
+        data = jsvNewObject();
+        if (data) {
+          jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
+          jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
+          jsvObjectSetChildAndUnLock(data, "count", jsvNewFromInteger(0));
+          jsvObjectSetChildAndUnLock(data, "times", jsvNewEmptyArray());
+          jsvObjectSetChild(watchPtr, "pending", data); // no unlock
+          jsiWatchesPending = true;
+        }
+      }
+      if (data) {
+        jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
+        jsvObjectSetChild(data, "time", timePtr); // no unlock
+        jsvObjectSetChildAndUnLock(data, "count", jsvNewFromInteger(jsvGetIntegerAndUnLock(jsvObjectGetChild(data, "count", 0))+1));
+        JsVar *times = jsvObjectGetChild(data, "times", 0);
+        if (times) jsvArrayPush(times, timePtr);
+        jsvUnLock2(times, data);
+      }
+    } else if (jsiShouldExecuteWatch(watchPtr, pinIsHigh)) { // edge triggering
+      JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
+      bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
+      JsVar *data = jsvNewObject();
+      if (data) {
+        jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
+        jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
+        // set both data.time, and watch.lastTime in one go
+        jsvObjectSetChild(data, "time", timePtr); // no unlock
+        jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
+        Pin dataPin = jshGetEventDataPin(IOEVENTFLAGS_GETTYPE(event->flags));
+        if (jshIsPinValid(dataPin))
+          jsvObjectSetChildAndUnLock(data, "data", jsvNewFromBool((event->flags&EV_EXTI_DATA_PIN_HIGH)!=0));
+      }
+      if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
+        jsError("Ctrl-C while processing watch - removing it.");
+        jsErrorFlags |= JSERR_CALLBACK;
+        watchRecurring = false;
+      }
+      jsvUnLock(data);
+      removeWatch = !watchRecurring;
+      jsvUnLock(watchCallback);
+    }
+    jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
+  }
+  return removeWatch;
+}
+
+/** Execute a timer from timerArray that is due, where timerTime is its "time". Returns true if
+ * the timer should be kept (it's an interval), in which case timerTime is updated to when it's next due */
+static bool jsiExecuteTimer(JsVar *timerPtr, JsSysTime *timerTime) {
+  // we're now doing work
+  jsiSetBusy(BUSY_INTERACTIVE, true);
+  JsVar *timerCallback = jsvObjectGetChild(timerPtr, "callback", 0);
+  JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
+  bool exec = true;
+  JsVar *data = 0;
+  if (watchPtr) {
+    bool watchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state", 0));
+    bool timerState = jsvGetBoolAndUnLock(jsvObjectGetChild(timerPtr, "state", 0));
+    jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(timerState));
+    exec = false;
+    if (watchState!=timerState) {
+      // Create the 'time' variable that will be passed to the user and stored as last time
+      JsVarInt delay = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
+      JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiTimerBaseTime+*timerTime-delay)/1000);
+      // If it's the right edge...
+      if (jsiShouldExecuteWatch(watchPtr, timerState)) {
+        data = jsvNewObject();
+        // if we were from a watch then we were delayed by the debounce time...
+        if (data) {
+          exec = true;
+          // if it was a watch, set the last state up
+          jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
+          // set up the lastTime variable of data to what was in the watch
+          jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
+          // set up the watches lastTime to this one
+          jsvObjectSetChild(data, "time", timePtr); // don't unlock - use this later
+          jsvObjectSetChildAndUnLock(data, "pin", jsvObjectGetChild(watchPtr, "pin", 0));
+        }
+      }
+      // Update lastTime regardless of which edge we're watching
+      jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
+    }
+  }
+  bool removeTimer = false;
+  if (exec) {
+    bool execResult;
+    if (data) {
+      execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
+    } else {
+      JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
+      execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
+      jsvUnLock(argsArray);
+    }
+    if (!execResult) {
+      JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
+      if (interval) { // if interval then it's setInterval not setTimeout
+        jsvUnLock(interval);
+        jsError("Ctrl-C while processing interval - removing it.");
+        jsErrorFlags |= JSERR_CALLBACK;
+        removeTimer = true;
+      }
+    }
+  }
+  jsvUnLock(data);
+  if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
+    jsvObjectRemoveChild(watchPtr, "timeout");
+    // Deal with non-recurring watches
+    if (exec) {
+      bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
+      if (!watchRecurring) {
+        JsVar *watchArrayPtr = jsvLock(watchArray);
+        JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
+        if (watchNamePtr) {
+          jsvRemoveChild(watchArrayPtr, watchNamePtr);
+          jsvUnLock(watchNamePtr);
+          jsiWatchesChanged();
+        }
+        jsvUnLock(watchArrayPtr);
+        Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+        if (!jsiIsWatchingPin(pin))
+          jshPinWatch(pin, false);
+      }
+    }
+    jsvUnLock(watchPtr);
+  }
+  // Load interval *after* executing code, in case it has changed
+  JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
+  bool keepTimer = !removeTimer && interval;
+  if (keepTimer) {
+    *timerTime = *timerTime + jsvGetLongInteger(interval);
+    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(*timerTime));
+  }
+  jsvUnLock2(timerCallback,interval);
+  return keepTimer;
+}
+
+#if ESPR_TIMER_HEAP_SIZE
+/// Move jsiTimerHeap[i] down the heap until it is in the right place
+static void jsiTimerHeapSiftDown(int i) {
+  JsiTimerHeapEntry entry = jsiTimerHeap[i];
+  while (true) {
+    int child = i*2+1;
+    if (child >= jsiTimerHeapCount) break;
+    if (child+1 < jsiTimerHeapCount && jsiTimerHeap[child+1].time < jsiTimerHeap[child].time)
+      child++;
+    if (entry.time <= jsiTimerHeap[child].time) break;
+    jsiTimerHeap[i] = jsiTimerHeap[child];
+    i = child;
+  }
+  jsiTimerHeap[i] = entry;
+}
+
+/// Add a timer to jsiTimerHeap (which must have space)
+static void jsiTimerHeapAdd(JsSysTime time, JsVarRef name) {
+  int i = jsiTimerHeapCount++;
+  while (i>0 && jsiTimerHeap[(i-1)/2].time > time) {
+    jsiTimerHeap[i] = jsiTimerHeap[(i-1)/2];
+    i = (i-1)/2;
+  }
+  jsiTimerHeap[i].time = time;
+  jsiTimerHeap[i].name = name;
+}
+
+/// Rebuild jsiTimerHeap from timerArray, and clear JSIS_TIMERS_CHANGED
+static void jsiTimerHeapRebuild(JsVar *timerArrayPtr) {
+  jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
+  jsiTimerHeapCount = 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    if (jsiTimerHeapCount >= ESPR_TIMER_HEAP_SIZE) {
+      jsiTimerHeapCount = -1; // too many timers - jsiIdle will have to scan them all
+      break;
+    }
+    JsVar *timerName = jsvObjectIteratorGetKey(&it);
+    JsVar *timerPtr = jsvSkipName(timerName);
+    jsiTimerHeap[jsiTimerHeapCount].time = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+    jsiTimerHeap[jsiTimerHeapCount].name = jsvGetRef(timerName);
+    jsiTimerHeapCount++;
+    jsvUnLock2(timerPtr, timerName);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  for (int i=jsiTimerHeapCount/2-1;i>=0;i--)
+    jsiTimerHeapSiftDown(i);
+}
+#endif
+
+#if ESPR_WATCH_INDEX_SIZE
+/// Which EXTI channel (if any) will events for this pin come in on?
+static IOEventFlags jsiGetWatchChannel(Pin pin) {
+  IOEvent event;
+  for (int channel=EV_EXTI0;channel<=EV_EXTI_MAX;channel++) {
+    event.flags = (IOEventFlags)channel;
+    if (jshIsEventForPin(&event, pin)) return (IOEventFlags)channel;
+  }
+  return EV_NONE;
+}
+
+/// Rebuild jsiWatchIndex from watchArray, and clear JSIS_WATCHES_CHANGED
+static void jsiWatchIndexRebuild(JsVar *watchArrayPtr) {
+  jsiStatus = jsiStatus & ~JSIS_WATCHES_CHANGED;
+  jsiWatchIndexValid = false;
+  memset(jsiWatchIndexStart, 0, sizeof(jsiWatchIndexStart));
+  uint8_t watchChannels[ESPR_WATCH_INDEX_SIZE]; // channel-EV_EXTI0 for each watch, or 0xFF if none
+  int watchCount = 0;
+  // Count the watches on each channel
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, watchArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    if (watchCount >= ESPR_WATCH_INDEX_SIZE) {
+      jsvObjectIteratorFree(&it);
+      return; // too many watches - jsiIdle will have to scan them all
+    }
+    JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
+    IOEventFlags channel = jsiGetWatchChannel(jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0)));
+    jsvUnLock(watchPtr);
+    watchChannels[watchCount++] = (channel==EV_NONE) ? 0xFF : (uint8_t)(channel-EV_EXTI0);
+    if (channel!=EV_NONE) jsiWatchIndexStart[channel-EV_EXTI0+1]++;
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  // Work out where each channel's watches start, then fill in their names in order
+  uint16_t channelFill[EXTI_COUNT];
+  for (int i=0;i<EXTI_COUNT;i++) {
+    jsiWatchIndexStart[i+1] = (uint16_t)(jsiWatchIndexStart[i+1] + jsiWatchIndexStart[i]);
+    channelFill[i] = jsiWatchIndexStart[i];
+  }
+  watchCount = 0;
+  jsvObjectIteratorNew(&it, watchArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    uint8_t channel = watchChannels[watchCount++];
+    if (channel!=0xFF) {
+      JsVar *watchName = jsvObjectIteratorGetKey(&it);
+      jsiWatchIndex[channelFill[channel]++] = jsvGetRef(watchName);
+      jsvUnLock(watchName);
+    }
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsiWatchIndexValid = true;
+}
+#endif
+
 void jsiIdle() {
   // This is how many times we have been here and not done anything.
   // It will be zeroed if we do stuff later
@@ -1944,120 +2351,64 @@ void jsiIdle() {
 #endif
     } else if (DEVICE_IS_EXTI(eventType)) { // ---------------------------------------------------------------- PIN WATCH
       // we have an event... find out what it was for...
-      // Check everything in our Watch array
       JsVar *watchArrayPtr = jsvLock(watchArray);
-      JsvObjectIterator it;
-      jsvObjectIteratorNew(&it, watchArrayPtr);
-      while (jsvObjectIteratorHasValue(&it)) {
-        bool hasDeletedWatch = false;
-        JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
-        Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-
-        if (jshIsEventForPin(&event, pin)) {
-          /** Work out event time. Events time is only stored in 32 bits, so we need to
-           * use the correct 'high' 32 bits from the current time.
-           *
-           * We know that the current time is always newer than the event time, so
-           * if the bottom 32 bits of the current time is less than the bottom
-           * 32 bits of the event time, we need to subtract a full 32 bits worth
-           * from the current time.
-           */
-          JsSysTime time = jshGetSystemTime();
-          if (((unsigned int)time) < (unsigned int)event.data.time)
-            time = time - 0x100000000LL;
-          // finally, mask in the event's time
-          JsSysTime eventTime = (time & ~0xFFFFFFFFLL) | (JsSysTime)event.data.time;
-
-          // Now actually process the event
-          bool pinIsHigh = (event.flags&EV_EXTI_IS_HIGH)!=0;
-
-          bool executeNow = false;
-          JsVarInt debounce = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
-          if (debounce<=0) {
-            executeNow = true;
-          } else { // Debouncing - use timeouts to ensure we only fire at the right time
-            // store the current state of the pin
-            bool oldWatchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state",0));
-            JsVar *timeout = jsvObjectGetChild(watchPtr, "timeout", 0);
-            if (timeout) { // if we had a timeout, update the callback time
-              JsSysTime timeoutTime = jsiLastIdleTime + (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timeout, "time", 0));
-              jsvUnLock(jsvObjectSetChild(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce)));
-              jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
-              if (eventTime > timeoutTime && pinIsHigh!=oldWatchState) {
-                // timeout should have fired, but we didn't get around to executing it!
-                // Do it now (with the old timeout time)
-                executeNow = true;
-                eventTime = timeoutTime - debounce;
-                jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(pinIsHigh));
-                // Remove the timeout
-                JsVar *idArr = jsvNewArray(&timeout, 1);
-                jswrap_interface_clearTimeout(idArr);
-                jsvUnLock(idArr);
-                jsvObjectRemoveChild(watchPtr, "timeout");
-              }
-            } else if (pinIsHigh!=oldWatchState) { // else create a new timeout
-              timeout = jsvNewObject();
-              if (timeout) {
-                jsvObjectSetChild(timeout, "watch", watchPtr); // no unlock
-                jsvObjectSetChildAndUnLock(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce));
-                jsvObjectSetChildAndUnLock(timeout, "callback", jsvObjectGetChild(watchPtr, "callback", 0));
-                jsvObjectSetChildAndUnLock(timeout, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
-                jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
-                // Add to timer array
-                jsiTimerAdd(timeout);
-                // Add to our watch
-                jsvObjectSetChild(watchPtr, "timeout", timeout); // no unlock
-              }
+#if ESPR_WATCH_INDEX_SIZE
+      if (jsiStatus & JSIS_WATCHES_CHANGED)
+        jsiWatchIndexRebuild(watchArrayPtr);
+      if (jsiWatchIndexValid) {
+        // Look up the watches for this event's channel. Lock their names first as callbacks could change watchArray
+        int channel = eventType-EV_EXTI0;
+        int watchCount = jsiWatchIndexStart[channel+1] - jsiWatchIndexStart[channel];
+        JsVar **watchNames = (JsVar**)alloca(sizeof(JsVar*) * (size_t)watchCount);
+        for (int i=0;i<watchCount;i++)
+          watchNames[i] = jsvLock(jsiWatchIndex[jsiWatchIndexStart[channel]+i]);
+        for (int i=0;i<watchCount;i++) {
+          // if watches changed in a callback, this one may have been removed
+          if (!(jsiStatus & JSIS_WATCHES_CHANGED) || jsvIsChild(watchArrayPtr, watchNames[i])) {
+            JsVar *watchPtr = jsvSkipName(watchNames[i]);
+            Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+            if (jsiHandleWatchEvent(&event, watchPtr, pin)) {
+              jsvRemoveChild(watchArrayPtr, watchNames[i]);
+              jsiWatchesChanged();
+              if (!jsiIsWatchingPin(pin))
+                jshPinWatch(pin, false);
             }
-            jsvUnLock(timeout);
+            jsvUnLock(watchPtr);
           }
-
-          // If we want to execute this watch right now...
-          if (executeNow) {
-            JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(eventTime)/1000);
-            if (jsiShouldExecuteWatch(watchPtr, pinIsHigh)) { // edge triggering
-              JsVar *watchCallback = jsvObjectGetChild(watchPtr, "callback", 0);
-              bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
-              JsVar *data = jsvNewObject();
-              if (data) {
-                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(pinIsHigh));
-                jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                // set both data.time, and watch.lastTime in one go
-                jsvObjectSetChild(data, "time", timePtr); // no unlock
-                jsvObjectSetChildAndUnLock(data, "pin", jsvNewFromPin(pin));
-                Pin dataPin = jshGetEventDataPin(eventType);
-                if (jshIsPinValid(dataPin))
-                  jsvObjectSetChildAndUnLock(data, "data", jsvNewFromBool((event.flags&EV_EXTI_DATA_PIN_HIGH)!=0));
-              }
-              if (!jsiExecuteEventCallback(0, watchCallback, 1, &data) && watchRecurring) {
-                jsError("Ctrl-C while processing watch - removing it.");
-                jsErrorFlags |= JSERR_CALLBACK;
-                watchRecurring = false;
-              }
-              jsvUnLock(data);
-              if (!watchRecurring) {
-                // free all
-                jsvObjectIteratorRemoveAndGotoNext(&it, watchArrayPtr);
-                hasDeletedWatch = true;
-                if (!jsiIsWatchingPin(pin))
-                  jshPinWatch(pin, false);
-              }
-              jsvUnLock(watchCallback);
-            }
-            jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
+          jsvUnLock(watchNames[i]);
+        }
+      } else
+#endif
+      {
+        // Check everything in our Watch array
+        JsvObjectIterator it;
+        jsvObjectIteratorNew(&it, watchArrayPtr);
+        while (jsvObjectIteratorHasValue(&it)) {
+          bool hasDeletedWatch = false;
+          JsVar *watchPtr = jsvObjectIteratorGetValue(&it);
+          Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
+          if (jshIsEventForPin(&event, pin) && jsiHandleWatchEvent(&event, watchPtr, pin)) {
+            // free all
+            jsvObjectIteratorRemoveAndGotoNext(&it, watchArrayPtr);
+            hasDeletedWatch = true;
+            jsiWatchesChanged();
+            if (!jsiIsWatchingPin(pin))
+              jshPinWatch(pin, false);
           }
+          jsvUnLock(watchPtr);
+          if (!hasDeletedWatch)
+            jsvObjectIteratorNext(&it);
         }
-
-        jsvUnLock(watchPtr);
-        if (!hasDeletedWatch)
-          jsvObjectIteratorNext(&it);
+        jsvObjectIteratorFree(&it);
       }
-      jsvObjectIteratorFree(&it);
       jsvUnLock(watchArrayPtr);
     }
   }
 
+  // Make callbacks for watches that had edges coalesced
+  if (jsiWatchesPending)
+    jsiExecutePendingWatches();
+
   // Reset Flow control if it was set...
   if (jshGetEventsUsed() < IOBUFFER_XON) {
     jshSetFlowControlAllReady();
@@ -2074,128 +2425,77 @@ void jsiIdle() {
   if (oldTimeSinceCtrlC > jsiTimeSinceCtrlC)
     jsiTimeSinceCtrlC = 0xFFFFFFFF;
 
+  // Timers with a "time" less than or equal to this are due
+  JsSysTime timeNow = jsiLastIdleTime - jsiTimerBaseTime;
   JsVar *timerArrayPtr = jsvLock(timerArray);
-  JsvObjectIterator it;
-  // Go through all intervals and decrement time
-  jsvObjectIteratorNew(&it, timerArrayPtr);
-  while (jsvObjectIteratorHasValue(&it)) {
-    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
-    JsSysTime timeUntilNext = timerTime - timePassed;
-    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timeUntilNext));
-    jsvUnLock(timerPtr);
-    jsvObjectIteratorNext(&it);
-  }
-  jsvObjectIteratorFree(&it);
-  // Now go through intervals and execute if needed
-  do {
-    jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
-    jsvObjectIteratorNew(&it, timerArrayPtr);
-    while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
-      bool hasDeletedTimer = false;
-      JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+#if ESPR_TIMER_HEAP_SIZE
+  if (jsiStatus & JSIS_TIMERS_CHANGED)
+    jsiTimerHeapRebuild(timerArrayPtr);
+  if (jsiTimerHeapCount >= 0) {
+    // Only look at the timers that are due, soonest first
+    while (jsiTimerHeapCount > 0) {
+      if (jsiStatus & JSIS_TIMERS_CHANGED) {
+        jsiTimerHeapRebuild(timerArrayPtr);
+        if (jsiTimerHeapCount < 0) break; // too many timers - scan them below
+        continue;
+      }
+      if (jsiTimerHeap[0].time > timeNow) {
+        minTimeUntilNext = jsiTimerHeap[0].time - timeNow;
+        break;
+      }
+      JsVar *timerName = jsvLock(jsiTimerHeap[0].name);
+      JsVar *timerPtr = jsvSkipName(timerName);
       JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
-      if (timerTime<=0) {
-        // we're now doing work
-        jsiSetBusy(BUSY_INTERACTIVE, true);
-        wasBusy = true;
-        JsVar *timerCallback = jsvObjectGetChild(timerPtr, "callback", 0);
-        JsVar *watchPtr = jsvObjectGetChild(timerPtr, "watch", 0); // for debounce - may be undefined
-        bool exec = true;
-        JsVar *data = 0;
-        if (watchPtr) {
-          bool watchState = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr, "state", 0));
-          bool timerState = jsvGetBoolAndUnLock(jsvObjectGetChild(timerPtr, "state", 0));
-          jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(timerState));
-          exec = false;
-          if (watchState!=timerState) {
-            // Create the 'time' variable that will be passed to the user and stored as last time
-            JsVarInt delay = jsvGetIntegerAndUnLock(jsvObjectGetChild(watchPtr, "debounce", 0));
-            JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiLastIdleTime+timerTime-delay)/1000);
-            // If it's the right edge...
-            if (jsiShouldExecuteWatch(watchPtr, timerState)) {
-              data = jsvNewObject();
-              // if we were from a watch then we were delayed by the debounce time...
-              if (data) {
-                exec = true;
-                // if it was a watch, set the last state up
-                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
-                // set up the lastTime variable of data to what was in the watch
-                jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChild(watchPtr, "lastTime", 0));
-                // set up the watches lastTime to this one
-                jsvObjectSetChild(data, "time", timePtr); // don't unlock - use this later
-                jsvObjectSetChildAndUnLock(data, "pin", jsvObjectGetChild(watchPtr, "pin", 0));
-              }
-            }
-            // Update lastTime regardless of which edge we're watching
-            jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
-          }
-        }
-        bool removeTimer = false;
-        if (exec) {
-          bool execResult;
-          if (data) {
-            execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
-          } else {
-            JsVar *argsArray = jsvObjectGetChild(timerPtr, "args", 0);
-            execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
-            jsvUnLock(argsArray);
-          }
-          if (!execResult) {
-            JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
-            if (interval) { // if interval then it's setInterval not setTimeout
-              jsvUnLock(interval);
-              jsError("Ctrl-C while processing interval - removing it.");
-              jsErrorFlags |= JSERR_CALLBACK;
-              removeTimer = true;
-            }
-          }
-        }
-        jsvUnLock(data);
-        if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
-          jsvObjectRemoveChild(watchPtr, "timeout");
-          // Deal with non-recurring watches
-          if (exec) {
-            bool watchRecurring = jsvGetBoolAndUnLock(jsvObjectGetChild(watchPtr,  "recur", 0));
-            if (!watchRecurring) {
-              JsVar *watchArrayPtr = jsvLock(watchArray);
-              JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
-              if (watchNamePtr) {
-                jsvRemoveChild(watchArrayPtr, watchNamePtr);
-                jsvUnLock(watchNamePtr);
-              }
-              jsvUnLock(watchArrayPtr);
-              Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(watchPtr, "pin", 0));
-              if (!jsiIsWatchingPin(pin))
-                jshPinWatch(pin, false);
-            }
+      wasBusy = true;
+      bool keepTimer = jsiExecuteTimer(timerPtr, &timerTime);
+      if ((jsiStatus & JSIS_TIMERS_CHANGED) || jsiTimerHeap[0].name != jsvGetRef(timerName)) {
+        jsiTimersChanged(); // rebuild the heap next time around
+        // the timer may already have been removed
+        if (!keepTimer && jsvIsChild(timerArrayPtr, timerName))
+          jsvRemoveChild(timerArrayPtr, timerName);
+      } else if (keepTimer) {
+        // if an interval is still due, leave it until the next idle loop like we would when scanning
+        jsiTimerHeap[0].time = (timerTime > timeNow) ? timerTime : timeNow+1;
+        jsiTimerHeapSiftDown(0);
+      } else {
+        jsvRemoveChild(timerArrayPtr, timerName);
+        jsiTimerHeap[0] = jsiTimerHeap[--jsiTimerHeapCount];
+        jsiTimerHeapSiftDown(0);
+      }
+      jsvUnLock2(timerPtr, timerName);
+    }
+  }
+  if (jsiTimerHeapCount < 0)
+#endif
+  {
+    // Go through all timers and execute if needed
+    JsvObjectIterator it;
+    do {
+      jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
+      jsvObjectIteratorNew(&it, timerArrayPtr);
+      while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
+        bool hasDeletedTimer = false;
+        JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+        JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+        if (timerTime <= timeNow) {
+          wasBusy = true;
+          if (!jsiExecuteTimer(timerPtr, &timerTime)) {
+            // free
+            // Beware... may have already been removed!
+            jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
+            hasDeletedTimer = true;
           }
-          jsvUnLock(watchPtr);
-        }
-        // Load interval *after* executing code, in case it has changed
-        JsVar *interval = jsvObjectGetChild(timerPtr, "interval", 0);
-        if (!removeTimer && interval) {
-          timerTime = timerTime + jsvGetLongInteger(interval);
-          jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime));
-        } else {
-          // free
-          // Beware... may have already been removed!
-          jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
-          hasDeletedTimer = true;
-          timerTime = -1;
         }
-        jsvUnLock2(timerCallback,interval);
+        // update the time until the next timer
+        if (!hasDeletedTimer && timerTime >= timeNow && timerTime-timeNow < minTimeUntilNext)
+          minTimeUntilNext = timerTime-timeNow;
+        if (!hasDeletedTimer)
+          jsvObjectIteratorNext(&it);
+        jsvUnLock(timerPtr);
       }
-      // update the time until the next timer
-      if (timerTime>=0 && timerTime < minTimeUntilNext)
-        minTimeUntilNext = timerTime;
-      // update the timer's time
-      if (!hasDeletedTimer)
-        jsvObjectIteratorNext(&it);
-      jsvUnLock(timerPtr);
-    }
-    jsvObjectIteratorFree(&it);
-  } while (jsiStatus & JSIS_TIMERS_CHANGED);
+      jsvObjectIteratorFree(&it);
+    } while (jsiStatus & JSIS_TIMERS_CHANGED);
+  }
   jsvUnLock(timerArrayPtr);
   /* We might have left the timers loop with stuff to do because the contents of it
    * changed. It's not a big deal because it could only have changed because a timer
@@ -2287,7 +2587,11 @@ void jsiIdle() {
       minTimeUntilNext > jshGetTimeFromMilliseconds(10) &&
       !jsvMoreFreeVariablesThan(JS_VARS_BEFORE_IDLE_GC)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
+#if JSVAR_GC_IDLE_SLICE>0
+    jsvGarbageCollectIdle(); // stops early if events come in
+#else
     jsvGarbageCollect();
+#endif
     jsiSetBusy(BUSY_INTERACTIVE, false);
     /* Return here so we run around the idle loop again
      * and check whether any events came in during GC. If not
@@ -2295,6 +2599,20 @@ void jsiIdle() {
     return;
   }
 
+#if ESPR_STORAGE_IDLE_COMPACT>0 && !defined(SAVE_ON_FLASH)
+  /* If Storage is getting full and we have time, compact a few pages
+   * of it. Storage is left valid after each bit so events can be handled
+   * in between. */
+  if (loopsIdling>=1 &&
+      minTimeUntilNext > jshGetTimeFromMilliseconds(10) &&
+      !jshHasEvents()) {
+    jsiSetBusy(BUSY_INTERACTIVE, true);
+    bool moreToDo = jsfIdleCompact();
+    jsiSetBusy(BUSY_INTERACTIVE, false);
+    if (moreToDo) return; // go around again rather than sleeping
+  }
+#endif
+
   // Go to sleep!
   if (loopsIdling>=1 && // once around the idle loop without having done any work already (just in case)
 #if defined(USB) && !defined(EMSCRIPTEN)
@@ -2418,7 +2736,7 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
     JsVar *timerInterval = jsvObjectGetChild(timer, "interval", 0);
     user_callback(timerInterval ? "setInterval(" : "setTimeout(", user_data);
     jsiDumpJSON(user_callback, user_data, timerCallback, 0);
-    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timer, "time", 0))), timerNumber);
+    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : (jsiTimerGetTime(timer) - jsiLastIdleTime)), timerNumber);
     jsvUnLock3(timerInterval, timerCallback, timerNumber);
     // next
     jsvUnLock(timer);
@@ -2444,6 +2762,8 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
             (watchEdge<0)?"falling":((watchEdge>0)?"rising":"both"));
     if (watchDebounce>0)
       cbprintf(user_callback, user_data, ", debounce : %f", jshGetMillisecondsFromTime(watchDebounce));
+    if (jsvGetBoolAndUnLock(jsvObjectGetChild(watch, "coalesce", 0)))
+      user_callback(", coalesce : true", user_data);
     user_callback(" });\n", user_data);
     jsvUnLock2(watchPin, watchCallback);
     // next
@@ -2466,14 +2786,34 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
 JsVarInt jsiTimerAdd(JsVar *timerPtr) {
   JsVar *timerArrayPtr = jsvLock(timerArray);
   JsVarInt itemIndex = jsvArrayAddToEnd(timerArrayPtr, timerPtr, 1) - 1;
+#if ESPR_TIMER_HEAP_SIZE
+  if (itemIndex>=0 && !(jsiStatus & JSIS_TIMERS_CHANGED) && jsiTimerHeapCount >= 0) {
+    if (jsiTimerHeapCount < ESPR_TIMER_HEAP_SIZE) // the new timer is the last child
+      jsiTimerHeapAdd((JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0)), jsvGetLastChild(timerArrayPtr));
+    else
+      jsiTimersChanged(); // heap is full - rebuilding it will make us scan instead
+  }
+#endif
   jsvUnLock(timerArrayPtr);
   return itemIndex;
 }
 
+void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time) {
+  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(time - jsiTimerBaseTime));
+}
+
+JsSysTime jsiTimerGetTime(JsVar *timerPtr) {
+  return jsiTimerBaseTime + (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChild(timerPtr, "time", 0));
+}
+
 void jsiTimersChanged() {
   jsiStatus |= JSIS_TIMERS_CHANGED;
 }
 
+void jsiWatchesChanged() {
+  jsiStatus |= JSIS_WATCHES_CHANGED;
+}
+
 #ifdef USE_DEBUGGER
 void jsiDebuggerLoop() {
   // exit if:
@@ -2506,7 +2846,17 @@ void jsiDebuggerLoop() {
     while (lineLen < sizeof(lineStr)-1) lineStr[lineLen++]=' ';
     lineStr[lineLen] = 0;
     // print the line of code, prefixed by the line number, and with a pointer to the exact character in question
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+    JsLex sourceLex;
+    JsLex *oldLex = jspTokenCacheSetSourceLex(&sourceLex); // show the original code, not the tokenised copy
+#endif
     jslPrintTokenLineMarker((vcbprintf_callback)jsiConsolePrintString, 0, lex->tokenLastStart, lineStr);
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+    if (oldLex) {
+      jslKill();
+      jslSetLex(oldLex);
+    }
+#endif
   }
 
   while (!(jsiStatus & JSIS_EXIT_DEBUGGER) &&
@@ -156,6 +156,7 @@ typedef enum {
   JSIS_PASSWORD_PROTECTED = 1<<10, ///< Password protected
   JSIS_COMPLETELY_RESET   = 1<<11, ///< Has the board powered on *having not loaded anything from flash*
   JSIS_FIRST_BOOT         = 1<<12, ///< Is this the first time we started, or has load/reset/etc been called?
+  JSIS_WATCHES_CHANGED    = 1<<13, ///< watchArray has changed (so jsiWatchIndex needs rebuilding)
 
   JSIS_ECHO_OFF_MASK = JSIS_ECHO_OFF|JSIS_ECHO_OFF_FOR_LINE,
   JSIS_SOFTINIT_MASK = JSIS_PASSWORD_PROTECTED|JSIS_WATCHDOG_AUTO|JSIS_TODO_MASK|JSIS_FIRST_BOOT|JSIS_COMPLETELY_RESET // stuff that DOESN'T get reset on softinit
@@ -170,6 +171,7 @@ extern Pin pinBusyIndicator;
 extern Pin pinSleepIndicator;
 #endif
 extern JsSysTime jsiLastIdleTime; ///< The last time we went around the idle loop - use this for timers
+extern JsSysTime jsiTimerBaseTime; ///< A timer's "time" is the system time it is due at, minus this
 
 void jsiDumpJSON(vcbprintf_callback user_callback, void *user_data, JsVar *data, JsVar *existing);
 void jsiDumpState(vcbprintf_callback user_callback, void *user_data);
@@ -179,7 +181,12 @@ extern JsVarRef timerArray; // Linked List of timers to check and run
 extern JsVarRef watchArray; // Linked List of input watches to check and run
 
 extern JsVarInt jsiTimerAdd(JsVar *timerPtr);
+/// Set the system time at which a timer is due. Call jsiTimersChanged after if the timer is already in timerArray
+void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time);
+/// Get the system time at which a timer is due
+JsSysTime jsiTimerGetTime(JsVar *timerPtr);
 extern void jsiTimersChanged(); // Flag timers changed so we can skip out of the loop if needed
+extern void jsiWatchesChanged(); // Flag watches added/removed so the index of watches by pin gets rebuilt
 // end for jswrap_interactive/io.c ------------------------------------------------
 
 #ifdef USE_DEBUGGER
@@ -242,12 +242,22 @@ void jspSetNoExecute() {
 }
 
 void jspAppendStackTrace(JsVar *stackTrace) {
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+  JsLex sourceLex;
+  JsLex *oldLex = jspTokenCacheSetSourceLex(&sourceLex);
+#endif
   JsvStringIterator it;
   jsvStringIteratorNew(&it, stackTrace, 0);
   jsvStringIteratorGotoEnd(&it);
   jslPrintPosition((vcbprintf_callback)jsvStringIteratorPrintfCallback, &it, lex->tokenLastStart);
   jslPrintTokenLineMarker((vcbprintf_callback)jsvStringIteratorPrintfCallback, &it, lex->tokenLastStart, 0);
   jsvStringIteratorFree(&it);
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+  if (oldLex) {
+    jslKill();
+    jslSetLex(oldLex);
+  }
+#endif
 }
 
 /// We had an exception (argument is the exception's value)
@@ -487,6 +497,127 @@ NO_INLINE bool jspeParseFunctionCallBrackets() {
   return 0;
 }
 
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+/* Tokenised copies of the code of the functions that were called most
+ * recently (as E.setFlags({pretokenise:1}) would have made when they were
+ * defined). Keywords are single characters and whitespace/comments are gone,
+ * so there's much less for the lexer to do. They're kept here rather than in
+ * the functions themselves so only ESPR_FUNCTION_TOKEN_CACHE functions use the
+ * extra RAM, and they're never saved or visible from JS. Both strings are
+ * locked so they can't be freed (and their refs reused) while they're in the
+ * cache. jspSoftKill empties it. */
+typedef struct {
+  JsVarRef code;         ///< The function's code, or 0 if this entry is unused
+  JsVarRef tokenised;    ///< The tokenised copy, or 0 if tokenising didn't help
+  unsigned int lastUsed; ///< jspTokenCacheUseCounter when this was last used, so we can reuse the least recently used entry
+} JspTokenCacheEntry;
+static JspTokenCacheEntry jspTokenCache[ESPR_FUNCTION_TOKEN_CACHE];
+static unsigned int jspTokenCacheUseCounter;
+
+static void jspTokenCacheRemove(JspTokenCacheEntry *entry) {
+  if (entry->code) jsvUnLock(_jsvGetAddressOf(entry->code));
+  if (entry->tokenised) jsvUnLock(_jsvGetAddressOf(entry->tokenised)); // frees it
+  entry->code = 0;
+  entry->tokenised = 0;
+  entry->lastUsed = 0;
+}
+
+/// Empty the cache (freeing the tokenised code)
+static void jspTokenCacheClear() {
+  for (int i=0;i<ESPR_FUNCTION_TOKEN_CACHE;i++)
+    jspTokenCacheRemove(&jspTokenCache[i]);
+}
+
+/// Return a tokenised copy of the given function code, or 0 if it's no smaller
+static NO_INLINE JsVar *jspNewTokenisedCode(JsVar *code) {
+  size_t codeLength = jsvGetStringLength(code);
+  JsLex newLex;
+  JsLex *oldLex = jslSetLex(&newLex);
+  jslInit(code);
+  JsVar *tokenisedCode = 0;
+  if (lex->tk != LEX_EOF) {
+    JslCharPos codeBegin;
+    jslCharPosNew(&codeBegin, code, lex->tokenStart);
+    tokenisedCode = jslNewTokenisedStringFromLexer(&codeBegin, codeLength);
+    jslCharPosFree(&codeBegin);
+  }
+  jslKill();
+  jslSetLex(oldLex);
+  if (tokenisedCode && jsvGetStringLength(tokenisedCode) >= codeLength) {
+    jsvUnLock(tokenisedCode); // we gained nothing (eg. it was already tokenised)
+    tokenisedCode = 0;
+  }
+#ifdef USE_DEBUGGER
+  // code that's all on one line is no good for stepping through in the debugger
+  if (tokenisedCode && jsvGetStringIndexOf(tokenisedCode, (char)LEX_R_DEBUGGER)>=0) {
+    jsvUnLock(tokenisedCode);
+    tokenisedCode = 0;
+  }
+#endif
+  return tokenisedCode;
+}
+
+/** Get the tokenised copy of a function's code, tokenising it if it's not in
+ * the cache. Returns the locked code to execute, or 0 to use the original */
+static JsVar *jspTokenCacheGet(JsVar *code) {
+  // Only tokenise code that's in RAM - code in flash is there to save RAM
+  if (!jsvIsBasicString(code) && !jsvIsFlatString(code))
+    return 0;
+  JsVarRef codeRef = jsvGetRef(code);
+  JspTokenCacheEntry *entry = &jspTokenCache[0];
+  for (int i=0;i<ESPR_FUNCTION_TOKEN_CACHE;i++) {
+    if (jspTokenCache[i].code == codeRef) {
+      jspTokenCache[i].lastUsed = ++jspTokenCacheUseCounter;
+      return jsvLockSafe(jspTokenCache[i].tokenised);
+    }
+    if (jspTokenCache[i].lastUsed < entry->lastUsed)
+      entry = &jspTokenCache[i];
+  }
+  // don't make us run out of memory just to speed things up
+  if (!jsvMoreFreeVariablesThan((unsigned int)(jsvGetStringLength(code)/JSVAR_DATA_STRING_MAX_LEN) + JS_VARS_BEFORE_IDLE_GC)) {
+    jspTokenCacheClear(); // and give back what we've been using
+    return 0;
+  }
+  JsVar *tokenisedCode = jspNewTokenisedCode(code);
+  jspTokenCacheRemove(entry);
+  entry->code = jsvGetRef(jsvLockAgain(code));
+  entry->tokenised = tokenisedCode ? jsvGetRef(jsvLockAgain(tokenisedCode)) : 0;
+  entry->lastUsed = ++jspTokenCacheUseCounter;
+  return tokenisedCode;
+}
+
+/** If we're executing tokenised code from the cache, make 'sourceLex' the
+ * current lexer - on the function's original code, with tokenLastStart at
+ * the token that matches the current one - so that errors and the debugger
+ * show the code as it was written. Tokenising keeps every token, so we just
+ * count them. Returns the lexer to restore (after jslKill) or 0 if we didn't
+ * change anything */
+JsLex *jspTokenCacheSetSourceLex(JsLex *sourceLex) {
+  if (!lex || !lex->sourceVar) return 0;
+  JsVarRef tokenisedRef = jsvGetRef(lex->sourceVar);
+  JsVar *code = 0;
+  for (int i=0;i<ESPR_FUNCTION_TOKEN_CACHE;i++)
+    if (jspTokenCache[i].tokenised == tokenisedRef)
+      code = jsvLock(jspTokenCache[i].code);
+  if (!code) return 0;
+  size_t tokenPos = lex->tokenLastStart;
+  JsLex *oldLex = jslSetLex(sourceLex);
+  jslInit(oldLex->sourceVar);
+  unsigned int tokens = 0;
+  while (lex->tk!=LEX_EOF && lex->tokenStart<tokenPos) {
+    jslGetNextToken();
+    tokens++;
+  }
+  jslKill();
+  jslInit(code);
+  jsvUnLock(code);
+  while (lex->tk!=LEX_EOF && tokens--)
+    jslGetNextToken();
+  lex->tokenLastStart = lex->tokenStart;
+  return oldLex;
+}
+#endif
+
 /** Handle a function call (assumes we've parsed the function name and we're
  * on the start bracket). 'thisArg' is the value of the 'this' variable when the
  * function is executed (it's usually the parent object)
@@ -762,6 +893,23 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
            * have messed up and left us with the wrong Lexer, so
            * we want to be careful here... */
           if (functionCode) {
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+            // tokenised code is all on one line, so don't use it if we were asked for line numbers or are stepping
+            if (true
+#ifndef ESPR_NO_LINE_NUMBERS
+                && !functionLineNumber
+#endif
+#ifdef USE_DEBUGGER
+                && !(execInfo.execute&EXEC_DEBUGGER_MASK)
+#endif
+                ) {
+              JsVar *functionTokenisedCode = jspTokenCacheGet(functionCode);
+              if (functionTokenisedCode) {
+                jsvUnLock(functionCode);
+                functionCode = functionTokenisedCode;
+              }
+            }
+#endif
 #ifdef USE_DEBUGGER
             bool hadDebuggerNextLineOnly = false;
 
@@ -905,8 +1053,171 @@ JsVar *jspGetNamedVariable(const char *tokenName) {
   return a;
 }
 
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+/** Cache of built-in methods found by jspGetNamedFieldInParents, so that
+ * repeated lookups of things like `g.drawLine`, `arr.push` or `Math.sin`
+ * don't have to search the prototype chain and then the symbol tables. An
+ * entry is keyed on the kind of object the lookup was on (for objects, what
+ * their __proto__ is) and the field name. Entries are only valid while
+ * jspLookupCacheVersion is unchanged - jsvar.c calls
+ * jspLookupCacheInvalidate whenever something changes that could have
+ * altered the result of a lookup.
+ *
+ * The prototypes (and built-in constructors) that cached lookups searched
+ * are kept in jspLookupCacheProtos, so that only adding or removing children
+ * of those invalidates the cache (see jspLookupCacheUses). */
+typedef struct {
+  unsigned int version; ///< jspLookupCacheVersion when this was filled in (0 = unused)
+  unsigned char type; ///< JSV_VARTYPEMASK part of the object's flags
+  void *key; ///< __proto__ ref for objects, function pointer for native functions, ArrayBuffer type - or 0
+  char name[JSPARSE_LOOKUP_CACHE_NAME_LEN]; ///< Name of the field (0 terminated)
+  void (*functionPtr)(void); ///< The native function that was found
+  unsigned short functionSpec; ///< argTypes of the native function that was found
+} JspLookupCacheEntry;
+static JspLookupCacheEntry jspLookupCache[JSPARSE_LOOKUP_CACHE_SIZE];
+static unsigned int jspLookupCacheVersion = 1;
+static JsVarRef jspLookupCacheProtos[JSPARSE_LOOKUP_CACHE_PROTOS];
+static unsigned char jspLookupCacheProtoCount = 0;
+
+void jspLookupCacheInvalidate() {
+  jspLookupCacheProtoCount = 0;
+  jspLookupCacheVersion++;
+  if (!jspLookupCacheVersion) { // wrapped - make sure old entries can't match
+    memset(jspLookupCache, 0, sizeof(jspLookupCache));
+    jspLookupCacheVersion = 1;
+  }
+}
+
+void jspLookupCacheForget(JsVarRef ref) {
+  for (int i=0;i<JSPARSE_LOOKUP_CACHE_SIZE;i++)
+    if (jspLookupCache[i].type==JSV_OBJECT && jspLookupCache[i].key==(void*)(size_t)ref)
+      jspLookupCache[i].version = 0;
+}
+
+bool jspLookupCacheUses(JsVar *var) {
+  if (!jspLookupCacheProtoCount) return false;
+  JsVarRef ref = jsvGetRef(var);
+  for (int i=0;i<jspLookupCacheProtoCount;i++)
+    if (jspLookupCacheProtos[i]==ref) return true;
+  return false;
+}
+
+/** Add var to jspLookupCacheProtos. Returns false if it was already there,
+ * or if there's no room (in which case the cache is invalidated) */
+static bool jspLookupCacheAddProto(JsVar *var) {
+  if (jspLookupCacheUses(var)) return false;
+  if (jspLookupCacheProtoCount>=JSPARSE_LOOKUP_CACHE_PROTOS) {
+    jspLookupCacheInvalidate();
+    return false;
+  }
+  jspLookupCacheProtos[jspLookupCacheProtoCount++] = jsvGetRef(var);
+  return true;
+}
+
+/** Add the built-in constructor 'className' in root and its prototype to
+ * jspLookupCacheProtos. Returns false if the cache had to be invalidated */
+static bool jspLookupCacheAddConstructor(const char *className) {
+  JsVar *obj = jsvObjectGetChild(execInfo.root, className, 0);
+  if (!jsvHasChildren(obj)) {
+    jsvUnLock(obj);
+    return true;
+  }
+  unsigned int version = jspLookupCacheVersion;
+  jspLookupCacheAddProto(obj);
+  JsVar *proto = jsvObjectGetChild(obj, JSPARSE_PROTOTYPE_VAR, 0);
+  if (proto) jspLookupCacheAddProto(proto);
+  jsvUnLock2(proto, obj);
+  return version==jspLookupCacheVersion;
+}
+
+/** Add everything jspeiFindChildFromStringInParents searched for 'parent' to
+ * jspLookupCacheProtos. Returns false if the cache had to be invalidated */
+static bool jspLookupCacheAddParents(JsVar *parent) {
+  if (jsvIsObject(parent)) {
+    JsVar *inheritsFrom = jsvObjectGetChild(parent, JSPARSE_INHERITS_VAR, 0);
+    if (!inheritsFrom) return jspLookupCacheAddConstructor("Object");
+    unsigned int version = jspLookupCacheVersion;
+    // if it was already there, so were its parents
+    if (inheritsFrom!=parent && jspLookupCacheAddProto(inheritsFrom))
+      jspLookupCacheAddParents(inheritsFrom);
+    jsvUnLock(inheritsFrom);
+    return version==jspLookupCacheVersion;
+  }
+  const char *objectName = jswGetBasicObjectName(parent);
+  while (objectName) {
+    if (!jspLookupCacheAddConstructor(objectName)) return false;
+    objectName = jswGetBasicObjectPrototypeName(objectName);
+  }
+  return true;
+}
+
+/** Get the cache entry that the lookup of 'name' on 'object' uses, filling in
+ * its type/key/name if it doesn't currently match. Returns 0 if this lookup
+ * can't be cached. *hit is set if the entry contains a valid result */
+static JspLookupCacheEntry *jspLookupCacheGet(JsVar *object, const char *name, bool *hit) {
+  *hit = false;
+  if (!object || jsvIsRoot(object)) return 0;
+  size_t nameLen = strlen(name);
+  if (nameLen >= JSPARSE_LOOKUP_CACHE_NAME_LEN) return 0;
+  unsigned char type = (unsigned char)(object->flags & JSV_VARTYPEMASK);
+  void *key = 0;
+  if (jsvIsObject(object)) {
+    JsVar *proto = jsvObjectGetChild(object, JSPARSE_INHERITS_VAR, 0);
+    if (proto && !jsvIsObject(proto)) { // only objects call jspLookupCacheForget when freed
+      jsvUnLock(proto);
+      return 0;
+    }
+    if (proto) key = (void*)(size_t)jsvGetRef(proto);
+    jsvUnLock(proto);
+  } else if (jsvIsNativeFunction(object)) {
+    key = (void*)object->varData.native.ptr;
+  } else if (jsvIsArrayBuffer(object)) {
+    key = (void*)(size_t)object->varData.arraybuffer.type;
+  } else if (jsvIsString(object)) {
+    type = JSV_STRING_0; // strings have a different type for each length
+  }
+  unsigned int hash = (unsigned int)type*31 + (unsigned int)(size_t)key;
+  for (size_t i=0;i<nameLen;i++) hash = hash*33 + (unsigned char)name[i];
+  JspLookupCacheEntry *entry = &jspLookupCache[hash & (JSPARSE_LOOKUP_CACHE_SIZE-1)];
+  if (entry->version==jspLookupCacheVersion && entry->type==type && entry->key==key &&
+      memcmp(entry->name, name, nameLen+1)==0) {
+    *hit = true;
+  } else {
+    entry->version = 0; // not valid until we fill in a result
+    entry->type = type;
+    entry->key = key;
+    memcpy(entry->name, name, nameLen+1);
+  }
+  return entry;
+}
+#endif
+
 /// Used by jspGetNamedField / jspGetVarNamedField
 static NO_INLINE JsVar *jspGetNamedFieldInParents(JsVar *object, const char* name, bool returnName) {
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  bool cacheHit;
+  JspLookupCacheEntry *cacheEntry = jspLookupCacheGet(object, name, &cacheHit);
+  JsVar *child;
+  if (cacheHit) {
+    child = jsvNewNativeFunction(cacheEntry->functionPtr, cacheEntry->functionSpec);
+  } else {
+    // Now look in prototypes
+    child = jspeiFindChildFromStringInParents(object, name);
+
+    /* Check for builtins via separate function
+     * This way we save on RAM for built-ins because everything comes out of program code */
+    if (!child) {
+      child = jswFindBuiltInFunction(object, name);
+      // if we found a built-in method, remember it
+      if (cacheEntry && jsvIsNativeFunction(child) && !jsvGetFirstChild(child) &&
+          jspLookupCacheAddParents(object)) {
+        cacheEntry->functionPtr = child->varData.native.ptr;
+        cacheEntry->functionSpec = child->varData.native.argTypes;
+        cacheEntry->version = jspLookupCacheVersion;
+      }
+    }
+  }
+#else
   // Now look in prototypes
   JsVar * child = jspeiFindChildFromStringInParents(object, name);
 
@@ -915,6 +1226,7 @@ static NO_INLINE JsVar *jspGetNamedFieldInParents(JsVar *object, const char* nam
   if (!child) {
     child = jswFindBuiltInFunction(object, name);
   }
+#endif
 
   /* We didn't get here if we found a child in the object itself, so
    * if we're here then we probably have the wrong name - so for example
@@ -2439,17 +2751,10 @@ NO_INLINE JsVar *jspeStatementFor() {
     jslCharPosFromLex(&forBodyStart);
     JSP_MATCH_WITH_CLEANUP_AND_RETURN(')', jsvUnLock2(forStatement, array);jslCharPosFree(&forBodyStart), 0);
 
-    // Simply scan over the loop the first time without executing to figure out where it ends
-    // OPT: we could skip the first parse and actually execute the first time
-    JSP_SAVE_EXECUTE();
-    jspSetNoExecute();
-    execInfo.execute |= EXEC_IN_LOOP;
-    jsvUnLock(jspeBlockOrStatement());
+    /* We find out where the loop ends the first time we execute the body,
+     * so we don't have to scan over it once without executing first. */
     JslCharPos forBodyEnd;
-    jslCharPosNew(&forBodyEnd, lex->sourceVar, lex->tokenStart);
-    if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
-    JSP_RESTORE_EXECUTE();
-    // Now start executing properly
+    bool hasForBodyEnd = false;
     if (JSP_SHOULD_EXECUTE) {
       if (jsvIsIterable(array)) {
         JsvIsInternalChecker checkerFunction = jsvGetInternalFunctionCheckerFor(array);
@@ -2486,10 +2791,14 @@ NO_INLINE JsVar *jspeStatementFor() {
               jsvReplaceWithOrAddToRoot(forStatement, iteratorValue);
               if (iteratorValue!=loopIndexVar) jsvUnLock(iteratorValue);
 
-              jslSeekToP(&forBodyStart);
+              if (hasForBodyEnd) jslSeekToP(&forBodyStart);
               execInfo.execute |= EXEC_IN_LOOP;
               jspDebuggerLoopIfCtrlC();
               jsvUnLock(jspeBlockOrStatement());
+              if (!hasForBodyEnd) {
+                jslCharPosNew(&forBodyEnd, lex->sourceVar, lex->tokenStart);
+                hasForBodyEnd = true;
+              }
               if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
 
               hasHadBreak |= jspeCheckBreakContinue();
@@ -2513,6 +2822,16 @@ NO_INLINE JsVar *jspeStatementFor() {
         jsExceptionHere(JSET_ERROR, "FOR loop can only iterate over Arrays, Strings or Objects, not %t", array);
       }
     }
+    if (!hasForBodyEnd) {
+      // We never executed the loop body, so scan over it without executing to figure out where it ends
+      JSP_SAVE_EXECUTE();
+      jspSetNoExecute();
+      execInfo.execute |= EXEC_IN_LOOP;
+      jsvUnLock(jspeBlockOrStatement());
+      jslCharPosNew(&forBodyEnd, lex->sourceVar, lex->tokenStart);
+      if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
+      JSP_RESTORE_EXECUTE();
+    }
     jslSeekToP(&forBodyEnd);
     jslCharPosFree(&forBodyStart);
     jslCharPosFree(&forBodyEnd);
@@ -2949,6 +3268,9 @@ JsVar *jspGetConstructor(JsVar *object) {
 // -----------------------------------------------------------------------------
 
 void jspSoftInit() {
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  jspLookupCacheInvalidate();
+#endif
   execInfo.root = jsvFindOrCreateRoot();
   // Root now has a lock and a ref
   execInfo.hiddenRoot = jsvObjectGetChild(execInfo.root, JS_HIDDEN_CHAR_STR, JSV_OBJECT);
@@ -2956,6 +3278,9 @@ void jspSoftInit() {
 }
 
 void jspSoftKill() {
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+  jspTokenCacheClear();
+#endif
   jsvUnLock(execInfo.scopesVar);
   execInfo.scopesVar = 0;
   jsvUnLock(execInfo.hiddenRoot);
@@ -31,6 +31,19 @@ JsVar *jspGetPrototype(JsVar *object);
 /** Get the constructor of the given object, or return 0 if ot found, or not a function */
 JsVar *jspGetConstructor(JsVar *object);
 
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+/// Something has changed that could alter what a lookup in a prototype chain finds, so forget cached built-in lookups
+void jspLookupCacheInvalidate();
+/// The var with the given ref has been freed, so forget any cached lookups that used it as a __proto__
+void jspLookupCacheForget(JsVarRef ref);
+/// Was var searched by any cached lookup? If so, adding or removing its children means calling jspLookupCacheInvalidate
+bool jspLookupCacheUses(JsVar *var);
+#endif
+#if ESPR_FUNCTION_TOKEN_CACHE>0
+/// If executing cached tokenised code, make sourceLex the lexer for the original code at the same token. Returns the lexer to restore, or 0
+JsLex *jspTokenCacheSetSourceLex(JsLex *sourceLex);
+#endif
+
 /// Check that we have enough stack to recurse. Return true if all ok, error if not.
 bool jspCheckStackPosition();
 
@@ -22,6 +22,12 @@ void jsserialHardwareFunc(unsigned char data, serial_sender_data *info) {
   jshTransmit(device, data);
 }
 
+// Like jsserialHardwareFunc, but for a whole block of data at once
+static void jsserialHardwareBufferFunc(unsigned char *data, unsigned int len, void *info) {
+  IOEventFlags device = *(IOEventFlags*)info;
+  jshTransmitBuffer(device, data, len);
+}
+
 #ifndef SAVE_ON_FLASH
 /**
  * Send a single byte through Serial.
@@ -189,6 +195,13 @@ bool jsserialGetSendFunction(JsVar *serialDevice, serial_sender *serialSend, ser
   return false;
 }
 
+/// Send data (anything jsvIterateCallback accepts) using the function from jsserialGetSendFunction
+bool jsserialSendData(JsVar *data, serial_sender serialSend, serial_sender_data *serialSendData) {
+  if (serialSend == jsserialHardwareFunc) // real device - send in blocks rather than byte by byte
+    return jsvIterateBufferCallback(data, jsserialHardwareBufferFunc, (void*)serialSendData);
+  return jsvIterateCallback(data, (jsvIterateCallbackFn)serialSend, (void*)serialSendData);
+}
+
 #ifndef SAVE_ON_FLASH
 typedef struct {
   char buf[64]; ///< received data
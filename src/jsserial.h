@@ -21,6 +21,8 @@ bool jsserialPopulateUSARTInfo(JshUSARTInfo *inf, JsVar *baud,  JsVar *options);
 
 // Get the correct Serial send function (and the data to send to it).
 bool jsserialGetSendFunction(JsVar *serialDevice, serial_sender *serialSend, serial_sender_data *serialSendData);
+/// Send data (anything jsvIterateCallback accepts) using the function from jsserialGetSendFunction
+bool jsserialSendData(JsVar *data, serial_sender serialSend, serial_sender_data *serialSendData);
 
 /// Start watching serial RX pin and setup data for it
 bool jsserialEventCallbackInit(JsVar *parent, JshUSARTInfo *inf);
@@ -303,6 +303,138 @@ typedef int64_t JsSysTime;
 #define JS_VARS_BEFORE_IDLE_GC 32
 #endif
 
+/* If an object needs more than this many children to be scanned in order to
+ * find a named child, a hash index of its child names is built (see
+ * jsvFindChildFromString/Var). 0 disables hash indexes entirely. */
+#ifndef JSVAR_HASH_INDEX_THRESHOLD
+#define JSVAR_HASH_INDEX_THRESHOLD 0
+#endif
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+#ifndef JSVAR_HASH_INDEX_COUNT
+#define JSVAR_HASH_INDEX_COUNT 4 ///< How many objects can have a hash index at once
+#endif
+#ifndef JSVAR_HASH_INDEX_SLOTS
+#define JSVAR_HASH_INDEX_SLOTS 1024 ///< Slots in each hash index - must be a power of 2. Objects with more than 3/4 of this many children aren't indexed
+#endif
+#endif
+
+/* If an array has at least this many elements, build an index of where its
+ * elements are (see jsvGetArrayIndex) so arr[i] doesn't have to scan the
+ * array. 0 disables array indexes entirely. */
+#ifndef JSVAR_ARRAY_INDEX_THRESHOLD
+#define JSVAR_ARRAY_INDEX_THRESHOLD 0
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+#ifndef JSVAR_ARRAY_INDEX_COUNT
+#define JSVAR_ARRAY_INDEX_COUNT 4 ///< How many arrays can have an index at once
+#endif
+#ifndef JSVAR_ARRAY_INDEX_SLOTS
+#define JSVAR_ARRAY_INDEX_SLOTS 4096 ///< How many elements of each array can be indexed (elements after this are found by scanning)
+#endif
+#endif
+
+/* How many long strings to remember the last block of, so appending to them
+ * doesn't have to walk the whole string (see jsvStringIteratorGotoEnd).
+ * 0 disables this */
+#ifndef JSVAR_STRING_TAIL_CACHE_SIZE
+#define JSVAR_STRING_TAIL_CACHE_SIZE 0
+#endif
+#define JSVAR_STRING_TAIL_MIN_BLOCKS 4 ///< Strings with fewer StringExts than this are quick enough to walk, so aren't cached
+
+/* How many functions to keep a tokenised copy of the code of, so it doesn't
+ * have to be lexed from the original source every time they're called. Each one
+ * uses RAM for the tokenised code (often around half the size of the original).
+ * 0 disables this */
+#ifndef ESPR_FUNCTION_TOKEN_CACHE
+#define ESPR_FUNCTION_TOKEN_CACHE 0
+#endif
+
+/* How many built-in method lookups (eg. `Math.sin` or `arr.push`) to cache
+ * (see jspGetNamedFieldInParents). Must be a power of 2, 0 disables the cache */
+#ifndef JSPARSE_LOOKUP_CACHE_SIZE
+#define JSPARSE_LOOKUP_CACHE_SIZE 0
+#endif
+#define JSPARSE_LOOKUP_CACHE_NAME_LEN 16 ///< Field names must be shorter than this to be cached
+#define JSPARSE_LOOKUP_CACHE_PROTOS 16 ///< How many prototypes (and constructors) cached lookups can have searched
+
+/* How many vars the garbage collector's mark stack can hold. If it fills up,
+ * marking still completes but has to rescan memory (see jsvGarbageCollect) */
+#ifndef JSVAR_GC_MARK_STACK_SIZE
+#define JSVAR_GC_MARK_STACK_SIZE 64
+#endif
+/* When garbage collecting from idle, check for pending events every this
+ * many vars and stop if there are any (see jsvGarbageCollectIdle). 0 disables */
+#ifndef JSVAR_GC_IDLE_SLICE
+#define JSVAR_GC_IDLE_SLICE 0
+#endif
+/* How many vars to use as a nursery for new variables, which is garbage
+ * collected on its own when it fills up (see jsvGarbageCollectNursery).
+ * Must be a power of 2, and with RESIZABLE_JSVARS must divide JSVAR_BLOCK_SIZE.
+ * 0 disables the nursery */
+#ifndef JSVAR_NURSERY_SIZE
+#define JSVAR_NURSERY_SIZE 0
+#endif
+/* How many vars outside the nursery that link into it we can remember. If
+ * there are more, the nursery GC has to look at all vars. Must be a power of 2 */
+#ifndef JSVAR_NURSERY_REMEMBER_SIZE
+#define JSVAR_NURSERY_REMEMBER_SIZE 128
+#endif
+/* How many files the index of where files are in Storage has room for (see
+ * jsfFindFile). Must be a power of 2, 0 disables the index */
+#ifndef ESPR_STORAGE_INDEX_SIZE
+#define ESPR_STORAGE_INDEX_SIZE 0
+#endif
+/* When a file is created with less than ESPR_STORAGE_IDLE_COMPACT_FREE bytes
+ * of Storage after it, compact Storage from idle, erasing about this many
+ * pages each time around the idle loop (see jsfIdleCompact). 0 disables */
+#ifndef ESPR_STORAGE_IDLE_COMPACT
+#define ESPR_STORAGE_IDLE_COMPACT 0
+#endif
+#ifndef ESPR_STORAGE_IDLE_COMPACT_FREE
+#define ESPR_STORAGE_IDLE_COMPACT_FREE 16384
+#endif
+/* How many StorageFiles we remember the last chunk and length of, so opening
+ * them for append and getLength don't have to find every chunk. 0 disables */
+#ifndef ESPR_STORAGEFILE_CACHE_SIZE
+#define ESPR_STORAGEFILE_CACHE_SIZE 0
+#endif
+/* If nonzero, save() stores the RAM image as separate files each with this many
+ * bytes of JsVars in, and only rewrites the ones that have changed */
+#ifndef ESPR_VARIMAGE_BLOCK_SIZE
+#define ESPR_VARIMAGE_BLOCK_SIZE 0
+#endif
+/* With SPIFLASH_BASE, how many 64 byte lines of flash to cache for reading
+ * Flash Strings, so iterating over them doesn't read flash 16 bytes at a time
+ * (see jsvFlashStringCacheRead). 0 disables */
+#ifndef ESPR_FLASH_STRING_CACHE
+#define ESPR_FLASH_STRING_CACHE 0
+#endif
+/* If nonzero, count page erases, bytes written and file lookups done by Storage
+ * for Storage.getStats. This is the number of pages to count erases of
+ * separately (4 bytes of RAM each). 0 disables */
+#ifndef ESPR_STORAGE_STATS
+#define ESPR_STORAGE_STATS 0
+#endif
+/* If nonzero, keep timers in a binary heap of this many entries sorted by when
+ * they're due, so the idle loop only has to look at the ones that are due. If there
+ * are more timers than this, all timers are checked each time. 0 disables */
+#ifndef ESPR_TIMER_HEAP_SIZE
+#define ESPR_TIMER_HEAP_SIZE 0
+#endif
+/* If nonzero, keep an index of up to this many watches by EXTI channel so an
+ * edge only has to look at the watches for its pin. If there are more watches
+ * than this, all watches are checked for each edge. 0 disables */
+#ifndef ESPR_WATCH_INDEX_SIZE
+#define ESPR_WATCH_INDEX_SIZE 0
+#endif
+
+/** Count the events each device has lost because the IO event queue was full,
+ * and keep track of the most the IO and transmit queues have had in them,
+ * for E.getIOStats(). 0 disables */
+#ifndef ESPR_IO_STATS
+#define ESPR_IO_STATS 0
+#endif
+
 // javascript specific names
 #define JSPARSE_RETURN_VAR "return" // variable name used for returning function results
 #define JSPARSE_PROTOTYPE_VAR "prototype"
@@ -59,6 +59,37 @@ typedef enum {
 
 volatile bool touchedFreeList = false;
 volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
+static unsigned int jsVarsUsed; ///< How many vars are in use right now
+static unsigned int jsVarsPeakUsed; ///< The most vars that have been in use since jsvResetMemoryPeak
+static unsigned int jsvGarbageCollectCount; ///< How many full garbage collections have finished
+#if JSVAR_NURSERY_SIZE>0
+#if defined(RESIZABLE_JSVARS) && (JSVAR_BLOCK_SIZE % JSVAR_NURSERY_SIZE)
+#error JSVAR_NURSERY_SIZE must divide JSVAR_BLOCK_SIZE
+#endif
+/* The nursery is a block of JSVAR_NURSERY_SIZE vars with its own free list.
+ * New vars come from it first, and when it fills up we garbage collect just
+ * the nursery (see jsvGarbageCollectNursery), which is a lot quicker than
+ * collecting everything. */
+JsVarRef jsVarNurseryStart = 0; ///< first var in the nursery, or 0 if there's no nursery right now
+JsVar *jsVarNurseryStartPtr = 0; ///< address of jsVarNurseryStart (the nursery never crosses a RESIZABLE_JSVARS block)
+JsVarRef jsVarNurseryFirstVar = 0; ///< first var in the nursery that isn't part of a flat string that started before it
+volatile JsVarRef jsVarNurseryFirstEmpty = 0; ///< reference of first unused variable in the nursery
+/* Vars outside the nursery that link to vars inside it. These are what the
+ * nursery GC uses instead of having to look through all of memory. There are
+ * two tables so one can be rebuilt from the other during GC. */
+static JsVar *jsvNurseryRemembered[2][JSVAR_NURSERY_REMEMBER_SIZE];
+static unsigned int jsvNurseryRememberedTable = 0; ///< which of jsvNurseryRemembered is in use
+static unsigned int jsvNurseryRememberedCount = 0;
+static bool jsvNurseryRememberedAll = true; ///< if set, we don't know what links to the nursery, so must look at all vars
+static void jsvNurseryRemember(JsVar *var);
+static unsigned int jsvGarbageCollectNursery();
+#define jsvIsNurseryRef(REF) (jsVarNurseryStart && (REF)>=jsVarNurseryStart && (REF)<jsVarNurseryStart+JSVAR_NURSERY_SIZE)
+#define jsvIsNurseryVar(VAR) ((VAR)>=jsVarNurseryStartPtr && (VAR)<jsVarNurseryStartPtr+JSVAR_NURSERY_SIZE)
+/// If a var outside the nursery is made to link to one inside it, remember it
+#define jsvNurseryWriteBarrier(VAR, REF) if (jsvIsNurseryRef(REF) && !jsvIsNurseryVar(VAR)) jsvNurseryRemember(VAR)
+#else
+#define jsvNurseryWriteBarrier(VAR, REF)
+#endif
 volatile MemBusyType isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
 
 // ----------------------------------------------------------------------------
@@ -73,10 +104,10 @@ JsVarRefSigned jsvGetFirstChildSigned(const JsVar *v) {
 JsVarRef jsvGetLastChild(const JsVar *v) { return v->varData.ref.lastChild; }
 JsVarRef jsvGetNextSibling(const JsVar *v) { return v->varData.ref.nextSibling; }
 JsVarRef jsvGetPrevSibling(const JsVar *v) { return v->varData.ref.prevSibling; }
-void jsvSetFirstChild(JsVar *v, JsVarRef r) { v->varData.ref.firstChild = r; }
-void jsvSetLastChild(JsVar *v, JsVarRef r) { v->varData.ref.lastChild = r; }
-void jsvSetNextSibling(JsVar *v, JsVarRef r) { v->varData.ref.nextSibling = r; }
-void jsvSetPrevSibling(JsVar *v, JsVarRef r) { v->varData.ref.prevSibling = r; }
+void jsvSetFirstChild(JsVar *v, JsVarRef r) { v->varData.ref.firstChild = r; jsvNurseryWriteBarrier(v, r); }
+void jsvSetLastChild(JsVar *v, JsVarRef r) { v->varData.ref.lastChild = r; jsvNurseryWriteBarrier(v, r); }
+void jsvSetNextSibling(JsVar *v, JsVarRef r) { v->varData.ref.nextSibling = r; jsvNurseryWriteBarrier(v, r); }
+void jsvSetPrevSibling(JsVar *v, JsVarRef r) { v->varData.ref.prevSibling = r; jsvNurseryWriteBarrier(v, r); }
 
 JsVarRefCounter jsvGetRefs(JsVar *v) { return v->varData.ref.refs; }
 void jsvSetRefs(JsVar *v, JsVarRefCounter refs) { v->varData.ref.refs = refs; }
@@ -175,6 +206,149 @@ void jsvSetMaxVarsUsed(unsigned int size) {
   jsVarsSize = size;
 }
 
+#if JSVAR_NURSERY_SIZE>0
+/// Forget everything we remembered as linking to the nursery, so that the next nursery GC has to look at all vars
+static void jsvNurseryForgetAll() {
+  memset(jsvNurseryRemembered[jsvNurseryRememberedTable], 0, sizeof(jsvNurseryRemembered[0]));
+  jsvNurseryRememberedCount = 0;
+  jsvNurseryRememberedAll = true;
+}
+
+/// Remember that this var (outside the nursery) links to something in the nursery
+static void jsvNurseryRemember(JsVar *var) {
+  if (jsvNurseryRememberedAll) return;
+  JsVar **table = jsvNurseryRemembered[jsvNurseryRememberedTable];
+  unsigned int h = (unsigned int)((size_t)var / sizeof(JsVar)) & (JSVAR_NURSERY_REMEMBER_SIZE-1);
+  while (table[h]) {
+    if (table[h]==var) return; // already remembered
+    h = (h+1) & (JSVAR_NURSERY_REMEMBER_SIZE-1);
+  }
+  if (jsvNurseryRememberedCount >= JSVAR_NURSERY_REMEMBER_SIZE*3/4) {
+    // too many - just look at everything next time
+    jsvNurseryRememberedAll = true;
+    return;
+  }
+  table[h] = var;
+  jsvNurseryRememberedCount++;
+}
+
+/** A flat string has been made out of these blocks, so any we remembered
+ * aren't vars any more. Leave a marker (1) so the hash table still works */
+static void jsvNurseryForgetRange(JsVar *from, size_t blocks) {
+  if (jsvNurseryRememberedAll) return;
+  JsVar **table = jsvNurseryRemembered[jsvNurseryRememberedTable];
+  for (unsigned int h=0;h<JSVAR_NURSERY_REMEMBER_SIZE;h++)
+    if (table[h]>=from && table[h]<from+blocks)
+      table[h] = (JsVar*)1;
+}
+
+/// Does this var link to anything in the nursery?
+static bool jsvNurseryIsLinkedFrom(JsVar *var) {
+  if (jsvHasStringExt(var) && jsvIsNurseryRef(jsvGetLastChild(var)))
+    return true;
+  if ((jsvHasSingleChild(var) || jsvHasChildren(var)) && jsvIsNurseryRef(jsvGetFirstChild(var)))
+    return true;
+  if (jsvHasChildren(var) && jsvIsNurseryRef(jsvGetLastChild(var)))
+    return true;
+  if (jsvIsName(var) && !jsvIsArrayBufferName(var) &&
+      (jsvIsNurseryRef(jsvGetNextSibling(var)) || jsvIsNurseryRef(jsvGetPrevSibling(var))))
+    return true;
+  return false;
+}
+
+/// Give the nursery's free vars back to the main free list, and stop using the nursery
+static void jsvNurseryRelease() {
+  jshInterruptOff();
+  if (jsVarNurseryFirstEmpty) {
+    JsVar *last = jsvGetAddressOf(jsVarNurseryFirstEmpty);
+    while (jsvGetNextSibling(last))
+      last = jsvGetAddressOf(jsvGetNextSibling(last));
+    jsvSetNextSibling(last, jsVarFirstEmpty);
+    jsVarFirstEmpty = jsVarNurseryFirstEmpty;
+    jsVarNurseryFirstEmpty = 0;
+    touchedFreeList = true;
+  }
+  jsVarNurseryStart = 0;
+  jsVarNurseryStartPtr = 0;
+  jshInterruptOn();
+}
+
+/// Is the nursery missing, or too full of vars that are still in use to be worth using?
+static bool jsvNurseryIsClogged() {
+  if (!jsVarNurseryStart) return true;
+  unsigned int count = 0;
+  JsVarRef r = jsVarNurseryFirstEmpty;
+  while (r && count<JSVAR_NURSERY_SIZE/4) {
+    count++;
+    r = jsvGetNextSibling(jsvGetAddressOf(r));
+  }
+  return count<JSVAR_NURSERY_SIZE/4;
+}
+
+/** Make the emptiest JSVAR_NURSERY_SIZE block of memory the nursery, and
+ * move its free vars over to the nursery's free list. If nowhere is empty
+ * enough, we just don't use a nursery. Anything that was in the old nursery
+ * is now treated like any other var. */
+static void jsvNurseryPlace() {
+  jsvNurseryRelease();
+  unsigned int chunks = jsVarsSize / JSVAR_NURSERY_SIZE;
+  unsigned int chunk = 0, chunkFree = 0;
+  unsigned int bestChunk = 0, bestFree = JSVAR_NURSERY_SIZE/4; // any less and it's not worth it
+  JsVarRef i, chunkFirst = 1, bestFirst = 0;
+  for (i=1;i<=jsVarsSize;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    unsigned int c = (unsigned int)(i-1) / JSVAR_NURSERY_SIZE;
+    if (c != chunk) {
+      // prefer later chunks, as normal allocations come from the start of memory
+      if (chunk<chunks && chunkFree>=bestFree) {
+        bestChunk = chunk+1;
+        bestFree = chunkFree;
+        bestFirst = chunkFirst;
+      }
+      chunk = c;
+      chunkFree = 0;
+      chunkFirst = i; // may not be the start of the chunk if a flat string was in the way
+    }
+    if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
+      chunkFree++;
+    } else if (jsvIsFlatString(var)) {
+      // skip over used blocks for flat strings
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+  }
+  if (chunk<chunks && chunkFree>=bestFree) {
+    bestChunk = chunk+1;
+    bestFirst = chunkFirst;
+  }
+  if (!bestChunk) return;
+  jshInterruptOff();
+  jsVarNurseryStart = (JsVarRef)((bestChunk-1)*JSVAR_NURSERY_SIZE + 1);
+  jsVarNurseryStartPtr = jsvGetAddressOf(jsVarNurseryStart);
+  jsVarNurseryFirstVar = bestFirst;
+  // move free vars in the nursery over to its own free list
+  JsVarRef prev = 0, lastNursery = 0, r = jsVarFirstEmpty;
+  while (r) {
+    JsVar *var = jsvGetAddressOf(r);
+    JsVarRef next = jsvGetNextSibling(var);
+    if (jsvIsNurseryRef(r)) {
+      if (prev) jsvSetNextSibling(jsvGetAddressOf(prev), next);
+      else jsVarFirstEmpty = next;
+      jsvSetNextSibling(var, 0);
+      if (lastNursery) jsvSetNextSibling(jsvGetAddressOf(lastNursery), r);
+      else jsVarNurseryFirstEmpty = r;
+      lastNursery = r;
+    } else {
+      prev = r;
+    }
+    r = next;
+  }
+  touchedFreeList = true;
+  jshInterruptOn();
+  // We've no idea what links into the new nursery
+  jsvNurseryForgetAll();
+}
+#endif
+
 // maps the empty variables in...
 void jsvCreateEmptyVarList() {
   assert(!isMemoryBusy);
@@ -183,6 +357,7 @@ void jsvCreateEmptyVarList() {
   JsVar firstVar; // temporary var to simplify code in the loop below
   jsvSetNextSibling(&firstVar, 0);
   JsVar *lastEmpty = &firstVar;
+  jsVarsUsed = jsVarsSize;
 
   JsVarRef i;
   for (i=1;i<=jsVarsSize;i++) {
@@ -190,6 +365,7 @@ void jsvCreateEmptyVarList() {
     if ((var->flags&JSV_VARTYPEMASK) == JSV_UNUSED) {
       jsvSetNextSibling(lastEmpty, i);
       lastEmpty = var;
+      jsVarsUsed--;
     } else if (jsvIsFlatString(var)) {
       // skip over used blocks for flat strings
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
@@ -197,6 +373,10 @@ void jsvCreateEmptyVarList() {
   }
   jsvSetNextSibling(lastEmpty, 0);
   jsVarFirstEmpty = jsvGetNextSibling(&firstVar);
+#if JSVAR_NURSERY_SIZE>0
+  jsVarNurseryFirstEmpty = 0; // all free vars are now in the main list
+  jsvNurseryPlace();
+#endif
   isMemoryBusy = MEM_NOT_BUSY;
 }
 
@@ -207,6 +387,11 @@ void jsvClearEmptyVarList() {
   assert(!isMemoryBusy);
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
+#if JSVAR_NURSERY_SIZE>0
+  jsVarNurseryStart = 0;
+  jsVarNurseryStartPtr = 0;
+  jsVarNurseryFirstEmpty = 0;
+#endif
   JsVarRef i;
   for (i=1;i<=jsVarsSize;i++) {
     JsVar *var = jsvGetAddressOf(i);
@@ -221,12 +406,322 @@ void jsvClearEmptyVarList() {
   isMemoryBusy = MEM_NOT_BUSY;
 }
 
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+/** Hash indexes of the child names of large objects, used to speed up
+ * jsvFindChildFromString/Var. These are stored outside of the JsVar array so
+ * they're never saved or copied, and they are just discarded whenever
+ * variables might have moved. Slots contain refs of the child names (using
+ * linear probing, 0 = empty) */
+typedef struct {
+  JsVarRef parent; ///< The object that is indexed, or 0 if this index is unused
+  unsigned int lastUsed; ///< jsvHashIndexUseCounter when this was last used, so we can reuse the least recently used index
+  unsigned int count; ///< How many slots are used
+  JsVarRef slots[JSVAR_HASH_INDEX_SLOTS];
+} JsvHashIndex;
+static JsvHashIndex jsvHashIndexes[JSVAR_HASH_INDEX_COUNT];
+static unsigned int jsvHashIndexUseCounter;
+static JsVarRef jsvHashIndexTooBig; ///< The last object we failed to index because it had too many children
+
+static unsigned int jsvHashIndexHashString(const char *str) {
+  unsigned int h = 5381;
+  while (*str) h = h*33 + (unsigned char)*(str++);
+  return h;
+}
+
+static unsigned int jsvHashIndexHashVar(JsVar *name) {
+  unsigned int h = 5381;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, name, 0);
+  while (jsvStringIteratorHasChar(&it))
+    h = h*33 + (unsigned char)jsvStringIteratorGetCharAndNext(&it);
+  jsvStringIteratorFree(&it);
+  return h;
+}
+
+/// Get the hash index for the given object, or 0
+static JsvHashIndex *jsvHashIndexFind(JsVarRef parent) {
+  for (int i=0;i<JSVAR_HASH_INDEX_COUNT;i++)
+    if (jsvHashIndexes[i].parent == parent)
+      return &jsvHashIndexes[i];
+  return 0;
+}
+
+/// Add a name to a hash index. Returns false if the index was too full
+static bool jsvHashIndexAdd(JsvHashIndex *idx, JsVar *name) {
+  if (idx->count >= JSVAR_HASH_INDEX_SLOTS*3/4) return false;
+  unsigned int slot = jsvHashIndexHashVar(name) & (JSVAR_HASH_INDEX_SLOTS-1);
+  while (idx->slots[slot])
+    slot = (slot+1) & (JSVAR_HASH_INDEX_SLOTS-1);
+  idx->slots[slot] = jsvGetRef(name);
+  idx->count++;
+  return true;
+}
+
+/// Remove a name from a hash index, moving back any names after it that would otherwise become unreachable
+static void jsvHashIndexRemove(JsvHashIndex *idx, JsVar *name) {
+  const unsigned int mask = JSVAR_HASH_INDEX_SLOTS-1;
+  JsVarRef ref = jsvGetRef(name);
+  unsigned int slot = jsvHashIndexHashVar(name) & mask;
+  while (idx->slots[slot] != ref) {
+    if (!idx->slots[slot]) return; // not in the index
+    slot = (slot+1) & mask;
+  }
+  unsigned int empty = slot;
+  slot = (slot+1) & mask;
+  while (idx->slots[slot]) {
+    unsigned int home = jsvHashIndexHashVar(jsvGetAddressOf(idx->slots[slot])) & mask;
+    // only move it if 'empty' is between this name's home slot and where it is now
+    if (((slot-home)&mask) >= ((slot-empty)&mask)) {
+      idx->slots[empty] = idx->slots[slot];
+      empty = slot;
+    }
+    slot = (slot+1) & mask;
+  }
+  idx->slots[empty] = 0;
+  idx->count--;
+}
+
+/// Discard the hash index for the given var (if there is one)
+static void jsvHashIndexDiscard(JsVarRef parent) {
+  JsvHashIndex *idx = jsvHashIndexFind(parent);
+  if (idx) {
+    idx->parent = 0;
+    idx->lastUsed = 0;
+  }
+  if (jsvHashIndexTooBig == parent)
+    jsvHashIndexTooBig = 0;
+}
+
+/// Discard all hash indexes (eg. because vars may have moved)
+static void jsvHashIndexDiscardAll() {
+  for (int i=0;i<JSVAR_HASH_INDEX_COUNT;i++) {
+    jsvHashIndexes[i].parent = 0;
+    jsvHashIndexes[i].lastUsed = 0;
+  }
+  jsvHashIndexTooBig = 0;
+}
+
+/// Create a hash index for the given object (reusing the least recently used one). Returns 0 if it has too many children
+static JsvHashIndex *jsvHashIndexCreate(JsVar *parent) {
+  JsVarRef parentRef = jsvGetRef(parent);
+  if (jsvHashIndexTooBig == parentRef) return 0;
+  JsvHashIndex *idx = &jsvHashIndexes[0];
+  for (int i=1;i<JSVAR_HASH_INDEX_COUNT;i++)
+    if (jsvHashIndexes[i].lastUsed < idx->lastUsed)
+      idx = &jsvHashIndexes[i];
+  memset(idx->slots, 0, sizeof(idx->slots));
+  idx->count = 0;
+  idx->parent = parentRef;
+  idx->lastUsed = ++jsvHashIndexUseCounter;
+  JsVarRef childref = jsvGetFirstChild(parent);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvHasCharacterData(child) && !jsvHashIndexAdd(idx, child)) {
+      idx->parent = 0;
+      idx->lastUsed = 0;
+      jsvHashIndexTooBig = parentRef;
+      return 0;
+    }
+    childref = jsvGetNextSibling(child);
+  }
+  return idx;
+}
+#endif
+
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+/** Indexes of the elements of large arrays, so that arr[i] doesn't have to
+ * walk the array's linked list. Like the hash indexes these are stored outside
+ * the JsVar array. slots[i] is the ref of the name for element i, for the
+ * first 'count' elements (which must all be there). Renumbering an element
+ * discards all indexes and removing one stops the index before it, so slots
+ * only refer to names that are still in the array. Entries are also checked
+ * when used, and the index is discarded if they don't look right. */
+typedef struct {
+  JsVarRef parent; ///< The array that is indexed, or 0 if this index is unused
+  unsigned int lastUsed; ///< jsvArrayIndexUseCounter when this was last used, so we can reuse the least recently used index
+  unsigned int count; ///< How many elements (from 0) are indexed
+  JsVarRef slots[JSVAR_ARRAY_INDEX_SLOTS];
+} JsvArrayIndex;
+static JsvArrayIndex jsvArrayIndexes[JSVAR_ARRAY_INDEX_COUNT];
+static unsigned int jsvArrayIndexUseCounter;
+static JsVarRef jsvArrayIndexFailedRef; ///< The last array we couldn't index because it didn't start with enough elements
+static JsVarInt jsvArrayIndexFailedLength; ///< The length of jsvArrayIndexFailedRef when we tried
+
+/// Get the index for the given array, or 0
+static JsvArrayIndex *jsvArrayIndexFind(JsVarRef arr) {
+  for (int i=0;i<JSVAR_ARRAY_INDEX_COUNT;i++)
+    if (jsvArrayIndexes[i].parent == arr)
+      return &jsvArrayIndexes[i];
+  return 0;
+}
+
+/// Discard the index for the given var (if there is one)
+static void jsvArrayIndexDiscard(JsVarRef arr) {
+  JsvArrayIndex *idx = jsvArrayIndexFind(arr);
+  if (idx) {
+    idx->parent = 0;
+    idx->lastUsed = 0;
+  }
+  if (jsvArrayIndexFailedRef == arr)
+    jsvArrayIndexFailedRef = 0;
+}
+
+/// Discard all array indexes (eg. because vars may have moved)
+static void jsvArrayIndexDiscardAll() {
+  for (int i=0;i<JSVAR_ARRAY_INDEX_COUNT;i++) {
+    jsvArrayIndexes[i].parent = 0;
+    jsvArrayIndexes[i].lastUsed = 0;
+  }
+  jsvArrayIndexFailedRef = 0;
+}
+
+/// Create an index for the given array (reusing the least recently used one). Returns 0 if the array doesn't start with enough elements
+static JsvArrayIndex *jsvArrayIndexCreate(JsVar *arr) {
+  JsVarRef arrRef = jsvGetRef(arr);
+  if (jsvArrayIndexFailedRef == arrRef && jsvArrayIndexFailedLength == jsvGetArrayLength(arr))
+    return 0;
+  JsvArrayIndex *idx = &jsvArrayIndexes[0];
+  for (int i=1;i<JSVAR_ARRAY_INDEX_COUNT;i++)
+    if (jsvArrayIndexes[i].lastUsed < idx->lastUsed)
+      idx = &jsvArrayIndexes[i];
+  unsigned int count = 0;
+  JsVarRef childref = jsvGetFirstChild(arr);
+  while (childref && count<JSVAR_ARRAY_INDEX_SLOTS) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (!jsvIsInt(child) || child->varData.integer != (JsVarInt)count) break;
+    idx->slots[count++] = childref;
+    childref = jsvGetNextSibling(child);
+  }
+  if (count < JSVAR_ARRAY_INDEX_THRESHOLD) {
+    // not worth it - don't try again unless the array changes size
+    idx->parent = 0;
+    idx->lastUsed = 0;
+    jsvArrayIndexFailedRef = arrRef;
+    jsvArrayIndexFailedLength = jsvGetArrayLength(arr);
+    return 0;
+  }
+  idx->parent = arrRef;
+  idx->count = count;
+  return idx;
+}
+
+/** Look up element 'index' of an array using its index (creating one if the
+ * array is big enough). Returns the locked name if found. If not found,
+ * *notFound is set if the index knows the element isn't in the array at all */
+static JsVar *jsvArrayIndexGet(JsVar *arr, JsVarInt index, bool *notFound) {
+  *notFound = false;
+  if (index<0) return 0;
+  JsvArrayIndex *idx = jsvArrayIndexFind(jsvGetRef(arr));
+  if (!idx) {
+    if (jsvGetArrayLength(arr) < JSVAR_ARRAY_INDEX_THRESHOLD) return 0;
+    idx = jsvArrayIndexCreate(arr);
+    if (!idx) return 0;
+  }
+  idx->lastUsed = ++jsvArrayIndexUseCounter;
+  if (index < (JsVarInt)idx->count) {
+    JsVar *child = jsvGetAddressOf(idx->slots[index]);
+    /* Check the name is still linked to the previous indexed element (or is
+    the array's first child) so it's still in this array - it could have been
+    freed and reused in another array with the same index */
+    JsVarRef prev = index ? idx->slots[index-1] : 0;
+    if (jsvIsInt(child) && child->varData.integer == index &&
+        jsvGetPrevSibling(child) == prev &&
+        (index || jsvGetFirstChild(arr) == idx->slots[0]))
+      return jsvLockAgain(child);
+    // elements were renumbered or moved
+    jsvArrayIndexDiscard(idx->parent);
+    return 0;
+  }
+  // if the indexed elements go right up to the end of the array, we know this isn't there
+  if (idx->count && jsvGetLastChild(arr) == idx->slots[idx->count-1]) {
+    JsVar *child = jsvGetAddressOf(idx->slots[idx->count-1]);
+    *notFound = jsvIsInt(child) && child->varData.integer == (JsVarInt)idx->count-1;
+  }
+  return 0;
+}
+#endif
+
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+/** The last StringExt of some long strings, so that appending doesn't have to
+ * walk the whole string to find the end. StringExts are only ever added to
+ * the end of a string, so if more have been added since the tail was stored
+ * we just walk on from it. Entries are discarded when the string is freed or
+ * its StringExts are replaced. */
+typedef struct {
+  JsVarRef str; ///< The string, or 0 if this entry is unused
+  JsVarRef tail; ///< A StringExt at (or before) the end of the string
+  size_t tailIndex; ///< The index in the string of tail's first character
+  unsigned int lastUsed; ///< jsvStringTailUseCounter when this was last used, so we can reuse the least recently used entry
+} JsvStringTail;
+static JsvStringTail jsvStringTails[JSVAR_STRING_TAIL_CACHE_SIZE];
+static unsigned int jsvStringTailUseCounter;
+
+JsVarRef jsvStringTailGet(JsVarRef str, size_t *tailIndex) {
+  for (int i=0;i<JSVAR_STRING_TAIL_CACHE_SIZE;i++) {
+    if (jsvStringTails[i].str == str) {
+      jsvStringTails[i].lastUsed = ++jsvStringTailUseCounter;
+      *tailIndex = jsvStringTails[i].tailIndex;
+      return jsvStringTails[i].tail;
+    }
+  }
+  return 0;
+}
+
+void jsvStringTailSet(JsVarRef str, JsVarRef tail, size_t tailIndex) {
+  JsvStringTail *entry = &jsvStringTails[0];
+  for (int i=0;i<JSVAR_STRING_TAIL_CACHE_SIZE;i++) {
+    if (jsvStringTails[i].str == str) {
+      entry = &jsvStringTails[i];
+      break;
+    }
+    if (jsvStringTails[i].lastUsed < entry->lastUsed)
+      entry = &jsvStringTails[i];
+  }
+  entry->str = str;
+  entry->tail = tail;
+  entry->tailIndex = tailIndex;
+  entry->lastUsed = ++jsvStringTailUseCounter;
+}
+
+/// Forget the tail of the given string (if we had it)
+static void jsvStringTailDiscard(JsVarRef str) {
+  for (int i=0;i<JSVAR_STRING_TAIL_CACHE_SIZE;i++)
+    if (jsvStringTails[i].str == str) {
+      jsvStringTails[i].str = 0;
+      jsvStringTails[i].lastUsed = 0;
+    }
+}
+
+/// Forget all string tails (eg. because vars may have moved)
+static void jsvStringTailDiscardAll() {
+  memset(jsvStringTails, 0, sizeof(jsvStringTails));
+}
+#endif
+
 void jsvSoftInit() {
   jsvCreateEmptyVarList();
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  jsvHashIndexDiscardAll();
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  jsvArrayIndexDiscardAll();
+#endif
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  jsvStringTailDiscardAll();
+#endif
 }
 
 void jsvSoftKill() {
   jsvClearEmptyVarList();
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  jsvHashIndexDiscardAll();
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  jsvArrayIndexDiscardAll();
+#endif
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  jsvStringTailDiscardAll();
+#endif
 }
 
 /** This links all JsVars together, so we can have our nice
@@ -258,6 +753,10 @@ void jsvInit(unsigned int size) {
 #endif
 
   jsVarFirstEmpty = jsvInitJsVars(1/*first*/, jsVarsSize);
+#if JSVAR_NURSERY_SIZE>0
+  jsVarNurseryFirstEmpty = 0;
+  jsvNurseryPlace();
+#endif
   jsvSoftInit();
 }
 
@@ -276,9 +775,14 @@ void jsvKill() {
  * if recovering from a saved state. */
 JsVar *jsvFindOrCreateRoot() {
   JsVarRef i;
-  for (i=1;i<=jsVarsSize;i++)
-    if (jsvIsRoot(jsvGetAddressOf(i)))
+  for (i=1;i<=jsVarsSize;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    if (jsvIsRoot(var))
       return jsvLock(i);
+    // skip flat strings, as their data could look like anything
+    if (jsvIsFlatString(var))
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+  }
 
   return jsvRef(jsvNewWithFlags(JSV_ROOT));
 }
@@ -300,6 +804,21 @@ unsigned int jsvGetMemoryUsage() {
   return usage;
 }
 
+/// Get the most memory records that have been used at once since jsvResetMemoryPeak was called
+unsigned int jsvGetMemoryPeak() {
+  return jsVarsPeakUsed;
+}
+
+/// Start measuring jsvGetMemoryPeak again from the current memory usage
+void jsvResetMemoryPeak() {
+  jsVarsPeakUsed = jsVarsUsed;
+}
+
+/// Get the number of full garbage collections that have been done
+unsigned int jsvGetGarbageCollectCount() {
+  return jsvGarbageCollectCount;
+}
+
 /// Get total amount of memory records
 unsigned int jsvGetMemoryTotal() {
   return jsVarsSize;
@@ -337,12 +856,18 @@ void jsvSetMemoryTotal(unsigned int jsNewVarCount) {
 
 /// Scan memory to find any JsVar that references a specific memory range, and if so update what it points to to p[oint to the new address
 void jsvUpdateMemoryAddress(size_t oldAddr, size_t length, size_t newAddr) {
+  // Native Strings point to wherever flash is memory-mapped, which may not be the same address
+  size_t oldMappedAddr = jshFlashGetMemMapAddress(oldAddr);
+  size_t newMappedAddr = jshFlashGetMemMapAddress(newAddr);
   for (unsigned int i=1;i<=jsVarsSize;i++) {
     JsVar *v = jsvGetAddressOf((JsVarRef)i);
     if (jsvIsNativeString(v) || jsvIsFlashString(v)) {
       size_t p = (size_t)v->varData.nativeStr.ptr;
       if (p>=oldAddr && p<oldAddr+length)
         v->varData.nativeStr.ptr = (char*)(p+newAddr-oldAddr);
+      else if (jsvIsNativeString(v) && oldMappedAddr && oldMappedAddr!=oldAddr &&
+               p>=oldMappedAddr && p<oldMappedAddr+length)
+        v->varData.nativeStr.ptr = (char*)(p+newMappedAddr-oldMappedAddr);
     } else if (jsvIsFlatString(v)) {
       i += (unsigned int)jsvGetFlatStringBlocks(v);
     }
@@ -356,11 +881,21 @@ bool jsvMoreFreeVariablesThan(unsigned int vars) {
     if (!vars--) return true;
     r = jsvGetNextSibling(jsvGetAddressOf(r));
   }
+#if JSVAR_NURSERY_SIZE>0
+  r = jsVarNurseryFirstEmpty;
+  while (r) {
+    if (!vars--) return true;
+    r = jsvGetNextSibling(jsvGetAddressOf(r));
+  }
+#endif
   return false;
 }
 
 /// Get whether memory is full or not
 bool jsvIsMemoryFull() {
+#if JSVAR_NURSERY_SIZE>0
+  if (jsVarNurseryFirstEmpty) return false;
+#endif
   return !jsVarFirstEmpty;
 }
 
@@ -371,6 +906,8 @@ void jsvShowAllocated() {
     if ((jsvGetAddressOf(i)->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
       jsiConsolePrintf("USED VAR #%d:",i);
       jsvTrace(jsvGetAddressOf(i), 2);
+      if (jsvIsFlatString(jsvGetAddressOf(i)))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(jsvGetAddressOf(i)));
     }
   }
 }
@@ -484,12 +1021,28 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
     return 0;
   }
   JsVar *v = 0;
+#if JSVAR_NURSERY_SIZE>0
+  /* If the nursery is full, try and clear it out. If that didn't free
+   * much then stop using it until after the next full GC */
+  if (jsVarNurseryStart && !jsVarNurseryFirstEmpty && !jshIsInInterrupt() &&
+      jsvGarbageCollectNursery() < JSVAR_NURSERY_SIZE/4)
+    jsvNurseryRelease();
+#endif
   jshInterruptOff(); // to allow this to be used from an IRQ
+#if JSVAR_NURSERY_SIZE>0
+  if (jsVarNurseryFirstEmpty!=0) {
+    v = jsvGetAddressOf(jsVarNurseryFirstEmpty); // jsvResetVariable will lock
+    jsVarNurseryFirstEmpty = jsvGetNextSibling(v); // move our reference to the next in the free list
+    touchedFreeList = true;
+  } else
+#endif
   if (jsVarFirstEmpty!=0) {
     v = jsvGetAddressOf(jsVarFirstEmpty); // jsvResetVariable will lock
     jsVarFirstEmpty = jsvGetNextSibling(v); // move our reference to the next in the free list
     touchedFreeList = true;
   }
+  if (v && ++jsVarsUsed > jsVarsPeakUsed)
+    jsVarsPeakUsed = jsVarsUsed;
   jshInterruptOn();
   if (v) {
     assert(v->flags == JSV_UNUSED);
@@ -540,8 +1093,17 @@ static void jsvFreePtrInternal(JsVar *var) {
   var->flags = JSV_UNUSED;
   // add this to our free list
   jshInterruptOff(); // to allow this to be used from an IRQ
-  jsvSetNextSibling(var, jsVarFirstEmpty);
-  jsVarFirstEmpty = jsvGetRef(var);
+  jsVarsUsed--;
+#if JSVAR_NURSERY_SIZE>0
+  if (jsvIsNurseryVar(var)) {
+    jsvSetNextSibling(var, jsVarNurseryFirstEmpty);
+    jsVarNurseryFirstEmpty = jsvGetRef(var);
+  } else
+#endif
+  {
+    jsvSetNextSibling(var, jsVarFirstEmpty);
+    jsVarFirstEmpty = jsvGetRef(var);
+  }
   touchedFreeList = true;
   jshInterruptOn();
 }
@@ -575,6 +1137,9 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
   if (jsvHasStringExt(var)) {
     // Free the string without recursing
     JsVarRef stringDataRef = jsvGetLastChild(var);
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+    if (stringDataRef) jsvStringTailDiscard(jsvGetRef(var));
+#endif
 #ifdef CLEAR_MEMORY_ON_FREE
     jsvSetLastChild(var, 0);
 #endif // CLEAR_MEMORY_ON_FREE
@@ -585,6 +1150,22 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
       jsvFreePtrInternal(child);
     }
     // We might be a flat string
+#if JSVAR_NURSERY_SIZE>0
+    if (jsvIsFlatString(var) && jsVarNurseryStart &&
+        jsvGetRef(var)+jsvGetFlatStringBlocks(var) >= jsVarNurseryStart &&
+        jsvGetRef(var) < jsVarNurseryStart+JSVAR_NURSERY_SIZE) {
+      // It's (partly) in the nursery, so free blocks one at a time so they go in the right free list
+      if (jsvGetRef(var) < jsVarNurseryStart)
+        jsVarNurseryFirstVar = jsVarNurseryStart; // it was sticking into the start of the nursery
+      size_t count = jsvGetFlatStringBlocks(var);
+      JsVarRef i = (JsVarRef)(jsvGetRef(var)+count);
+      while (count--) {
+        JsVar *p = jsvGetAddressOf(i--);
+        p->flags = JSV_UNUSED; // set locks to 0 so the assert in jsvFreePtrInternal doesn't get fed up
+        jsvFreePtrInternal(p);
+      }
+    } else
+#endif
     if (jsvIsFlatString(var)) {
       // in which case we need to free all the blocks.
       size_t count = jsvGetFlatStringBlocks(var);
@@ -613,6 +1194,7 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
         jsvSetNextSibling(jsvGetAddressOf(insertAfter), insertBefore);
       else
         jsVarFirstEmpty = insertBefore;
+      jsVarsUsed -= (unsigned int)jsvGetFlatStringBlocks(var);
       touchedFreeList = true;
       jshInterruptOn();
     } else if (jsvIsBasicString(var)) {
@@ -626,6 +1208,15 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
     can be ints or strings */
 
   if (jsvHasChildren(var)) {
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+    jsvHashIndexDiscard(jsvGetRef(var));
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+    jsvArrayIndexDiscard(jsvGetRef(var));
+#endif
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+    if (jsvIsObject(var)) jspLookupCacheForget(jsvGetRef(var));
+#endif
     JsVarRef childref = jsvGetFirstChild(var);
 #ifdef CLEAR_MEMORY_ON_FREE
     jsvSetFirstChild(var, 0);
@@ -842,6 +1433,12 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
               // Set up the header block (including one lock)
               jsvResetVariable(flatString, JSV_FLAT_STRING);
               flatString->varData.integer = (JsVarInt)byteLength;
+              jsVarsUsed += (unsigned int)requiredBlocks;
+              if (jsVarsUsed > jsVarsPeakUsed)
+                jsVarsPeakUsed = jsVarsUsed;
+#if JSVAR_NURSERY_SIZE>0
+              jsvNurseryForgetRange(flatString, requiredBlocks);
+#endif
             }
             jshInterruptOn();
             // if success, break out!
@@ -852,7 +1449,7 @@ JsVar *jsvNewFlatStringOfLength(unsigned int byteLength) {
           beforeStartBlock = curr;
           startBlock = next;
           // Check to see if the next block is aligned on a 4 byte boundary or not
-          if (((size_t)(jsvGetAddressOf(startBlock+1)))&3)
+          if (startBlock>=jsVarsSize || (((size_t)(jsvGetAddressOf(startBlock+1)))&3))
             blockCount = 0; // this block is not aligned
           else
             blockCount = 1; // all ok - start block here
@@ -1115,6 +1712,9 @@ JsVar *jsvMakeIntoVariableName(JsVar *var, JsVar *valueOrZero) {
       }
       jsvSetCharactersInVar(var, JSVAR_DATA_STRING_NAME_LEN);
       // Free any old stringexts
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+      jsvStringTailDiscard(jsvGetRef(var));
+#endif
       JsVarRef oldRef = jsvGetLastChild(var);
       while (oldRef) {
         JsVar *v = jsvGetAddressOf(oldRef);
@@ -1488,6 +2088,13 @@ size_t jsvGetStringLength(const JsVar *v) {
   const JsVar *var = v;
   JsVar *newVar = 0;
   if (!jsvHasCharacterData(v)) return 0;
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  // If we know where the end of the string is, start from there
+  if (jsvIsBasicString(v) && jsvGetLastChild(v)) {
+    JsVarRef tail = jsvStringTailGet(jsvGetRef((JsVar*)v), &strLength);
+    if (tail) var = newVar = jsvLock(tail);
+  }
+#endif
 
   while (var) {
     JsVarRef ref = jsvGetLastChild(var);
@@ -1877,6 +2484,9 @@ long long jsvGetLongIntegerAndUnLock(JsVar *v) {
 
 void jsvSetInteger(JsVar *v, JsVarInt value) {
   assert(jsvIsInt(v));
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  if (jsvIsName(v)) jsvArrayIndexDiscardAll(); // array elements are being renumbered
+#endif
   v->varData.integer  = value;
 }
 
@@ -2531,9 +3141,27 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
   return dst;
 }
 
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+/** A child is being added to/removed from parent. If that could change what's
+ * found when looking in a prototype chain, invalidate cached lookups. That's
+ * only the case for prototypes and constructors that cached lookups have
+ * searched, or for the built-in constructors in the root scope */
+static void jsvChildrenChanged(JsVar *parent, JsVar *name) {
+  if (jsvIsRoot(parent)) {
+    char buf[JSLEX_MAX_TOKEN_LENGTH];
+    jsvGetString(name, buf, sizeof(buf));
+    if (jswIsBuiltInObject(buf)) jspLookupCacheInvalidate();
+  } else if (jspLookupCacheUses(parent))
+    jspLookupCacheInvalidate();
+}
+#endif
+
 void jsvAddName(JsVar *parent, JsVar *namedChild) {
   namedChild = jsvRef(namedChild); // ref here VERY important as adding to structure!
   assert(jsvIsName(namedChild));
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  jsvChildrenChanged(parent, namedChild);
+#endif
 
   // update array length
   if (jsvIsArray(parent) && jsvIsInt(namedChild)) {
@@ -2583,6 +3211,24 @@ void jsvAddName(JsVar *parent, JsVar *namedChild) {
     jsvSetFirstChild(parent, r);
     jsvSetLastChild(parent, r);
   }
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  if (jsvIsObject(parent) && jsvHasCharacterData(namedChild)) {
+    JsVarRef parentRef = jsvGetRef(parent);
+    JsvHashIndex *idx = jsvHashIndexFind(parentRef);
+    if (idx && !jsvHashIndexAdd(idx, namedChild))
+      jsvHashIndexDiscard(parentRef); // too full - go back to scanning
+  }
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  if (jsvIsArray(parent) && jsvIsInt(namedChild)) {
+    JsvArrayIndex *idx = jsvArrayIndexFind(jsvGetRef(parent));
+    // if this was added right after the last indexed element, index it too
+    if (idx && idx->count<JSVAR_ARRAY_INDEX_SLOTS &&
+        namedChild->varData.integer == (JsVarInt)idx->count &&
+        (!idx->count || jsvGetPrevSibling(namedChild)==idx->slots[idx->count-1]))
+      idx->slots[idx->count++] = jsvGetRef(namedChild);
+  }
+#endif
 }
 
 JsVar *jsvAddNamedChild(JsVar *parent, JsVar *child, const char *name) {
@@ -2612,8 +3258,15 @@ JsVar *jsvSetValueOfName(JsVar *name, JsVar *src) {
     else
       name->flags = (name->flags & (JsVarFlags)~JSV_VARTYPEMASK) | JSV_NAME_INT;
     jsvSetFirstChild(name, 0);
-  } else if (jsvGetFirstChild(name))
+  } else if (jsvGetFirstChild(name)) {
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+    // replacing an object could change a prototype chain (eg. X.prototype = ...)
+    JsVar *oldValue = jsvGetAddressOf(jsvGetFirstChild(name));
+    if (jsvHasChildren(oldValue) && !jsvIsArray(oldValue))
+      jspLookupCacheInvalidate();
+#endif
     jsvUnRefRef(jsvGetFirstChild(name)); // free existing
+  }
   if (src) {
     if (jsvIsInt(name)) {
       if ((jsvIsInt(src) || jsvIsBoolean(src)) && !jsvIsPin(src)) {
@@ -2667,17 +3320,44 @@ JsVar *jsvFindChildFromString(JsVar *parent, const char *name, bool addIfNotFoun
 
   assert(jsvHasChildren(parent));
   JsVarRef childref = jsvGetFirstChild(parent);
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  unsigned int scanned = 0;
+  JsvHashIndex *idx = jsvIsObject(parent) ? jsvHashIndexFind(jsvGetRef(parent)) : 0;
+  if (idx) {
+    idx->lastUsed = ++jsvHashIndexUseCounter;
+    unsigned int slot = jsvHashIndexHashString(name) & (JSVAR_HASH_INDEX_SLOTS-1);
+    while (idx->slots[slot]) {
+      JsVar *child = jsvGetAddressOf(idx->slots[slot]);
+      if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
+          jsvIsStringEqual(child, name))
+        return jsvLockAgain(child);
+      slot = (slot+1) & (JSVAR_HASH_INDEX_SLOTS-1);
+    }
+    childref = 0; // not in the index, so no need to scan
+  }
+#endif
   while (childref) {
     // Don't Lock here, just use GetAddressOf - to try and speed up the finding
     // TODO: We can do this now, but when/if we move to cacheing vars, it'll break
     JsVar *child = jsvGetAddressOf(childref);
     if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
         jsvIsStringEqual(child, name)) {
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+      if (scanned >= JSVAR_HASH_INDEX_THRESHOLD && jsvIsObject(parent))
+        jsvHashIndexCreate(parent); // so next time we can use the index
+#endif
       // found it! unlock parent but leave child locked
       return jsvLockAgain(child);
     }
     childref = jsvGetNextSibling(child);
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+    scanned++;
+#endif
   }
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  if (!idx && scanned >= JSVAR_HASH_INDEX_THRESHOLD && jsvIsObject(parent))
+    jsvHashIndexCreate(parent); // so any child we add below also gets indexed
+#endif
 
   JsVar *child = 0;
   if (addIfNotFound) {
@@ -2739,16 +3419,51 @@ JsVar *jsvAsName(JsVar *var) {
 JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound) {
   JsVar *child;
   JsVarRef childref = jsvGetFirstChild(parent);
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  unsigned int scanned = 0;
+  bool canIndex = jsvIsObject(parent) && childName && jsvHasCharacterData(childName);
+  JsvHashIndex *idx = canIndex ? jsvHashIndexFind(jsvGetRef(parent)) : 0;
+  if (idx) {
+    idx->lastUsed = ++jsvHashIndexUseCounter;
+    unsigned int slot = jsvHashIndexHashVar(childName) & (JSVAR_HASH_INDEX_SLOTS-1);
+    while (idx->slots[slot]) {
+      child = jsvGetAddressOf(idx->slots[slot]);
+      if (jsvIsBasicVarEqual(child, childName))
+        return jsvLockAgain(child);
+      slot = (slot+1) & (JSVAR_HASH_INDEX_SLOTS-1);
+    }
+    childref = 0; // not in the index, so no need to scan
+  }
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  if (jsvIsArray(parent) && jsvIsInt(childName)) {
+    bool notFound;
+    child = jsvArrayIndexGet(parent, childName->varData.integer, &notFound);
+    if (child) return child;
+    if (notFound) childref = 0; // no need to scan
+  }
+#endif
 
   while (childref) {
     child = jsvLock(childref);
     if (jsvIsBasicVarEqual(child, childName)) {
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+      if (canIndex && scanned >= JSVAR_HASH_INDEX_THRESHOLD)
+        jsvHashIndexCreate(parent); // so next time we can use the index
+#endif
       // found it! unlock parent but leave child locked
       return child;
     }
     childref = jsvGetNextSibling(child);
     jsvUnLock(child);
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+    scanned++;
+#endif
   }
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  if (canIndex && !idx && scanned >= JSVAR_HASH_INDEX_THRESHOLD)
+    jsvHashIndexCreate(parent); // so any child we add below also gets indexed
+#endif
 
   child = 0;
   if (addIfNotFound && childName) {
@@ -2761,6 +3476,23 @@ JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound)
 void jsvRemoveChild(JsVar *parent, JsVar *child) {
   assert(jsvHasChildren(parent));
   assert(jsvIsName(child));
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  jsvChildrenChanged(parent, child);
+#endif
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  if (jsvIsObject(parent) && jsvHasCharacterData(child)) {
+    JsvHashIndex *idx = jsvHashIndexFind(jsvGetRef(parent));
+    if (idx) jsvHashIndexRemove(idx, child);
+  }
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  if (jsvIsArray(parent) && jsvIsInt(child)) {
+    JsvArrayIndex *idx = jsvArrayIndexFind(jsvGetRef(parent));
+    // elements after this one are no longer indexed
+    if (idx && child->varData.integer>=0 && child->varData.integer < (JsVarInt)idx->count)
+      idx->count = (unsigned int)child->varData.integer;
+  }
+#endif
   JsVarRef childref = jsvGetRef(child);
   bool wasChild = false;
   // unlink from parent
@@ -3021,6 +3753,13 @@ size_t jsvCountJsVarsUsed(JsVar *v) {
 }
 
 JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  if (jsvIsArray(arr)) {
+    bool notFound;
+    JsVar *found = jsvArrayIndexGet((JsVar*)arr, index, &notFound);
+    if (found || notFound) return found;
+  }
+#endif
   JsVarRef childref = jsvGetLastChild(arr);
   JsVarInt lastArrayIndex = 0;
   // Look at last non-string element!
@@ -3248,6 +3987,9 @@ JsVar *jsvArrayPop(JsVar *arr) {
 /// Removes the first element of an array, and returns that element (or 0 if empty). DOES NOT RENUMBER.
 JsVar *jsvArrayPopFirst(JsVar *arr) {
   assert(jsvIsArray(arr));
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  jsvArrayIndexDiscard(jsvGetRef(arr)); // all elements will be renumbered
+#endif
   if (jsvGetFirstChild(arr)) {
     JsVar *child = jsvLock(jsvGetFirstChild(arr));
     if (jsvGetFirstChild(arr) == jsvGetLastChild(arr))
@@ -3317,6 +4059,9 @@ JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler, bool ignoreNull) {
 /// Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element) {
   if (beforeIndex) {
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+    jsvArrayIndexDiscard(jsvGetRef(arr)); // elements after this will be renumbered
+#endif
     JsVar *idxVar = jsvMakeIntoVariableName(jsvNewFromInteger(0), element);
     if (!idxVar) return; // out of memory
 
@@ -3723,47 +4468,175 @@ void jsvTrace(JsVar *var, int indent) {
 }
 
 
-/** Recursively mark the variable. Return false if it fails due to stack. */
-static bool jsvGarbageCollectMarkUsed(JsVar *var) {
+/* The mark phase uses an explicit stack rather than recursion, so that deep
+ * structures (eg. long linked lists) can't exhaust the C stack. If the stack
+ * fills up we just note it: the var is marked but its children aren't, and
+ * jsvGarbageCollectMarkOverflowed rescans memory for those afterwards. */
+typedef struct {
+  JsVarRef stack[JSVAR_GC_MARK_STACK_SIZE];
+  unsigned int count;
+  bool overflowed;
+  unsigned int work; ///< vars handled since we last checked for events (jsvGarbageCollectIdle)
+  bool interruptible; ///< if set, give up marking when events arrive
+} JsvGCMarkState;
+
+/// Mark any String Extensions of this variable
+static void jsvGarbageCollectMarkStringExt(JsVar *var) {
+  // String extensions have no children, so just mark them in-line
+  JsVarRef child = jsvGetLastChild(var);
+  while (child) {
+    JsVar *childVar = jsvGetAddressOf(child);
+    childVar->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+    child = jsvGetLastChild(childVar);
+  }
+}
+
+/// Mark the variable as used, and queue it so its children get marked too
+static void jsvGarbageCollectMarkVar(JsvGCMarkState *ms, JsVar *var) {
   var->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
-  JsVarRef child;
-  JsVar *childVar;
-
-  if (jsvHasCharacterData(var)) {
-    // non-recursively scan strings
-    child = jsvGetLastChild(var);
-    while (child) {
-      childVar = jsvGetAddressOf(child);
-      childVar->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
-      child = jsvGetLastChild(childVar);
-    }
+  if (!jsvIsName(var) && !jsvHasChildren(var) && !jsvIsArrayBuffer(var)) {
+    // Nothing else linked from here, so there's no need to queue it
+    if (jsvHasCharacterData(var))
+      jsvGarbageCollectMarkStringExt(var);
+    return;
   }
-  // intentionally no else
-  if (jsvHasSingleChild(var)) {
-    if (jsvGetFirstChild(var)) {
-      childVar = jsvGetAddressOf(jsvGetFirstChild(var));
-      if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
-    }
-  } else if (jsvHasChildren(var)) {
-    if (jsuGetFreeStack() < 256) return false;
-
-    child = jsvGetFirstChild(var);
-    while (child) {
-      childVar = jsvGetAddressOf(child);
-      if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
-      child = jsvGetNextSibling(childVar);
+  if (ms->count < JSVAR_GC_MARK_STACK_SIZE)
+    ms->stack[ms->count++] = jsvGetRef(var);
+  else
+    ms->overflowed = true;
+}
+
+/// Mark (and queue) the variable with the given ref if it isn't already marked
+static void jsvGarbageCollectMarkRef(JsvGCMarkState *ms, JsVarRef ref) {
+  if (!ref) return;
+  JsVar *var = jsvGetAddressOf(ref);
+  if (var->flags & JSV_GARBAGE_COLLECT)
+    jsvGarbageCollectMarkVar(ms, var);
+}
+
+/// Mark everything directly linked from this variable
+static void jsvGarbageCollectMarkChildren(JsvGCMarkState *ms, JsVar *var) {
+  if (jsvHasCharacterData(var))
+    jsvGarbageCollectMarkStringExt(var);
+  /* Names in a list mark the next one along, so that for things with
+   * children we only have to mark the first. The next name is queued before
+   * the name's value so the value gets handled first, which stops the stack
+   * growing with the length of the list. */
+  if (jsvIsName(var) && !jsvIsArrayBufferName(var)) {
+    JsVarRef next = jsvGetNextSibling(var);
+    if (next != jsvGetPrevSibling(var)) // not jsvIsNewChild
+      jsvGarbageCollectMarkRef(ms, next);
+  }
+  if (jsvHasSingleChild(var) || jsvHasChildren(var))
+    jsvGarbageCollectMarkRef(ms, jsvGetFirstChild(var));
+}
+
+/// Mark everything that is queued. Returns false if interrupted (see jsvGarbageCollectIdle)
+static bool jsvGarbageCollectMarkQueued(JsvGCMarkState *ms) {
+  while (ms->count) {
+    JsVar *var = jsvGetAddressOf(ms->stack[--ms->count]);
+    jsvGarbageCollectMarkChildren(ms, var);
+#if JSVAR_GC_IDLE_SLICE>0
+    if (ms->interruptible && ++ms->work >= JSVAR_GC_IDLE_SLICE) {
+      ms->work = 0;
+      if (jshHasEvents()) return false;
     }
+#endif
   }
+  return true;
+}
 
+/** If the mark stack overflowed, some marked vars never had their children
+ * marked. Scan memory between from and to for marked vars and mark their
+ * children until nothing more overflows. Returns false if interrupted (see
+ * jsvGarbageCollectIdle) */
+static bool jsvGarbageCollectMarkOverflowed(JsvGCMarkState *ms, JsVarRef from, JsVarRef to) {
+  while (ms->overflowed) {
+    ms->overflowed = false;
+    JsVarRef i;
+    for (i=from;i<=to;i++)  {
+      JsVar *var = jsvGetAddressOf(i);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED &&
+          !(var->flags & JSV_GARBAGE_COLLECT)) {
+        jsvGarbageCollectMarkChildren(ms, var);
+        if (!jsvGarbageCollectMarkQueued(ms)) return false;
+      }
+      // if we have a flat string, skip that many blocks
+      if (jsvIsFlatString(var))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+  }
   return true;
 }
 
-/** Run a garbage collection sweep - return nonzero if things have been freed */
-int jsvGarbageCollect() {
+/// Mark the variable and everything reachable from it
+static bool jsvGarbageCollectMarkUsed(JsvGCMarkState *ms, JsVar *var) {
+  jsvGarbageCollectMarkVar(ms, var);
+  return jsvGarbageCollectMarkQueued(ms) &&
+         jsvGarbageCollectMarkOverflowed(ms, 1, jsVarsSize);
+}
+
+/// Called after garbage collection has freed vars, to tidy up anything that may have referenced them
+static void jsvGarbageCollectFreed(unsigned int freedCount) {
+  NOT_USED(freedCount);
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  if (freedCount) jspLookupCacheInvalidate(); // we may have freed something cached lookups used
+#endif
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  // discard the hash indexes of any objects we freed
+  for (int i=0;i<JSVAR_HASH_INDEX_COUNT;i++) {
+    JsVarRef parent = jsvHashIndexes[i].parent;
+    if (parent && !jsvIsObject(jsvGetAddressOf(parent)))
+      jsvHashIndexDiscard(parent);
+  }
+  if (jsvHashIndexTooBig && !jsvIsObject(jsvGetAddressOf(jsvHashIndexTooBig)))
+    jsvHashIndexTooBig = 0;
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  // discard the indexes of any arrays we freed
+  for (int i=0;i<JSVAR_ARRAY_INDEX_COUNT;i++) {
+    JsVarRef parent = jsvArrayIndexes[i].parent;
+    if (parent && !jsvIsArray(jsvGetAddressOf(parent)))
+      jsvArrayIndexDiscard(parent);
+  }
+  if (jsvArrayIndexFailedRef && !jsvIsArray(jsvGetAddressOf(jsvArrayIndexFailedRef)))
+    jsvArrayIndexFailedRef = 0;
+#endif
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  // forget the tails of any strings we freed
+  for (int i=0;i<JSVAR_STRING_TAIL_CACHE_SIZE;i++) {
+    JsVarRef str = jsvStringTails[i].str;
+    if (str && !jsvIsBasicString(jsvGetAddressOf(str)))
+      jsvStringTailDiscard(str);
+  }
+#endif
+}
+
+/** Add a var to the end of the free list it belongs in while sweeping. Memory
+ * is swept in order, so the free lists end up in order too */
+static ALWAYS_INLINE void jsvGarbageCollectAddFree(JsVar **lastEmpty, JsVarRef ref, JsVar *var) {
+  jsVarsUsed--;
+#if JSVAR_NURSERY_SIZE>0
+  if (jsvIsNurseryVar(var)) {
+    if (lastEmpty[1]) jsvSetNextSibling(lastEmpty[1], ref);
+    else jsVarNurseryFirstEmpty = ref;
+    lastEmpty[1] = var;
+    return;
+  }
+#endif
+  if (lastEmpty[0]) jsvSetNextSibling(lastEmpty[0], ref);
+  else jsVarFirstEmpty = ref;
+  lastEmpty[0] = var;
+}
+
+static int jsvGarbageCollectInternal(bool interruptible) {
   if (isMemoryBusy) return 0;
   isMemoryBusy = MEMBUSY_GC;
+  JsvGCMarkState ms;
+  ms.count = 0;
+  ms.overflowed = false;
+  ms.work = 0;
+  ms.interruptible = interruptible;
   JsVarRef i;
   // Add GC flags to anything that is currently used
   for (i=1;i<=jsVarsSize;i++)  {
@@ -3780,9 +4653,15 @@ int jsvGarbageCollect() {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags & JSV_GARBAGE_COLLECT) && // not already GC'd
         jsvGetLocks(var)>0) { // or it is locked
-      if (!jsvGarbageCollectMarkUsed(var)) {
-        // this could fail due to stack exhausted (eg big linked list)
-        // JSV_GARBAGE_COLLECT are left set, but not a big problem as next GC will clear them
+      if (!jsvGarbageCollectMarkUsed(&ms, var)) {
+        // interrupted because events arrived (see jsvGarbageCollectIdle)
+        // clear JSV_GARBAGE_COLLECT, as the nursery GC relies on it not being left set
+        for (i=1;i<=jsVarsSize;i++) {
+          JsVar *v = jsvGetAddressOf(i);
+          v->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+          if (jsvIsFlatString(v)) // skip the flat string's data
+            i = (JsVarRef)(i+jsvGetFlatStringBlocks(v));
+        }
         isMemoryBusy = MEM_NOT_BUSY;
         return 0;
       }
@@ -3797,7 +4676,11 @@ int jsvGarbageCollect() {
    * hopefully helps compact everything towards the start. */
   unsigned int freedCount = 0;
   jsVarFirstEmpty = 0;
-  JsVar *lastEmpty = 0;
+  jsVarsUsed = jsVarsSize; // we count free vars as we add them to the free list
+  JsVar *lastEmpty[2] = {0,0}; // last var in the main free list, and in the nursery's
+#if JSVAR_NURSERY_SIZE>0
+  jsVarNurseryFirstEmpty = 0;
+#endif
   for (i=1;i<=jsVarsSize;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if (var->flags & JSV_GARBAGE_COLLECT) {
@@ -3808,18 +4691,14 @@ int jsvGarbageCollect() {
         // Free the first block
         var->flags = JSV_UNUSED;
         // add this to our free list
-        if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-        else jsVarFirstEmpty = i;
-        lastEmpty = var;
+        jsvGarbageCollectAddFree(lastEmpty, i, var);
         // free subsequent blocks
         while (count-- > 0) {
           i++;
           var = jsvGetAddressOf((JsVarRef)(i));
           var->flags = JSV_UNUSED;
           // add this to our free list
-          if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-          else jsVarFirstEmpty = i;
-          lastEmpty = var;
+          jsvGarbageCollectAddFree(lastEmpty, i, var);
         }
       } else {
         // otherwise just free 1 block
@@ -3859,9 +4738,7 @@ int jsvGarbageCollect() {
         // free!
         var->flags = JSV_UNUSED;
         // add this to our free list
-        if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-        else jsVarFirstEmpty = i;
-        lastEmpty = var;
+        jsvGarbageCollectAddFree(lastEmpty, i, var);
         freedCount++;
       }
     } else if (jsvIsFlatString(var)) {
@@ -3869,17 +4746,154 @@ int jsvGarbageCollect() {
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
     } else if (var->flags == JSV_UNUSED) {
       // this is already free - add it to the free list
-      if (lastEmpty) jsvSetNextSibling(lastEmpty, i);
-      else jsVarFirstEmpty = i;
-      lastEmpty = var;
+      jsvGarbageCollectAddFree(lastEmpty, i, var);
     }
   }
-  if (lastEmpty) jsvSetNextSibling(lastEmpty, 0);
+  if (lastEmpty[0]) jsvSetNextSibling(lastEmpty[0], 0);
+  if (lastEmpty[1]) jsvSetNextSibling(lastEmpty[1], 0);
+#if JSVAR_NURSERY_SIZE>0
+  // If the nursery has filled up with things that are still in use, move it somewhere emptier
+  if (jsvNurseryIsClogged())
+    jsvNurseryPlace();
+#endif
+  jsvGarbageCollectFreed(freedCount);
+  jsvGarbageCollectCount++;
   isMemoryBusy = MEM_NOT_BUSY;
   return (int)freedCount;
 }
 
+/** Run a garbage collection sweep - return nonzero if things have been freed */
+int jsvGarbageCollect() {
+  return jsvGarbageCollectInternal(false);
+}
+
+#if JSVAR_NURSERY_SIZE>0
+/** Garbage collect just the nursery. Anything outside the nursery is assumed
+ * to be in use, so we only have to look at what links into the nursery from
+ * the vars we remembered in jsvNurseryRemember (or all vars if we couldn't
+ * remember them all). Returns the number of vars freed */
+static unsigned int jsvGarbageCollectNursery() {
+  if (isMemoryBusy || !jsVarNurseryStart) return 0;
+  isMemoryBusy = MEMBUSY_GC;
+  JsvGCMarkState ms;
+  ms.count = 0;
+  ms.overflowed = false;
+  ms.work = 0;
+  ms.interruptible = false;
+  JsVarRef start = jsVarNurseryFirstVar;
+  JsVarRef end = (JsVarRef)(jsVarNurseryStart+JSVAR_NURSERY_SIZE-1);
+  JsVarRef i;
+  // Add GC flags to anything in the nursery that is currently used
+  for (i=start;i<=end;i++)  {
+    JsVar *var = jsvGetAddressOf(i);
+    if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+      var->flags |= (JsVarFlags)JSV_GARBAGE_COLLECT;
+      // if we have a flat string, skip that many blocks
+      if (jsvIsFlatString(var))
+        i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+  }
+  /* Mark anything linked to from outside the nursery, and remember the vars
+   * that did that in the other table for next time. This can't run out of
+   * stack or be interrupted */
+  JsVar **oldTable = jsvNurseryRemembered[jsvNurseryRememberedTable];
+  bool all = jsvNurseryRememberedAll;
+  jsvNurseryRememberedTable ^= 1;
+  memset(jsvNurseryRemembered[jsvNurseryRememberedTable], 0, sizeof(jsvNurseryRemembered[0]));
+  jsvNurseryRememberedCount = 0;
+  jsvNurseryRememberedAll = false;
+  if (all) {
+    for (i=1;i<=jsVarsSize;i++)  {
+      JsVar *var = jsvGetAddressOf(i);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+        if (!jsvIsNurseryVar(var) && jsvNurseryIsLinkedFrom(var)) {
+          jsvNurseryRemember(var);
+          jsvGarbageCollectMarkChildren(&ms, var);
+          jsvGarbageCollectMarkQueued(&ms);
+        }
+        // if we have a flat string, skip that many blocks
+        if (jsvIsFlatString(var))
+          i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+      }
+    }
+  } else {
+    for (unsigned int h=0;h<JSVAR_NURSERY_REMEMBER_SIZE;h++) {
+      JsVar *var = oldTable[h];
+      if (var>(JsVar*)1 && // not empty or forgotten (see jsvNurseryForgetRange)
+          (var->flags&JSV_VARTYPEMASK) != JSV_UNUSED &&
+          jsvNurseryIsLinkedFrom(var)) {
+        jsvNurseryRemember(var);
+        jsvGarbageCollectMarkChildren(&ms, var);
+        jsvGarbageCollectMarkQueued(&ms);
+      }
+    }
+  }
+  // Mark anything in the nursery that's locked
+  for (i=start;i<=end;i++)  {
+    JsVar *var = jsvGetAddressOf(i);
+    if ((var->flags & JSV_GARBAGE_COLLECT) && jsvGetLocks(var)>0)
+      jsvGarbageCollectMarkUsed(&ms, var);
+    // if we have a flat string, skip that many blocks
+    if (jsvIsFlatString(var))
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+  }
+  // Only vars in the nursery get queued, so that's all we need to look at if we ran out of stack
+  jsvGarbageCollectMarkOverflowed(&ms, start, end);
+  /* Now free anything in the nursery that wasn't marked. Things outside the
+   * nursery that only these linked to will get freed by the next full GC */
+  unsigned int freedCount = 0;
+  for (i=start;i<=end;i++)  {
+    JsVar *var = jsvGetAddressOf(i);
+    if (var->flags & JSV_GARBAGE_COLLECT) {
+      if (jsvIsFlatString(var)) {
+        unsigned int count = (unsigned int)jsvGetFlatStringBlocks(var);
+        freedCount += count;
+        while (count-- > 0) {
+          JsVar *p = jsvGetAddressOf((JsVarRef)(++i));
+          p->flags = JSV_UNUSED; // set locks to 0 so the assert in jsvFreePtrInternal doesn't get fed up
+          jsvFreePtrInternal(p);
+        }
+      } else if (jsvHasSingleChild(var)) {
+        // unref the child if it's not being freed too (only nursery vars are being freed)
+        JsVarRef ch = jsvGetFirstChild(var);
+        if (ch) {
+          JsVar *child = jsvGetAddressOf(ch); // not locked
+          if (child->flags!=JSV_UNUSED &&
+              !(jsvIsNurseryVar(child) && (child->flags&JSV_GARBAGE_COLLECT)))
+            jsvUnRef(child);
+        }
+      }
+      jsvFreePtrInternal(var); // doesn't matter that we free the first block of a flat string last
+      freedCount++;
+    } else if (jsvIsFlatString(var)) {
+      // if we have a flat string, skip forward that many blocks
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    }
+  }
+  jsvGarbageCollectFreed(freedCount);
+  isMemoryBusy = MEM_NOT_BUSY;
+  return freedCount;
+}
+#endif
+
+#if JSVAR_GC_IDLE_SLICE>0
+/** Garbage collect when idle. This checks for pending events every
+ * JSVAR_GC_IDLE_SLICE vars while marking, and gives up (returning 0) if there
+ * are any so that they can be handled straight away. */
+int jsvGarbageCollectIdle() {
+  return jsvGarbageCollectInternal(true);
+}
+#endif
+
 void jsvDefragment() {
+  // variables will move, so the timer heap and watch index need rebuilding
+  jsiTimersChanged();
+  jsiWatchesChanged();
+  /* timerArray and watchArray are referenced from C rather than from other
+  vars, so we couldn't update those references if they moved - lock them so
+  they stay where they are. */
+  JsVar *timers = timerArray ? jsvLock(timerArray) : 0;
+  JsVar *watches = watchArray ? jsvLock(watchArray) : 0;
   // garbage collect - removes cruft
   // also puts free list in order
   jsvGarbageCollect();
@@ -3954,7 +4968,20 @@ void jsvDefragment() {
   }
   // rebuild free var list
   jsvCreateEmptyVarList();
+#if JSVAR_HASH_INDEX_THRESHOLD>0
+  jsvHashIndexDiscardAll(); // vars have moved
+#endif
+#if JSVAR_ARRAY_INDEX_THRESHOLD>0
+  jsvArrayIndexDiscardAll(); // vars have moved
+#endif
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  jsvStringTailDiscardAll(); // vars have moved
+#endif
+#if JSPARSE_LOOKUP_CACHE_SIZE>0
+  jspLookupCacheInvalidate(); // vars have moved
+#endif
   jshInterruptOn();
+  jsvUnLock2(timers, watches);
 }
 
 // Dump any locked variables that aren't referenced from `global` - for debugging memory leaks
@@ -3973,14 +5000,19 @@ void jsvDumpLockedVars() {
         i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
     }
   }
+  JsvGCMarkState ms;
+  ms.count = 0;
+  ms.overflowed = false;
+  ms.work = 0;
+  ms.interruptible = false;
   // Add global
-  jsvGarbageCollectMarkUsed(execInfo.root);
+  jsvGarbageCollectMarkUsed(&ms, execInfo.root);
   // Now dump any that aren't used!
   for (i=1;i<=jsVarsSize;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
       if (var->flags & JSV_GARBAGE_COLLECT) {
-        jsvGarbageCollectMarkUsed(var);
+        jsvGarbageCollectMarkUsed(&ms, var);
         jsvTrace(var, 0);
       }
     }
@@ -275,6 +275,9 @@ void jsvSoftKill(); ///< called when saving to flash
 JsVar *jsvFindOrCreateRoot(); ///< Find or create the ROOT variable item - used mainly if recovering from a saved state.
 unsigned int jsvGetMemoryUsage(); ///< Get number of memory records (JsVars) used
 unsigned int jsvGetMemoryTotal(); ///< Get total amount of memory records
+unsigned int jsvGetMemoryPeak(); ///< Get the most memory records that have been used at once since jsvResetMemoryPeak was called
+void jsvResetMemoryPeak(); ///< Start measuring jsvGetMemoryPeak again from the current memory usage
+unsigned int jsvGetGarbageCollectCount(); ///< Get the number of full garbage collections that have been done
 bool jsvIsMemoryFull(); ///< Get whether memory is full or not
 bool jsvMoreFreeVariablesThan(unsigned int vars); ///< Return whether there are more free variables than the parameter (faster than checking no of vars used)
 void jsvShowAllocated(); ///< Show what is still allocated, for debugging memory problems
@@ -460,6 +463,10 @@ JsVar *jsvAsStringAndUnLock(JsVar *var); ///< Same as jsvAsString, but unlocks '
 JsVar *jsvAsFlatString(JsVar *var); ///< Create a flat string from the given variable (or return it if it is already a flat string). NOTE: THIS CONVERTS VIA A STRING
 bool jsvIsEmptyString(JsVar *v); ///< Returns true if the string is empty - faster than jsvGetStringLength(v)==0
 size_t jsvGetStringLength(const JsVar *v); ///< Get the length of this string, IF it is a string
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+JsVarRef jsvStringTailGet(JsVarRef str, size_t *tailIndex); ///< Get the last block of a long string that we remembered (or 0), and the index of its first character
+void jsvStringTailSet(JsVarRef str, JsVarRef tail, size_t tailIndex); ///< Remember the last block of a long string
+#endif
 size_t jsvGetFlatStringBlocks(const JsVar *v); ///< return the number of blocks used by the given flat string - EXCLUDING the first data block
 char *jsvGetFlatStringPointer(JsVar *v); ///< Get a pointer to the data in this flat string
 JsVar *jsvGetFlatStringFromPointer(char *v); ///< Given a pointer to the first element of a flat string, return the flat string itself (DANGEROUS!)
@@ -684,6 +691,11 @@ void jsvTrace(JsVar *var, int indent);
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect();
 
+#if JSVAR_GC_IDLE_SLICE>0
+/** Garbage collect, but give up (returning 0) if any events arrive while marking */
+int jsvGarbageCollectIdle();
+#endif
+
 /** Defragement memory - this could take a while with interrupts turned off! */
 void jsvDefragment();
 
@@ -245,6 +245,48 @@ unsigned int jsvIterateCallbackToBytes(JsVar *var, unsigned char *data, unsigned
 
 // --------------------------------------------------------------------------------------------
 
+#if defined(SPIFLASH_BASE) && ESPR_FLASH_STRING_CACHE>0
+/* Flash String iterators only have room for 16 bytes, so without this every
+16 bytes (and every new iterator, which the lexer makes a lot of) means a
+separate read from flash. Instead we keep the last few lines of flash that
+were read, each in the slot given by its address. Rather than clearing every
+line when flash changes we just bump jsvFlashStringCacheGeneration - lines
+read before that are then ignored. */
+#define JSV_FLASH_STRING_CACHE_LINE 64
+typedef struct {
+  uint32_t addr; ///< Address of the start of this line
+  uint32_t generation; ///< The value of jsvFlashStringCacheGeneration when it was read
+  unsigned char data[JSV_FLASH_STRING_CACHE_LINE];
+} JsvFlashStringCacheLine;
+
+static JsvFlashStringCacheLine jsvFlashStringCache[ESPR_FLASH_STRING_CACHE];
+static uint32_t jsvFlashStringCacheGeneration = 1; // so all lines start off invalid
+
+void jsvFlashStringCacheRead(void *buf, uint32_t addr, uint32_t len) {
+  unsigned char *dst = (unsigned char*)buf;
+  while (len) {
+    uint32_t lineAddr = addr & ~(uint32_t)(JSV_FLASH_STRING_CACHE_LINE-1);
+    JsvFlashStringCacheLine *line = &jsvFlashStringCache[(lineAddr / JSV_FLASH_STRING_CACHE_LINE) % ESPR_FLASH_STRING_CACHE];
+    if (line->addr!=lineAddr || line->generation!=jsvFlashStringCacheGeneration) {
+      jshFlashRead(line->data, lineAddr, JSV_FLASH_STRING_CACHE_LINE);
+      line->addr = lineAddr;
+      line->generation = jsvFlashStringCacheGeneration;
+    }
+    uint32_t offset = addr - lineAddr;
+    uint32_t l = JSV_FLASH_STRING_CACHE_LINE - offset;
+    if (l>len) l=len;
+    memcpy(dst, &line->data[offset], l);
+    dst += l;
+    addr += l;
+    len -= l;
+  }
+}
+
+void jsvFlashStringCacheClear() {
+  jsvFlashStringCacheGeneration++;
+}
+#endif
+
 // If charIdx doesn't fit in the current stringext, go forward along the string
 static void jsvStringIteratorCatchUp(JsvStringIterator *it) {
   while (it->charIdx>0 && it->charIdx >= it->charsInVar) {
@@ -324,13 +366,37 @@ void jsvStringIteratorGetPtrAndNext(JsvStringIterator *it, unsigned char **data,
 
 void jsvStringIteratorGotoEnd(JsvStringIterator *it) {
   assert(it->var);
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  // If we're at the start of a long string, skip straight to the last block we knew about
+  JsVarRef str = 0;
+  unsigned int blocks = 0;
+  if (it->varIndex==0 && jsvIsBasicString(it->var) && jsvGetLastChild(it->var)) {
+    str = jsvGetRef(it->var);
+    size_t tailIndex;
+    JsVarRef tail = jsvStringTailGet(str, &tailIndex);
+    if (tail) {
+      jsvUnLock(it->var);
+      it->var = jsvLock(tail);
+      it->varIndex = tailIndex;
+      it->charsInVar = jsvGetCharactersInVar(it->var);
+      blocks = JSVAR_STRING_TAIL_MIN_BLOCKS; // so we update the tail below
+    }
+  }
+#endif
   while (jsvGetLastChild(it->var)) {
     JsVar *next = jsvLock(jsvGetLastChild(it->var));
     jsvUnLock(it->var);
     it->var = next;
     it->varIndex += it->charsInVar;
     it->charsInVar = jsvGetCharactersInVar(it->var);
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+    blocks++;
+#endif
   }
+#if JSVAR_STRING_TAIL_CACHE_SIZE>0
+  if (str && blocks>=JSVAR_STRING_TAIL_MIN_BLOCKS)
+    jsvStringTailSet(str, jsvGetRef(it->var), it->varIndex);
+#endif
   it->ptr = &it->var->varData.str[0];
   if (it->charsInVar) it->charIdx = it->charsInVar-1;
   else it->charIdx = 0;
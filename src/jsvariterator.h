@@ -102,6 +102,16 @@ void jsvStringIteratorNext(JsvStringIterator *it);
 /// Returns a pointer to the next block of data and its length, and moves on to the data after
 void jsvStringIteratorGetPtrAndNext(JsvStringIterator *it, unsigned char **data, unsigned int *len);
 
+#if defined(SPIFLASH_BASE) && ESPR_FLASH_STRING_CACHE>0
+/// Read data for a Flash String from flash via a small cache
+void jsvFlashStringCacheRead(void *buf, uint32_t addr, uint32_t len);
+/// Call whenever flash that Flash Strings could point to is written or erased - stops jsvFlashStringCacheRead returning old data
+void jsvFlashStringCacheClear();
+#else
+#define jsvFlashStringCacheRead jshFlashRead
+#define jsvFlashStringCacheClear()
+#endif
+
 #ifdef SPIFLASH_BASE
 // For 'Flash Strings' only - loads each block from flash memory as required
 static void jsvStringIteratorLoadFlashString(JsvStringIterator *it) {
@@ -115,7 +125,7 @@ static void jsvStringIteratorLoadFlashString(JsvStringIterator *it) {
     it->charsInVar = l - it->varIndex;
     if (it->charsInVar > sizeof(it->flashStringBuffer))
       it->charsInVar = sizeof(it->flashStringBuffer);
-    jshFlashRead(it->flashStringBuffer, (uint32_t)it->varIndex+(uint32_t)(size_t)it->var->varData.nativeStr.ptr, (uint32_t)it->charsInVar);
+    jsvFlashStringCacheRead(it->flashStringBuffer, (uint32_t)it->varIndex+(uint32_t)(size_t)it->var->varData.nativeStr.ptr, (uint32_t)it->charsInVar);
     it->ptr = (char*)it->flashStringBuffer;
   }
 }
@@ -699,6 +699,40 @@ JsVar *jswrap_espruino_getErrorFlags() {
   return jswrap_espruino_getErrorFlagArray(flags);
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "getIOStats",
+  "generate" : "jshGetIOStats",
+  "params" : [
+    ["reset","bool","(optional) If true, `ioHighWater`, `txHighWater` and `dropped` are reset after being returned"]
+  ],
+  "return" : ["JsVar","An object containing information about Espruino's IO queues"]
+}
+Return information about the queue of received data/events (the IO queue) and
+the queue of data waiting to be sent (the transmit queue):
+
+* `ioSize` : How many events the IO queue can hold (received characters are packed several to an event)
+* `ioUsed` : How many events are in the IO queue right now
+* `txSize` : How many characters the transmit queue can hold
+* `txUsed` : How many characters are in the transmit queue right now
+
+On builds with `ESPR_IO_STATS` (eg. Linux) there is also information about
+what has happened since startup (or since `getIOStats(true)`), which can help
+when choosing buffer sizes for fast serial links:
+
+* `ioHighWater` : The most events the IO queue has had in it
+* `txHighWater` : The most characters the transmit queue has had in it
+* `dropped` : An object containing how many events were lost for each device
+  because the IO queue was full - for example `{Serial1:20}`. For serial
+  devices this counts characters. When anything is lost, `E.getErrorFlags()`
+  will also contain `'FIFO_FULL'`.
+
+The queue sizes can be changed for a board with `io_buffer_size` and
+`tx_buffer_size` in its `BOARD.py` file.
+*/
+
 
 /*JSON{
   "type" : "staticmethod",
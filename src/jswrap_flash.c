@@ -106,6 +106,7 @@ void jswrap_flash_erasePage(JsVar *addr) {
     return;
   }
   jshFlashErasePage((uint32_t)jsvGetInteger(addr));
+  jsvFlashStringCacheClear();
 }
 
 /*JSON{
@@ -625,7 +625,10 @@ If the `options` parameter is an object, it can contain the following informatio
    irq : false(default)
    // Advanced: If specified, the given pin will be read whenever the watch is called
    // and the state will be included as a 'data' field in the callback
-   data : pin
+   data : pin,
+   // Advanced: If true (and repeat:true), edges that arrive together are reported
+   // in one callback with 'count' and 'times' fields (see below)
+   coalesce : false(default)
 }
 ```
 
@@ -635,6 +638,10 @@ The `function` callback is called with an argument, which is an object of type `
  * `time` is the time in seconds at which the pin changed state
  * `lastTime` is the time in seconds at which the **pin last changed state**. When using `edge:'rising'` or `edge:'falling'`, this is not the same as when the function was last called.
  * `data` is included if `data:pin` was specified in the options, and can be used for reading in clocked data
+ * `count` and `times` are included if `coalesce:true` was specified. When a pin changes
+   quickly, all the edges that were received before Espruino got around to handling them are
+   reported in a single callback: `count` is the number of edges, `times` is an array of the time
+   of each, and `state`/`time` are for the last edge. This doesn't apply to edges that are debounced.
 
 For instance, if you want to measure the length of a positive pulse you could use `setWatch(function(e) { console.log(e.time-e.lastTime); }, BTN, { repeat:true, edge:'falling' });`.
 This will only be called on the falling edge of the pulse, but will be able to measure the width of the pulse because `e.lastTime` is the time of the rising edge.
@@ -674,6 +681,7 @@ JsVar *jswrap_interface_setWatch(
   JsVarFloat debounce = 0;
   int edge = 0;
   bool isIRQ = false;
+  bool coalesce = false;
   Pin dataPin = PIN_UNDEFINED;
   if (IS_PIN_A_BUTTON(pin)) {
     edge = 1;
@@ -706,6 +714,7 @@ JsVar *jswrap_interface_setWatch(
       return 0;
     }
     isIRQ = jsvGetBoolAndUnLock(jsvObjectGetChild(repeatOrObject, "irq", 0));
+    coalesce = jsvGetBoolAndUnLock(jsvObjectGetChild(repeatOrObject, "coalesce", 0));
     dataPin = jshGetPinFromVarAndUnLock(jsvObjectGetChild(repeatOrObject, "data", 0));
   } else
     repeat = jsvGetBool(repeatOrObject);
@@ -720,6 +729,7 @@ JsVar *jswrap_interface_setWatch(
       if (repeat) jsvObjectSetChildAndUnLock(watchPtr, "recur", jsvNewFromBool(repeat));
       if (debounce>0) jsvObjectSetChildAndUnLock(watchPtr, "debounce", jsvNewFromInteger((JsVarInt)jshGetTimeFromMilliseconds(debounce)));
       if (edge) jsvObjectSetChildAndUnLock(watchPtr, "edge", jsvNewFromInteger(edge));
+      if (coalesce) jsvObjectSetChildAndUnLock(watchPtr, "coalesce", jsvNewFromBool(coalesce));
       jsvObjectSetChild(watchPtr, "callback", func); // no unlock intentionally
       jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(jshPinInput(pin)));
     }
@@ -751,6 +761,7 @@ JsVar *jswrap_interface_setWatch(
     JsVar *watchArrayPtr = jsvLock(watchArray);
     itemIndex = jsvArrayAddToEnd(watchArrayPtr, watchPtr, 1) - 1;
     jsvUnLock2(watchArrayPtr, watchPtr);
+    jsiWatchesChanged();
 
 
   }
@@ -787,6 +798,7 @@ void jswrap_interface_clearWatch(JsVar *idVarArr) {
     // remove all items
     jsvRemoveAllChildren(watchArrayPtr);
     jsvUnLock(watchArrayPtr);
+    jsiWatchesChanged();
   } else {
     JsVar *idVar = jsvGetArrayItem(idVarArr, 0);
     if (jsvIsUndefined(idVar)) {
@@ -804,6 +816,7 @@ void jswrap_interface_clearWatch(JsVar *idVarArr) {
       JsVar *watchArrayPtr = jsvLock(watchArray);
       jsvRemoveChild(watchArrayPtr, watchNamePtr);
       jsvUnLock2(watchNamePtr, watchArrayPtr);
+      jsiWatchesChanged();
 
       // Now check if this pin is still being watched
       if (!jsiIsWatchingPin(pin))
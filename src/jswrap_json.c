@@ -53,108 +53,336 @@ Convert the given object into a JSON string which can subsequently be parsed wit
 * The `replacer` argument is ignored
 * Typed arrays like `new Uint8Array(5)` will be dumped as if they were arrays, not as if they were objects (since it is more compact)
  */
+/// Get the flags and whitespace (at least 11 chars) JSON.stringify should use for the given 'space' argument
+JSONFlags jswrap_json_stringify_flags(JsVar *space, char *whitespace) {
+  JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON;
+  whitespace[0] = 0;
+  if (jsvIsUndefined(space) || jsvIsNull(space)) {
+    // nothing
+  } else if (jsvIsNumeric(space)) {
+    int s = (int)jsvGetInteger(space);
+    if (s<0) s=0;
+    if (s>10) s=10;
+    whitespace[s] = 0;
+    while (s) whitespace[--s]=' ';
+  } else {
+    size_t l = jsvGetString(space, whitespace, 10);
+    whitespace[l]=0; // add trailing 0
+  }
+  if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
+  return flags;
+}
+
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space) {
   NOT_USED(replacer);
-  JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON;
   JsVar *result = jsvNewFromEmptyString();
   if (result) {// could be out of memory
-    char whitespace[11] = "";
-    if (jsvIsUndefined(space) || jsvIsNull(space)) {
-      // nothing
-    } else if (jsvIsNumeric(space)) {
-      int s = (int)jsvGetInteger(space);
-      if (s<0) s=0;
-      if (s>10) s=10;
-      whitespace[s] = 0;
-      while (s) whitespace[--s]=' ';
-    } else {
-      size_t l = jsvGetString(space, whitespace, sizeof(whitespace)-1);
-      whitespace[l]=0; // add trailing 0
-    }
-    if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
+    char whitespace[11];
+    JSONFlags flags = jswrap_json_stringify_flags(space, whitespace);
     jsfGetJSONWhitespace(v, result, flags, whitespace);
   }
   return result;
 }
 
+#ifndef SAVE_ON_FLASH
+typedef struct {
+  JsVar *destination;
+  JsVar *writeFunc;
+} JsonStringifyToInfo;
 
-JsVar *jswrap_json_parse_internal() {
-  switch (lex->tk) {
-  case LEX_R_TRUE:  jslGetNextToken(); return jsvNewFromBool(true);
-  case LEX_R_FALSE: jslGetNextToken(); return jsvNewFromBool(false);
-  case LEX_R_NULL:  jslGetNextToken(); return jsvNewWithFlags(JSV_NULL);
-  case '-': {
-    jslGetNextToken();
-    if (lex->tk!=LEX_INT && lex->tk!=LEX_FLOAT) return 0;
-    JsVar *v = jswrap_json_parse_internal();
-    JsVar *zero = jsvNewFromInteger(0);
-    JsVar *r = jsvMathsOp(zero, v, '-');
-    jsvUnLock2(v, zero);
-    return r;
+static void jswrap_json_stringifyTo_chunk(const char *data, size_t len, void *userData) {
+  JsonStringifyToInfo *info = (JsonStringifyToInfo*)userData;
+  if (jspHasError()) return; // the last write failed - don't keep trying
+  JsVar *str = jsvNewStringOfLength((unsigned int)len, data);
+  if (!str) return;
+  jsvUnLock2(jspExecuteFunction(info->writeFunc, info->destination, 1, &str), str);
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "JSON",
+  "name" : "stringifyTo",
+  "generate" : "jswrap_json_stringifyTo",
+  "params" : [
+    ["data","JsVar","The data to be converted to JSON"],
+    ["destination","JsVar","An object with a `write` method - eg. `Serial1`, a socket, an HTTP response or a `StorageFile`"],
+    ["space","JsVar","The number of spaces to use for padding, a string, or null/undefined for no whitespace "]
+  ],
+  "return" : ["int","The number of characters written"]
+}
+Convert the given object to JSON (as with `JSON.stringify`) and write it
+to `destination` a few characters at a time, by calling `destination.write`.
+
+The JSON string is never created in full, so this can be used to output
+data that would need more free RAM than is available to stringify.
+
+```
+JSON.stringifyTo(bigObject, Serial1);
+// append to a StorageFile
+JSON.stringifyTo(bigObject, require("Storage").open("log","a"));
+```
+ */
+JsVarInt jswrap_json_stringifyTo(JsVar *data, JsVar *destination, JsVar *space) {
+  JsonStringifyToInfo info;
+  info.destination = destination;
+  info.writeFunc = jspGetNamedField(destination, "write", false);
+  if (!jsvIsFunction(info.writeFunc)) {
+    jsExceptionHere(JSET_TYPEERROR, "Destination must have a 'write' method");
+    jsvUnLock(info.writeFunc);
+    return 0;
+  }
+  char whitespace[11];
+  JSONFlags flags = jswrap_json_stringify_flags(space, whitespace);
+  size_t len = jsfGetJSONChunked(data, flags, whitespace, jswrap_json_stringifyTo_chunk, &info);
+  jsvUnLock(info.writeFunc);
+  return (JsVarInt)len;
+}
+#endif
+
+/* JSON.parse reads characters straight from the string (which may be in
+ * flash) rather than using the JS lexer, so there are no token strings to
+ * copy and no keywords/regexes to check for. It accepts the same things the
+ * lexer did: single-quoted strings, JS escapes, hex numbers and comments. */
+typedef struct {
+  JsvStringIterator it;
+  char ch; ///< The current character (0 at the end of the string)
+} JsonParser;
+
+static ALWAYS_INLINE void jsonParseNextCh(JsonParser *p) {
+  jsvStringIteratorNextInline(&p->it);
+  p->ch = jsvStringIteratorGetChar(&p->it);
+}
+
+static void jsonParseError(JsonParser *p, const char *expecting) {
+  if (p->ch)
+    jsExceptionHere(JSET_SYNTAXERROR, "Expecting %s, got '%c' at position %d", expecting, p->ch, (int)jsvStringIteratorGetIndex(&p->it));
+  else
+    jsExceptionHere(JSET_SYNTAXERROR, "Expecting %s, got end of input", expecting);
+}
+
+/// Skip whitespace and comments. Returns false (and raises an exception) on an unfinished comment
+static bool jsonParseSkipWhitespace(JsonParser *p) {
+  while (true) {
+    while (isWhitespace(p->ch)) jsonParseNextCh(p);
+    if (p->ch!='/') return true;
+    jsonParseNextCh(p);
+    if (p->ch=='/') { // line comment
+      while (p->ch && p->ch!='\n') jsonParseNextCh(p);
+    } else if (p->ch=='*') { // block comment
+      char last = 0;
+      jsonParseNextCh(p);
+      while (p->ch && !(last=='*' && p->ch=='/')) {
+        last = p->ch;
+        jsonParseNextCh(p);
+      }
+      if (!p->ch) {
+        jsonParseError(p, "end of comment");
+        return false;
+      }
+      jsonParseNextCh(p);
+    } else {
+      jsonParseError(p, "a valid value");
+      return false;
+    }
+  }
+}
+
+/// Parse a string (the current character is the opening quote)
+static JsVar *jsonParseString(JsonParser *p) {
+  char delim = p->ch;
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  JsvStringIterator dst;
+  jsvStringIteratorNew(&dst, str, 0);
+  jsonParseNextCh(p);
+  while (p->ch && p->ch!=delim && p->ch!='\n') {
+    char ch = p->ch;
+    jsonParseNextCh(p);
+    if (ch=='\\') {
+      // the same escapes as jslLexString
+      ch = p->ch;
+      jsonParseNextCh(p);
+      switch (ch) {
+      case 'n'  : ch = 0x0A; break;
+      case 'b'  : ch = 0x08; break;
+      case 'f'  : ch = 0x0C; break;
+      case 'r'  : ch = 0x0D; break;
+      case 't'  : ch = 0x09; break;
+      case 'v'  : ch = 0x0B; break;
+      case 'u'  :
+      case 'x'  : { // hex digits
+        if (ch=='u') {
+          // We don't support unicode, so we just take the bottom 8 bits
+          jsonParseNextCh(p);
+          jsonParseNextCh(p);
+        }
+        char hi = p->ch;
+        jsonParseNextCh(p);
+        char lo = p->ch;
+        jsonParseNextCh(p);
+        ch = (char)hexToByte(hi, lo);
+      } break;
+      default:
+        if (ch>='0' && ch<='7') { // octal digits
+          int n = ch-'0';
+          if (p->ch>='0' && p->ch<='7') {
+            n = n*8 + p->ch-'0';
+            jsonParseNextCh(p);
+            if (p->ch>='0' && p->ch<='7') {
+              n = n*8 + p->ch-'0';
+              jsonParseNextCh(p);
+            }
+          }
+          ch = (char)n;
+        } // for anything else, just push the character through
+        break;
+      }
+    }
+    jsvStringIteratorAppend(&dst, ch);
   }
-  case LEX_INT: {
-    long long v = stringToInt(jslGetTokenValueAsString());
-    jslGetNextToken();
-    return jsvNewFromLongInteger(v);
+  jsvStringIteratorFree(&dst);
+  if (p->ch!=delim) {
+    jsvUnLock(str);
+    jsonParseError(p, "end of string");
+    return 0;
   }
-  case LEX_FLOAT: {
-    JsVarFloat v = stringToFloat(jslGetTokenValueAsString());
-    jslGetNextToken();
-    return jsvNewFromFloat(v);
+  jsonParseNextCh(p);
+  return str;
+}
+
+/// Parse a number (the current character is a digit or '.')
+static JsVar *jsonParseNumber(JsonParser *p, bool negative) {
+  char buf[JSLEX_MAX_TOKEN_LENGTH];
+  size_t len = 0;
+  bool isHex = p->ch=='0';
+  bool isFloat = false;
+  while (isNumeric(p->ch) || isAlpha(p->ch) || p->ch=='.' ||
+         ((p->ch=='+' || p->ch=='-') && !isHex && len && (buf[len-1]=='e' || buf[len-1]=='E'))) {
+    if (len==1 && isHex) isHex = p->ch=='x' || p->ch=='X';
+    if (p->ch=='.' || (!isHex && (p->ch=='e' || p->ch=='E'))) isFloat = true;
+    if (len < sizeof(buf)-1) buf[len++] = p->ch;
+    jsonParseNextCh(p);
   }
-  case LEX_STR: {
-    JsVar *a = jslGetTokenValueAsVar();
-    jslGetNextToken();
-    return a;
+  buf[len] = 0;
+  if (isFloat) {
+    JsVarFloat v = stringToFloat(buf);
+    return jsvNewFromFloat(negative ? -v : v);
   }
+  long long v = stringToInt(buf);
+  return jsvNewFromLongInteger(negative ? -v : v);
+}
+
+/// Check that the next characters are 'word' (the first character has already been checked)
+static bool jsonParseWord(JsonParser *p, const char *word) {
+  while (*word) {
+    if (p->ch != *word) {
+      jsonParseError(p, "a valid value");
+      return false;
+    }
+    jsonParseNextCh(p);
+    word++;
+  }
+  if (isAlpha(p->ch) || isNumeric(p->ch)) {
+    jsonParseError(p, "a valid value");
+    return false;
+  }
+  return true;
+}
+
+static JsVar *jsonParseValue(JsonParser *p) {
+  if (!jsonParseSkipWhitespace(p)) return 0;
+  switch (p->ch) {
+  case 't': return jsonParseWord(p, "true") ? jsvNewFromBool(true) : 0;
+  case 'f': return jsonParseWord(p, "false") ? jsvNewFromBool(false) : 0;
+  case 'n': return jsonParseWord(p, "null") ? jsvNewWithFlags(JSV_NULL) : 0;
+  case '-': {
+    jsonParseNextCh(p);
+    if (!jsonParseSkipWhitespace(p)) return 0;
+    if (!isNumeric(p->ch) && p->ch!='.') {
+      jsonParseError(p, "a number");
+      return 0;
+    }
+    return jsonParseNumber(p, true);
+  }
+  case '"':
+  case '\'': return jsonParseString(p);
   case '[': {
     JsVar *arr = jsvNewEmptyArray(); if (!arr) return 0;
-    jslGetNextToken(); // [
-    while (lex->tk != ']' && !jspHasError()) {
-      JsVar *value = jswrap_json_parse_internal();
-      if (!value ||
-          (lex->tk!=']' && !jslMatch(','))) {
+    jsonParseNextCh(p); // [
+    if (!jsonParseSkipWhitespace(p)) {
+      jsvUnLock(arr);
+      return 0;
+    }
+    while (p->ch != ']' && !jspHasError()) {
+      JsVar *value = jsonParseValue(p);
+      if (!value || !jsonParseSkipWhitespace(p)) {
         jsvUnLock2(value, arr);
         return 0;
       }
       jsvArrayPush(arr, value);
       jsvUnLock(value);
+      if (p->ch==',') {
+        jsonParseNextCh(p);
+        if (!jsonParseSkipWhitespace(p)) break;
+      } else if (p->ch!=']') {
+        jsonParseError(p, "',' or ']'");
+        break;
+      }
     }
-    if (!jslMatch(']')) {
+    if (p->ch!=']' || jspHasError()) {
       jsvUnLock(arr);
       return 0;
     }
+    jsonParseNextCh(p); // ]
     return arr;
   }
   case '{': {
     JsVar *obj = jsvNewObject(); if (!obj) return 0;
-    jslGetNextToken(); // {
-    while (lex->tk == LEX_STR && !jspHasError()) {
-      JsVar *key = jsvAsArrayIndexAndUnLock(jslGetTokenValueAsVar());
-      jslGetNextToken();
+    jsonParseNextCh(p); // {
+    if (!jsonParseSkipWhitespace(p)) {
+      jsvUnLock(obj);
+      return 0;
+    }
+    while ((p->ch=='"' || p->ch=='\'') && !jspHasError()) {
+      JsVar *key = jsonParseString(p);
+      if (!key) break;
+      key = jsvAsArrayIndexAndUnLock(key);
       JsVar *value = 0;
-      if (!jslMatch(':') ||
-          !(value=jswrap_json_parse_internal()) ||
-          (lex->tk!='}' && !jslMatch(','))) {
-        jsvUnLock3(key, value, obj);
-        return 0;
+      if (!jsonParseSkipWhitespace(p) || p->ch!=':') {
+        if (!jspHasError()) jsonParseError(p, "':'");
+      } else {
+        jsonParseNextCh(p); // :
+        value = jsonParseValue(p);
+      }
+      if (!value || !jsonParseSkipWhitespace(p)) {
+        jsvUnLock2(key, value);
+        break;
       }
       jsvAddName(obj, jsvMakeIntoVariableName(key, value));
       jsvUnLock2(value, key);
+      if (p->ch==',') {
+        jsonParseNextCh(p);
+        if (!jsonParseSkipWhitespace(p)) break;
+      } else if (p->ch!='}') {
+        jsonParseError(p, "',' or '}'");
+        break;
+      }
     }
-    if (!jslMatch('}')) {
+    if (p->ch!='}' || jspHasError()) {
+      if (!jspHasError()) jsonParseError(p, "'}'");
       jsvUnLock(obj);
       return 0;
     }
+    jsonParseNextCh(p); // }
     return obj;
   }
-  default: {
-    char buf[32];
-    jslTokenAsString(lex->tk, buf, 32);
-    jsExceptionHere(JSET_SYNTAXERROR, "Expecting a valid value, got %s", buf);
+  default:
+    if (isNumeric(p->ch) || p->ch=='.')
+      return jsonParseNumber(p, false);
+    jsonParseError(p, "a valid value");
     return 0; // undefined = error
   }
-  }
 }
 
 /*JSON{
@@ -169,17 +397,17 @@ JsVar *jswrap_json_parse_internal() {
 }
 Parse the given JSON string into a JavaScript object
 
-NOTE: This implementation uses eval() internally, and as such it is unsafe as it can allow arbitrary JS commands to be executed.
+NOTE: Like other JS implementations this does not execute any code. It also accepts some things that strict JSON does not - single-quoted strings, JS string escapes, hex numbers and comments.
  */
 JsVar *jswrap_json_parse(JsVar *v) {
-  JsLex lex;
   JsVar *str = jsvAsString(v);
-  JsLex *oldLex = jslSetLex(&lex);
-  jslInit(str);
+  if (!str) return 0;
+  JsonParser p;
+  jsvStringIteratorNew(&p.it, str, 0);
+  p.ch = jsvStringIteratorGetChar(&p.it);
+  JsVar *res = jsonParseValue(&p);
+  jsvStringIteratorFree(&p.it);
   jsvUnLock(str);
-  JsVar *res = jswrap_json_parse_internal();
-  jslKill();
-  jslSetLex(oldLex);
   return res;
 }
 
@@ -494,6 +722,37 @@ void jsfGetJSONWhitespace(JsVar *var, JsVar *result, JSONFlags flags, const char
   jsvStringIteratorFree(&it);
 }
 
+typedef struct {
+  jsfGetJSONChunkCallback callback;
+  void *userData;
+  size_t len; ///< Characters currently in buf
+  size_t total; ///< Characters output so far
+  char buf[JSON_CHUNK_SIZE];
+} JsonChunkBuffer;
+
+static void jsfGetJSONChunkedCallback(const char *str, void *userData) {
+  JsonChunkBuffer *b = (JsonChunkBuffer*)userData;
+  while (*str) {
+    if (b->len == sizeof(b->buf)) {
+      if (b->callback) b->callback(b->buf, b->len, b->userData);
+      b->total += b->len;
+      b->len = 0;
+    }
+    b->buf[b->len++] = *(str++);
+  }
+}
+
+size_t jsfGetJSONChunked(JsVar *var, JSONFlags flags, const char *whitespace, jsfGetJSONChunkCallback callback, void *userData) {
+  JsonChunkBuffer b;
+  b.callback = callback;
+  b.userData = userData;
+  b.len = 0;
+  b.total = 0;
+  jsfGetJSONWithCallback(var, NULL, flags, whitespace, jsfGetJSONChunkedCallback, &b);
+  if (b.len && b.callback) b.callback(b.buf, b.len, b.userData);
+  return b.total + b.len;
+}
+
 void jsfGetJSON(JsVar *var, JsVar *result, JSONFlags flags) {
   jsfGetJSONWhitespace(var, result, flags, 0);
 }
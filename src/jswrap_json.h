@@ -14,6 +14,7 @@
 #include "jsvar.h"
 
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space);
+JsVarInt jswrap_json_stringifyTo(JsVar *data, JsVar *destination, JsVar *space);
 JsVar *jswrap_json_parse_ext(JsVar *v, bool throwExceptions);
 JsVar *jswrap_json_parse(JsVar *v);
 
@@ -38,6 +39,9 @@ typedef enum {
   JSON_INDENT            = 4096, // MUST BE THE LAST ENTRY IN JSONFlags - we use this to count the amount of indents
 } JSONFlags;
 
+/// Get the flags and whitespace (at least 11 chars) JSON.stringify should use for the given 'space' argument
+JSONFlags jswrap_json_stringify_flags(JsVar *space, char *whitespace);
+
 /* This is like jsfGetJSONWithCallback, but handles ONLY functions (and does not print the initial 'function' text) */
 void jsfGetJSONForFunctionWithCallback(JsVar *var, JSONFlags flags, vcbprintf_callback user_callback, void *user_data);
 /* Dump to JSON, using the given callbacks for printing data
@@ -48,6 +52,14 @@ flags = control how stuff is rendered
 */
 void jsfGetJSONWithCallback(JsVar *var, JsVar *varName, JSONFlags flags, const char *whitespace, vcbprintf_callback user_callback, void *user_data);
 
+/// How many characters jsfGetJSONChunked buffers up before calling its callback
+#define JSON_CHUNK_SIZE 128
+typedef void (*jsfGetJSONChunkCallback)(const char *data, size_t len, void *userData);
+/* Dump to JSON, calling 'callback' with up to JSON_CHUNK_SIZE characters at a time, so the
+whole string never has to be in memory. Returns the total length. If 'callback' is 0, this
+just works out the length */
+size_t jsfGetJSONChunked(JsVar *var, JSONFlags flags, const char *whitespace, jsfGetJSONChunkCallback callback, void *userData);
+
 /* Convenience function for using jsfGetJSONWithCallback - print to var */
 void jsfGetJSONWhitespace(JsVar *var, JsVar *result, JSONFlags flags, const char *whitespace);
 /* Convenience function for using jsfGetJSONWithCallback - print to var */
@@ -20,6 +20,7 @@
 #include "jswrap_espruino.h" // jswrap_espruino_getConsole
 #include "jswrapper.h"
 #include "jsinteractive.h"
+#include "jsflash.h" // jsfGetStats
 #ifdef PUCKJS
 #include "jswrap_puck.h" // process.env
 #endif
@@ -153,6 +154,9 @@ Run a Garbage Collection pass, and return an object containing information on me
 * `history` : Memory used for command history - that is freed if memory is low. Note that this is INCLUDED in the figure for 'free'
 * `gc`      : Memory freed during the GC pass
 * `gctime`  : Time taken for GC pass (in milliseconds)
+* `gccount` : (not on devices with limited flash) Number of full GC passes since Espruino started (including this one)
+* `peak`    : (not on devices with limited flash) The most memory used at once (in blocks) since the last call to `process.memory()`
+* `storage` : (on Linux) Information about how Storage is being used, as returned by `require("Storage").getStats()` but without `pageErases`
 * `blocksize` : Size of a block (variable) in bytes
 * `stackEndAddress` : (on ARM) the address (that can be used with peek/poke/etc) of the END of the stack. The stack grows down, so unless you do a lot of recursion the bytes above this can be used.
 * `flash_start`      : (on ARM) the address of the start of flash memory (usually `0x8000000`)
@@ -184,6 +188,15 @@ JsVar *jswrap_process_memory() {
     jsvObjectSetChildAndUnLock(obj, "history", jsvNewFromInteger((JsVarInt)history));
     jsvObjectSetChildAndUnLock(obj, "gc", jsvNewFromInteger((JsVarInt)gc));
     jsvObjectSetChildAndUnLock(obj, "gctime", jsvNewFromFloat(jshGetMillisecondsFromTime(time2-time1)));
+#ifndef SAVE_ON_FLASH
+    jsvObjectSetChildAndUnLock(obj, "gccount", jsvNewFromInteger((JsVarInt)jsvGetGarbageCollectCount()));
+    jsvObjectSetChildAndUnLock(obj, "peak", jsvNewFromInteger((JsVarInt)jsvGetMemoryPeak()));
+#endif
+#if defined(LINUX) && ESPR_STORAGE_STATS
+    JsVar *storage = jsfGetStats(false);
+    if (storage) jsvObjectRemoveChild(storage, "pageErases"); // too big to create every time memory is checked
+    jsvObjectSetChildAndUnLock(obj, "storage", storage);
+#endif
     jsvObjectSetChildAndUnLock(obj, "blocksize", jsvNewFromInteger(sizeof(JsVar)));
 
 #ifdef ARM
@@ -196,5 +209,8 @@ JsVar *jswrap_process_memory() {
     jsvObjectSetChildAndUnLock(obj, "flash_length", jsvNewFromInteger((JsVarInt)FLASH_TOTAL));
 #endif
   }
+#ifndef SAVE_ON_FLASH
+  jsvResetMemoryPeak();
+#endif
   return obj;
 }
@@ -394,7 +394,7 @@ void _jswrap_serial_print(JsVar *parent, JsVar *arg, bool isPrint, bool newLine)
     return;
 
   if (isPrint) arg = jsvAsString(arg);
-  jsvIterateCallback(arg, (void (*)(int,  void *))serialSend, (void*)&serialSendData);
+  jsserialSendData(arg, serialSend, &serialSendData);
   if (isPrint) jsvUnLock(arg);
   if (newLine) {
     serialSend((unsigned char)'\r', &serialSendData);
@@ -39,6 +39,42 @@ const int STORAGEFILE_CHUNKSIZE =
   (FLASH_PAGE_SIZE*10) - sizeof(JsfFileHeader);
 #endif
 
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+/// Where we last knew a StorageFile ended, so we don't have to find every chunk
+typedef struct {
+  JsfFileName name; ///< name of the file, with no chunk number
+  int chunk; ///< the last chunk we know exists
+  int length; ///< total length of all the chunks before 'chunk'
+} StorageFileCacheEntry;
+static StorageFileCacheEntry storageFileCache[ESPR_STORAGEFILE_CACHE_SIZE];
+static unsigned int storageFileCacheNext; ///< the next entry to replace
+
+static StorageFileCacheEntry *storageFileCacheFind(JsfFileName fname, int fnamei) {
+  fname.c[fnamei] = 0;
+  for (int i=0;i<ESPR_STORAGEFILE_CACHE_SIZE;i++)
+    if (memcmp(&storageFileCache[i].name, &fname, sizeof(JsfFileName))==0)
+      return &storageFileCache[i];
+  return 0;
+}
+
+static void storageFileCachePut(JsfFileName fname, int fnamei, int chunk, int length) {
+  StorageFileCacheEntry *e = storageFileCacheFind(fname, fnamei);
+  if (!e) {
+    e = &storageFileCache[storageFileCacheNext];
+    storageFileCacheNext = (storageFileCacheNext+1) % ESPR_STORAGEFILE_CACHE_SIZE;
+    e->name = fname;
+    e->name.c[fnamei] = 0;
+  }
+  e->chunk = chunk;
+  e->length = length;
+}
+
+/// Forget everything - call when files might have been erased
+static void storageFileCacheClear() {
+  memset(storageFileCache, 0, sizeof(storageFileCache));
+}
+#endif
+
 /*JSON{
   "type" : "library",
   "class" : "Storage"
@@ -76,6 +112,9 @@ created with `require("Storage").write(...)` as well
 as any code saved with `save()` or `E.setBootCode()`.
  */
 void jswrap_storage_eraseAll() {
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+  storageFileCacheClear();
+#endif
   jsfEraseAll();
 }
 
@@ -94,6 +133,9 @@ Erase a single file from the flash storage area.
 `StorageFile`s created with `require("Storage").open(filename, ...)`
  */
 void jswrap_storage_erase(JsVar *name) {
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+  storageFileCacheClear(); // in case this was a StorageFile chunk
+#endif
   jsfEraseFile(jsfNameFromVar(name));
 }
 
@@ -121,6 +163,10 @@ If you evaluate this string with `eval`, any functions
 contained in the String will keep their code stored
 in flash memory.
 
+Files written with `require("Storage").writeCompressed(...)` are
+decompressed when read, so the String returned for them is stored in RAM.
+Only the parts of the file needed for `offset` and `length` are decompressed.
+
 **Note:** This function should be used with normal files, and not
 `StorageFile`s created with `require("Storage").open(filename, ...)`
 */
@@ -244,7 +290,45 @@ to write large files into onboard storage.
 **Note:** This function should be used with normal files, and not
 `StorageFile`s created with `require("Storage").open(filename, ...)`
 */
+#ifndef SAVE_ON_FLASH
+#define STORAGE_BATCH_NAME "StorBatch"
+/** If Storage.beginBatch was called, add this file to the batch (to write on commitBatch) and return true.
+ * If isJSON, data is always converted to JSON first (as for writeJSON) - otherwise only objects are.
+ * If isPartial (only part of the file is being written) it can't be added, so create an exception */
+static bool jswrap_storage_addToBatch(JsVar *name, JsVar *data, bool isJSON, bool isPartial) {
+  JsVar *batch = jsvObjectGetChild(execInfo.hiddenRoot, STORAGE_BATCH_NAME, 0);
+  if (!batch) return false;
+  if (isPartial) {
+    jsvUnLock(batch);
+    jsExceptionHere(JSET_ERROR, "Can't write part of a file while a batch is open");
+    return true;
+  }
+  JsVar *d;
+  if (isJSON || jsvIsObject(data)) {
+    d = jswrap_json_stringify(data,0,0);
+  } else if (jsvIsString(data)) {
+    d = jsvLockAgain(data);
+  } else { // copy arrays/etc now, so changes to them before commitBatch don't matter
+    JSV_GET_AS_CHAR_ARRAY(dPtr, dLen, data);
+    d = dPtr ? jsvNewStringOfLength((unsigned int)dLen, dPtr) : 0;
+  }
+  if (d) {
+    JsVar *n = jsfVarFromName(jsfNameFromVar(name));
+    if (n) jsvObjectSetChildVar(batch, n, d);
+    jsvUnLock2(n, d);
+  }
+  jsvUnLock(batch);
+  return true;
+}
+#endif
+
 bool jswrap_storage_write(JsVar *name, JsVar *data, JsVarInt offset, JsVarInt _size) {
+#ifndef SAVE_ON_FLASH
+  if (jswrap_storage_addToBatch(name, data, false, offset!=0 || _size!=0))
+    return !jspHasError();
+  if (jsvIsObject(data))
+    return jswrap_storage_writeJSON(name, data);
+#endif
   JsVar *d;
   if (jsvIsObject(data)) {
     d = jswrap_json_stringify(data,0,0);
@@ -277,16 +361,111 @@ or power is lost.
 Simply write `require("Storage").writeJSON("MyFile", [1,2,3])` to write
 a new file, and `require("Storage").readJSON("MyFile")` to read it.
 
-This is equivalent to: `require("Storage").write(name, JSON.stringify(data))`
+This is equivalent to: `require("Storage").write(name, JSON.stringify(data))`,
+except that the JSON is written straight into flash as it is created, so
+there doesn't have to be enough free RAM to hold the whole JSON string.
 
 **Note:** This function should be used with normal files, and not
 `StorageFile`s created with `require("Storage").open(filename, ...)`
 */
+typedef struct {
+  JsfFileName name;
+  uint32_t compareAddr; ///< If nonzero, compare with the file at this address rather than writing
+  uint32_t offset; ///< How much of the file we have written/compared
+  uint32_t size; ///< The size of the file
+  bool success;
+} JsfWriteJSONInfo;
+
+static void jswrap_storage_writeJSON_chunk(const char *data, size_t len, void *userData) {
+  JsfWriteJSONInfo *info = (JsfWriteJSONInfo*)userData;
+  if (!info->success) return;
+  if (info->offset+len > info->size) { // toJSON returned something different this time?
+    info->success = false;
+    return;
+  }
+  if (info->compareAddr) {
+    char buf[JSON_CHUNK_SIZE];
+    jshFlashRead(buf, info->compareAddr+info->offset, (uint32_t)len);
+    info->success = memcmp(buf, data, len)==0;
+  } else {
+    // The JSON is only in our buffer, so point a native string at it rather than copying it
+    JsVar *d = jsvNewNativeString((char*)data, len);
+    info->success = d && jsfWriteFile(info->name, d, JSFF_NONE, (JsVarInt)info->offset, (JsVarInt)info->size);
+    jsvUnLock(d);
+  }
+  info->offset += (uint32_t)len;
+}
+
 bool jswrap_storage_writeJSON(JsVar *name, JsVar *data) {
-  JsVar *d = jswrap_json_stringify(data,0,0);
-  bool r = jsfWriteFile(jsfNameFromVar(name), d, JSFF_NONE, 0, 0);
+#ifndef SAVE_ON_FLASH
+  // Always add JSON to the batch - not just objects - so it reads back with readJSON
+  if (jswrap_storage_addToBatch(name, data, true, false))
+    return !jspHasError();
+#endif
+  char whitespace[11];
+  JSONFlags flags = jswrap_json_stringify_flags(0, whitespace);
+  // Files must be created with their final size, so work out the length first
+  JsfWriteJSONInfo info;
+  info.name = jsfNameFromVar(name);
+  info.offset = 0;
+  info.size = (uint32_t)jsfGetJSONChunked(data, flags, whitespace, 0, 0);
+  if (jspHasError()) return false;
+  // If there's already a file the same size, don't wear out flash rewriting it with the same data
+  JsfFileHeader header;
+  info.compareAddr = jsfFindFile(info.name, &header);
+  if (info.compareAddr && jsfGetFileSize(&header)==info.size && jsfGetFileFlags(&header)==JSFF_NONE) {
+    info.success = true;
+    jsfGetJSONChunked(data, flags, whitespace, jswrap_storage_writeJSON_chunk, &info);
+    if (info.success && info.offset==info.size) return true;
+    if (jspHasError()) return false;
+  }
+  info.compareAddr = 0;
+  info.offset = 0;
+  info.success = true;
+  jsfGetJSONChunked(data, flags, whitespace, jswrap_storage_writeJSON_chunk, &info);
+  if (info.success && info.offset!=info.size)
+    info.success = false;
+  if (!info.success && !jspHasError())
+    jsExceptionHere(JSET_ERROR, "JSON changed while writing to Storage");
+  return info.success;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "writeCompressed",
+  "generate" : "jswrap_storage_writeCompressed",
+  "params" : [
+    ["name","JsVar","The filename - max 28 characters (case sensitive)"],
+    ["data","JsVar","The data to write"]
+  ],
+  "return" : ["bool","True on success, false on failure"]
+}
+Write/create a file in the flash storage area, compressing it
+to use less space. The file can be read back as normal with
+`require("Storage").read(...)`, `readJSON` or `readArrayBuffer`.
+
+The data is compressed in 1kb blocks, so reading part of the file
+with `require("Storage").read(name, offset, length)` only has to
+decompress the blocks that are needed. Compressed files are
+returned as Strings in RAM rather than memory-mapped Strings.
+
+If the data doesn't get smaller when compressed (or compression
+isn't built in) it is written with `require("Storage").write(...)`.
+
+**Note:** Compressed files can't have parts of them written
+with `require("Storage").write(name, data, offset)`
+*/
+bool jswrap_storage_writeCompressed(JsVar *name, JsVar *data) {
+  JsVar *d;
+  if (jsvIsObject(data))
+    d = jswrap_json_stringify(data,0,0);
+  else
+    d = jsvLockAgainSafe(data);
+  bool success = jsfWriteCompressedFile(jsfNameFromVar(name), d);
   jsvUnLock(d);
-  return r;
+  return success;
 }
 
 /*JSON{
@@ -394,6 +573,81 @@ void jswrap_storage_compact() {
   jsfCompact();
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "beginBatch",
+  "generate" : "jswrap_storage_beginBatch"
+}
+Start a batch of writes. Until `require("Storage").commitBatch()` is called,
+files written with `require("Storage").write(name, data)` or `writeJSON`
+are kept in RAM rather than being written to flash, and reading them
+returns the files that were there before.
+
+When `commitBatch` is called all the files are written at once, and either
+all of them are written or none are, even if power is lost part-way through.
+This is useful when installing an app made up of several files:
+
+```
+var s = require("Storage");
+s.beginBatch();
+s.write("myapp.app.js", appCode);
+s.write("myapp.img", appIcon);
+s.writeJSON("myapp.info", {name:"My App"});
+s.commitBatch();
+```
+
+Calling `beginBatch` again discards anything that hasn't been committed.
+
+**Note:** Writing part of a file (with `offset` or `size`) isn't possible
+while a batch is open.
+*/
+void jswrap_storage_beginBatch() {
+  jsvObjectSetChildAndUnLock(execInfo.hiddenRoot, STORAGE_BATCH_NAME, jsvNewObject());
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "commitBatch",
+  "generate" : "jswrap_storage_commitBatch",
+  "return" : ["bool","True on success, false on failure"]
+}
+Write all the files that have been written since `require("Storage").beginBatch()`
+was called.
+
+All the new files are written into one free area of flash before any of the
+existing files are replaced, so there must be enough free space for both the
+old and new versions of the files. Files that haven't changed aren't rewritten.
+*/
+bool jswrap_storage_commitBatch() {
+  JsVar *batch = jsvObjectGetChild(execInfo.hiddenRoot, STORAGE_BATCH_NAME, 0);
+  if (!batch) {
+    jsExceptionHere(JSET_ERROR, "No batch started - use Storage.beginBatch()");
+    return false;
+  }
+  jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGE_BATCH_NAME);
+  bool success = jsfWriteFiles(batch);
+  jsvUnLock(batch);
+  return success;
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "cancelBatch",
+  "generate" : "jswrap_storage_cancelBatch"
+}
+Discard any files written since `require("Storage").beginBatch()` was called,
+without writing them to flash.
+*/
+void jswrap_storage_cancelBatch() {
+  jsvObjectRemoveChild(execInfo.hiddenRoot, STORAGE_BATCH_NAME);
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifdef" : "DEBUG",
@@ -426,6 +680,101 @@ int jswrap_storage_getFree() {
   return (int)jsfGetFreeSpace(0,true);
 }
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "Storage",
+  "name" : "getStats",
+  "generate" : "jswrap_storage_getStats",
+  "params" : [
+    ["reset","bool","(optional) If true, the counters (`erases`, `written`, etc) are reset to 0 after being returned"]
+  ],
+  "return" : ["JsVar","An object containing statistics about Storage"]
+}
+Return information about how Storage is being used:
+
+* `totalBytes` : Size of Storage in bytes
+* `freeBytes` : Bytes free at the end of Storage (as for `getFree`)
+* `fileBytes` : Bytes used by files (including headers)
+* `fileCount` : Number of files
+* `trashBytes` : Bytes used by deleted/replaced files that will be freed by `compact`
+* `trashCount` : Number of deleted/replaced files
+
+On builds with `ESPR_STORAGE_STATS` (eg. Linux) there are also counts of what
+Storage has done since startup (or since `getStats(true)`), which can help
+to work out how files should be laid out and how long flash will last:
+
+* `erases` : Pages of flash erased
+* `pageErases` : A `Uint32Array` with the number of times each page of Storage has been erased
+* `written` : Bytes written to flash (including file headers and compaction)
+* `compactWritten` : Bytes written while moving files during compaction. Write amplification is `written/(written-compactWritten)`
+* `compactions` : Times Storage has been compacted (including each part of an idle compaction)
+* `lookups` : Times a file has been looked up by name
+* `cacheHits` : Lookups that were answered from RAM without scanning flash
+* `scanned` : File headers read from flash while looking for files
+*/
+JsVar *jswrap_storage_getStats(bool reset) {
+  return jsfGetStats(reset);
+}
+
+/* Find the end of a StorageFile. fname should be the file's name and fnamei the
+ * index of the chunk number in it. Returns the address of the last chunk (or 0 if
+ * the data should go into a new chunk) and sets chunk, offset (the first free byte
+ * in that chunk), fileLen (the chunk's size) and, if non-null, length (the length
+ * of the whole file) */
+static uint32_t jswrap_storagefile_findEnd(JsfFileName fname, int fnamei, int *chunk, int *offset, uint32_t *fileLen, int *length) {
+  int len = 0; // length of the chunks before this one
+  *chunk = 1;
+  JsfFileHeader header;
+  uint32_t addr = 0;
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+  // If we know which chunk was last, start from there
+  StorageFileCacheEntry *e = storageFileCacheFind(fname, fnamei);
+  if (e) {
+    fname.c[fnamei] = (char)e->chunk;
+    addr = jsfFindFile(fname, &header);
+    if (addr) {
+      *chunk = e->chunk;
+      len = e->length;
+    }
+  }
+#endif
+  if (!addr) {
+    fname.c[fnamei] = (char)*chunk;
+    addr = jsfFindFile(fname, &header);
+  }
+  // Find the last free page (eg it has 0xFF at the end)
+  unsigned char lastCh = 255;
+  if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
+  while (addr && lastCh!=255 && *chunk<255) {
+    len += (int)jsfGetFileSize(&header);
+    (*chunk)++;
+    fname.c[fnamei] = (char)*chunk;
+    addr = jsfFindFile(fname, &header);
+    if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
+  }
+  *fileLen = addr ? jsfGetFileSize(&header) : 0;
+  *offset = 0;
+  if (addr) {
+    /* We never write 0xFF, so the chunk is data followed by 0xFF - binary
+     * search for the first 0xFF rather than reading the whole chunk */
+    uint32_t lo = 0, hi = *fileLen;
+    while (lo<hi) {
+      uint32_t mid = (lo+hi)>>1;
+      unsigned char ch;
+      jshFlashRead(&ch, addr+mid, 1);
+      if (ch==255) hi = mid;
+      else lo = mid+1;
+    }
+    *offset = (int)lo;
+  }
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+  storageFileCachePut(fname, fnamei, *chunk, len);
+#endif
+  if (length) *length = len + *offset;
+  return addr;
+}
+
 /*JSON{
   "type" : "staticmethod",
   "ifndef" : "SAVE_ON_FLASH",
@@ -481,38 +830,7 @@ JsVar *jswrap_storage_open(JsVar *name, JsVar *modeVar) {
     }
   }
   if (mode=='a') { // append
-    // Find the last free page (eg it has 0xFF at the end)
-    unsigned char lastCh = 255;
-    if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
-    while (addr && lastCh!=255 && chunk<255) {
-      chunk++;
-      fname.c[fnamei]=chunk;
-      addr = jsfFindFile(fname, &header);
-      fileLen = jsfGetFileSize(&header);
-      if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
-    }
-    if (addr) {
-      // if we have a page, try and find the end of it
-      char buf[64];
-      bool foundEnd = false;
-      while (!foundEnd) {
-        int l = fileLen - offset;
-        if (l<=0) {
-          foundEnd = true;
-          break;
-        }
-        if (l>(int)sizeof(buf)) l=(int)sizeof(buf);
-        jshFlashRead(buf, addr+offset, l);
-        for (int i=0;i<l;i++) {
-          if (buf[i]==(char)255) {
-            l = i;
-            foundEnd = true;
-            break;
-          }
-        }
-        offset += l;
-      }
-    }
+    addr = jswrap_storagefile_findEnd(fname, fnamei, &chunk, &offset, &fileLen, NULL);
     // Now 'chunk' and offset points to the last (or a free) page
   }
   if (mode=='r') {
@@ -705,8 +1023,9 @@ JsVar *jswrap_storagefile_readLine(JsVar *f) {
 }
 Return the length of the current file.
 
-This requires Espruino to read the file from scratch,
-which is not a fast operation.
+This requires Espruino to find the last chunk of the file,
+so it may not be fast for large files unless the file has
+been accessed recently.
 */
 int jswrap_storagefile_getLength(JsVar *f) {
   // Get name and position of name digit
@@ -715,46 +1034,9 @@ int jswrap_storagefile_getLength(JsVar *f) {
   jsvUnLock(n);
   int fnamei = sizeof(fname)-1;
   while (fnamei && fname.c[fnamei-1]==0) fnamei--;
-  int chunk = 1;
-  fname.c[fnamei]=chunk;
-
-  int length = 0; // actual length
-  int offset = 0; // offset in file
-  JsfFileHeader header;
-  uint32_t addr = jsfFindFile(fname, &header);
-  // Find the last free page
-  unsigned char lastCh = 255;
-  if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
-  while (addr && lastCh!=255 && chunk<255) {
-    length += jsfGetFileSize(&header);
-    chunk++;
-    fname.c[fnamei]=chunk;
-    addr = jsfFindFile(fname, &header);
-    if (addr) jshFlashRead(&lastCh, addr+jsfGetFileSize(&header)-1, 1);
-  }
-  if (addr) {
-    // if we have a page, try and find the end of it
-    char buf[64];
-    bool foundEnd = false;
-    while (!foundEnd) {
-      int l = jsfGetFileSize(&header) - offset;
-      if (l<=0) {
-        foundEnd = true;
-        break;
-      }
-      if (l>sizeof(buf)) l=sizeof(buf);
-      jshFlashRead(buf, addr+offset, l);
-      for (int i=0;i<l;i++) {
-        if (buf[i]==(char)255) {
-          l = i;
-          foundEnd = true;
-          break;
-        }
-      }
-      offset += l;
-    }
-  }
-  length += offset;
+  int chunk, offset, length;
+  uint32_t fileLen;
+  jswrap_storagefile_findEnd(fname, fnamei, &chunk, &offset, &fileLen, &length);
   return length;
 }
 
@@ -809,6 +1091,9 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
   } else {
     DBG("Write Create Chunk\n");
     if (jsfWriteFile(fname, data, JSFF_STORAGEFILE, 0, STORAGEFILE_CHUNKSIZE)) {
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+      if (chunk==1) storageFileCachePut(fname, fnamei, chunk, 0);
+#endif
       JsfFileHeader header;
       addr = jsfFindFile(fname, &header);
       fileLen = jsfGetFileSize(&header);
@@ -844,6 +1129,13 @@ void jswrap_storagefile_write(JsVar *f, JsVar *_data) {
       chunk++;
       fname.c[fnamei]=chunk;
       jsvObjectSetChildAndUnLock(f,"chunk",jsvNewFromInteger(chunk));
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+      StorageFileCacheEntry *e = storageFileCacheFind(fname, fnamei);
+      if (e && e->chunk==chunk-1) {
+        e->chunk = chunk;
+        e->length += fileLen;
+      }
+#endif
     }
     // Write Next page
     part = jsvNewFromStringVar(data,remaining,JSVAPPENDSTRINGVAR_MAXLENGTH);
@@ -879,6 +1171,9 @@ void jswrap_storagefile_erase(JsVar *f) {
   JsfFileName fname = jsfNameFromVarAndUnLock(jsvObjectGetChild(f,"name",0));
   int fnamei = sizeof(fname)-1;
   while (fnamei && fname.c[fnamei-1]==0) fnamei--;
+#if ESPR_STORAGEFILE_CACHE_SIZE>0
+  storageFileCacheClear();
+#endif
   // erase all numbered files
   int chunk = 1;
   bool ok = true;
@@ -21,12 +21,17 @@ JsVar *jswrap_storage_readJSON(JsVar *name, bool noExceptions);
 JsVar *jswrap_storage_readArrayBuffer(JsVar *name);
 bool jswrap_storage_write(JsVar *name, JsVar *data, JsVarInt offset, JsVarInt size);
 bool jswrap_storage_writeJSON(JsVar *name, JsVar *data);
+bool jswrap_storage_writeCompressed(JsVar *name, JsVar *data);
 void jswrap_storage_erase(JsVar *name);
 void jswrap_storage_compact();
+void jswrap_storage_beginBatch();
+bool jswrap_storage_commitBatch();
+void jswrap_storage_cancelBatch();
 JsVar *jswrap_storage_list(JsVar *regex, JsVar *filter);
 JsVarInt jswrap_storage_hash(JsVar *regex);
 void jswrap_storage_debug();
 int jswrap_storage_getFree();
+JsVar *jswrap_storage_getStats(bool reset);
 
 JsVar *jswrap_storage_open(JsVar *name, JsVar *mode);
 JsVar *jswrap_storagefile_read(JsVar *f, int len);
@@ -20,6 +20,7 @@
  #include <conio.h>
 #else//!__MINGW32__
  #include <sys/select.h>
+ #include <sys/mman.h>
  #include <termios.h>
  #include <fcntl.h>
 #endif//__MINGW32__
@@ -228,8 +229,11 @@ void set_conio_terminal_mode()
     tcsetattr(0, TCSANOW, &new_termios);
 }
 
+static bool stdinClosed = false; ///< stdin has hit EOF, so don't poll it any more
+
 int kbhit()
 {
+    if (stdinClosed) return 0;
     struct timeval tv = { 0L, 0L };
     fd_set fds;
     FD_ZERO(&fds);
@@ -239,13 +243,11 @@ int kbhit()
 
 int getch()
 {
-    int r;
     unsigned char c;
-    if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
-        return r;
-    } else {
-        return c;
-    }
+    int r = (int)read(STDIN_FILENO, &c, sizeof(c));
+    if (r==0) stdinClosed = true; // EOF - select will keep saying there's data
+    if (r<=0) return -1;
+    return c;
 }
 #endif//__MINGW32__
 
@@ -375,6 +377,8 @@ void jshKill() {
   // wait for thread to finish
   pthread_join(inputThread, NULL);
 
+  jshConsoleFlush();
+
   for (i=0;i<=EV_DEVICE_MAX;i++)
     if (ioDevices[i]) {
       close(ioDevices[i]);
@@ -391,7 +395,30 @@ void jshKill() {
 }
 
 void jshIdle() {
-  // all done in the thread now...
+  // all done in the thread now... apart from getting console output written
+  jshConsoleFlush();
+}
+
+// ----------------------------------------------------------------------------
+
+/* Console output goes via stdio's buffer - stdout is line buffered for
+terminals and fully buffered otherwise - and we flush it whenever we're idle.
+Writing a character at a time and flushing after each one used to make
+printing anything sizeable a system call per byte. */
+static bool consoleBuffered = true;
+
+void jshConsoleWrite(const unsigned char *data, size_t len) {
+  fwrite(data, 1, len, stdout);
+  if (!consoleBuffered) fflush(stdout);
+}
+
+void jshConsoleFlush() {
+  fflush(stdout);
+}
+
+void jshConsoleSetBuffered(bool buffered) {
+  consoleBuffered = buffered;
+  if (!buffered) fflush(stdout);
 }
 
 // ----------------------------------------------------------------------------
@@ -793,6 +820,7 @@ void jshI2CRead(IOEventFlags device, unsigned char address, int nBytes, unsigned
 
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
+  jshConsoleFlush(); // make sure any output is visible before we sleep
   bool hasWatches = false;
 #ifdef SYSFS_GPIO_DIR
   Pin pin;
@@ -877,8 +905,32 @@ static FILE *jshFlashOpenFile(bool dontCreate) {
   }
   return f;
 }
+#ifndef __MINGW32__
+/* The flash file is memory-mapped the first time it's needed (or the
+ * first time it's written, if it doesn't exist yet) so that flash accesses
+ * are just memory accesses */
+static unsigned char *jshFlashMemory = 0;
+
+static unsigned char *jshFlashGetMemory(bool dontCreate) {
+  if (jshFlashMemory) return jshFlashMemory;
+  FILE *f = jshFlashOpenFile(dontCreate);
+  if (!f) return 0;
+  void *mem = mmap(NULL, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS, PROT_READ|PROT_WRITE, MAP_SHARED, fileno(f), 0);
+  fclose(f); // the mapping stays valid
+  if (mem == MAP_FAILED) return 0;
+  jshFlashMemory = (unsigned char*)mem;
+  return jshFlashMemory;
+}
+#endif
 void jshFlashErasePage(uint32_t addr) {
   //jsDebug(DBG_VERBOSE,"FlashErasePage 0x%08x\n", addr);
+#ifndef __MINGW32__
+  unsigned char *mem = jshFlashGetMemory(true);
+  if (!mem) return; // if no file and we're erasing, we don't have to do anything
+  uint32_t startAddr, pageSize;
+  if (jshFlashGetPage(addr, &startAddr, &pageSize))
+    memset(&mem[startAddr-FLASH_START], 0xFF, pageSize);
+#else
   FILE *f = jshFlashOpenFile(true);
   if (!f) return; // if no file and we're erasing, we don't have to do anything
   uint32_t startAddr, pageSize;
@@ -891,6 +943,7 @@ void jshFlashErasePage(uint32_t addr) {
     free(buf);
   }
   fclose(f);
+#endif
 }
 void jshFlashRead(void *buf, uint32_t addr, uint32_t len) {
   //jsDebug(DBG_VERBOSE,"FlashRead 0x%08x %d\n", addr,len);
@@ -901,7 +954,16 @@ void jshFlashRead(void *buf, uint32_t addr, uint32_t len) {
     return;
   }
   addr -= FLASH_START;
+  assert(addr+len <= FLASH_TOTAL);
 
+#ifndef __MINGW32__
+  unsigned char *mem = jshFlashGetMemory(true);
+  if (!mem) { // no file, so it's all 0xFF
+    memset(buf, 0xFF, len);
+    return;
+  }
+  memcpy(buf, &mem[addr], len);
+#else
   FILE *f = jshFlashOpenFile(true);
   if (!f) { // no file, so it's all 0xFF
     memset(buf, 0xFF, len);
@@ -911,6 +973,7 @@ void jshFlashRead(void *buf, uint32_t addr, uint32_t len) {
   size_t r = fread(buf, 1, len, f);
   assert(r==len);
   fclose(f);
+#endif
 }
 void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
   //jsDebug(DBG_VERBOSE,"FlashWrite 0x%08x %d\n", addr,len);
@@ -930,7 +993,15 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
     return;
   }
   addr -= FLASH_START;
+  assert(addr+len <= FLASH_TOTAL);
 
+#ifndef __MINGW32__
+  unsigned char *mem = jshFlashGetMemory(false);
+  if (!mem) return;
+  // Like real flash, writing can only clear bits
+  for (i=0;i<len;i++)
+    mem[addr+i] &= ((unsigned char*)buf)[i];
+#else
   FILE *f = jshFlashOpenFile(false);
   if (!f) return;
 
@@ -949,11 +1020,21 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
   free(wbuf);
   //fsync(f);
   fclose(f);
+#endif
 }
 
-// No - we can't memory-map the flash memory under Linux (well, we could but for testing it's handy not to)
+/* When built with SPIFLASH_BASE we pretend flash can't be memory-mapped so
+ * that the code for Flash Strings gets tested. Otherwise return a pointer
+ * into our memory-mapped copy of flash */
 size_t jshFlashGetMemMapAddress(size_t ptr) {
+#if !defined(SPIFLASH_BASE) && !defined(__MINGW32__)
+  if (ptr<FLASH_START || ptr>=FLASH_START+FLASH_TOTAL) return 0;
+  unsigned char *mem = jshFlashGetMemory(false);
+  if (!mem) return 0;
+  return (size_t)&mem[ptr-FLASH_START];
+#else
   return 0;
+#endif
 }
 
 unsigned int jshSetSystemClock(JsVar *options) {
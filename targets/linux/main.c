@@ -322,6 +322,8 @@ void show_help() {
   warning(
       "   --telnet                Enable internal telnet server on port 2323");
 #endif
+  warning("   --unbuffered            Write console output straight away rather "
+          "than when idle");
   warning("   --test-all              Run all tests (in 'tests' directory)");
   warning("   --test-dir dir          Run all tests in directory 'dir'");
   warning("   --test test.js          Run the supplied test");
@@ -388,6 +390,8 @@ int main(int argc, char **argv) {
         jsvKill();
         jshKill();
         exit(errCode);
+      } else if (!strcmp(a, "--unbuffered")) {
+        jshConsoleSetBuffered(false);
 #ifdef USE_TELNET
       } else if (!strcmp(a, "--telnet")) {
         extern bool telnetEnabled;
@@ -0,0 +1,73 @@
+// Random access into large arrays (which may use an array index - see JSVAR_ARRAY_INDEX_THRESHOLD)
+var ok = true;
+function check(cond, msg) {
+  if (!cond) { console.log("FAIL: "+msg); ok = false; }
+}
+function make(n) {
+  var a = [];
+  for (var i=0;i<n;i++) a.push(i);
+  return a;
+}
+function isRange(a, from, n) {
+  if (a.length!=n) return false;
+  for (var i=0;i<n;i++) if (a[i]!==from+i) return false;
+  return true;
+}
+
+var a = make(200), i;
+check(isRange(a,0,200), "push");
+check(a[200]===undefined && a[-1]===undefined, "out of range");
+for (i=0;i<200;i++) a[i] = i*2;
+for (i=0;i<200;i++) check(a[i]===i*2, "assign "+i);
+a[200] = 400; // add by index
+check(a.length==201 && a[200]===400, "add by index");
+
+a = make(200);
+check(a.pop()===199 && a[199]===undefined && a[198]===198, "pop");
+a.push(199);
+check(isRange(a,0,200), "push after pop");
+check(a.shift()===0 && isRange(a,1,199), "shift");
+a.unshift(0);
+check(isRange(a,0,200), "unshift");
+a.splice(50,10);
+check(a.length==190 && a[49]===49 && a[50]===60 && a[189]===199, "splice remove");
+a.splice(50,0,50,51,52,53,54,55,56,57,58,59);
+check(isRange(a,0,200), "splice insert");
+a.reverse();
+check(a[0]===199 && a[100]===99 && a[199]===0, "reverse");
+a.sort(function(x,y) { return x-y; });
+check(isRange(a,0,200), "sort");
+
+// holes and deleted elements
+a = make(200);
+delete a[100];
+check(a[100]===undefined && a[99]===99 && a[101]===101 && a.length==200, "delete");
+a[100] = 100;
+check(isRange(a,0,200), "refill hole");
+var b = [];
+b[150] = "x";
+for (i=0;i<100;i++) b[i] = i;
+check(b[150]==="x" && b[120]===undefined && b[99]===99 && b.length==151, "sparse");
+
+// non-integer keys
+a = make(100);
+a.foo = "bar";
+check(a.foo==="bar" && a["foo"]==="bar" && isRange(a,0,100), "string key");
+a.push(100);
+check(a[100]===100 && a.length==101, "push after string key");
+
+// renumber, then free the names - they mustn't be found if they're reused in another array
+a = make(100);
+b = make(99);
+a[50];
+a.unshift(-2,-1);
+a.pop(); a.pop();
+b.push(b); // may reuse the name that was a[99]
+check(a[99]===97 && a.length==100 && b[99]===b, "reused name");
+
+// many arrays at once
+var arrs = [];
+for (i=0;i<10;i++) arrs.push(make(50+i));
+for (i=0;i<10;i++) check(isRange(arrs[i],0,50+i), "array "+i);
+
+result = ok;
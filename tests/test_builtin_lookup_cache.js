@@ -0,0 +1,76 @@
+// Built-in methods must still be overridable after they have been looked up (see JSPARSE_LOOKUP_CACHE_SIZE)
+var ok = true;
+function check(cond, msg) {
+  if (!cond) { console.log("FAIL: "+msg); ok = false; }
+}
+function lookups(n, fn) {
+  var r;
+  for (var i=0;i<n;i++) r = fn();
+  return r;
+}
+
+var a = [1,2,3];
+check(lookups(5, function() { return a.indexOf(2); })===1, "builtin indexOf");
+Array.prototype.indexOf = function() { return "mine"; };
+check(a.indexOf(2)==="mine", "Array.prototype override");
+delete Array.prototype.indexOf;
+check(a.indexOf(3)===2, "Array.prototype delete");
+
+check(lookups(5, function() { return Math.abs(-4); })===4, "Math.abs");
+Math.abs = function() { return "abs"; };
+check(Math.abs(-4)==="abs", "Math.abs override");
+delete Math.abs;
+check(Math.abs(-5)===5, "Math.abs delete");
+
+var s = "Hello";
+check(lookups(5, function() { return s.charAt(1); })==="e", "String charAt");
+String.prototype.charAt = function() { return "c"; };
+check(s.charAt(1)==="c", "String.prototype override");
+delete String.prototype.charAt;
+check(s.charAt(4)==="o", "String.prototype delete");
+
+// Object.prototype is used by everything
+var o = {x:1};
+check(lookups(5, function() { return o.hasOwnProperty("x"); })===true, "hasOwnProperty");
+Object.prototype.hasOwnProperty = function() { return "own"; };
+check(o.hasOwnProperty("x")==="own" && a.hasOwnProperty("x")==="own", "Object.prototype override");
+delete Object.prototype.hasOwnProperty;
+check(o.hasOwnProperty("x")===true, "Object.prototype delete");
+
+// changing what an object inherits from
+function Foo() {}
+Foo.prototype.toString = function() { return "Foo"; };
+function Baz() {}
+var f = new Foo();
+var p = new Baz();
+check(lookups(5, function() { return p.toString(); })==="[object Object]", "toString");
+check(f.toString()==="Foo", "Foo.toString");
+p.__proto__ = Foo.prototype;
+check(p.toString()==="Foo", "__proto__ change");
+Foo.prototype = { toString : function() { return "Bar"; } };
+check(new Foo().toString()==="Bar" && f.toString()==="Foo", "prototype replaced");
+
+// objects created and freed repeatedly, with the same prototype
+function Bar() {}
+for (var i=0;i<5;i++) {
+  var b = new Bar();
+  check(b.toString()===(i<3 ? "[object Object]" : "Bar!"), "new Bar "+i);
+  if (i==2) Bar.prototype.toString = function() { return "Bar!"; };
+  if (i>=2) check(b.toString()==="Bar!", "Bar override "+i);
+}
+
+// overriding further up a chain of prototypes
+function A() {}
+function B() {}
+B.prototype = Object.create(A.prototype);
+var bb = new B();
+check(lookups(5, function() { return bb.toString(); })==="[object Object]", "B toString");
+Object.assign(A.prototype, { toString : function() { return "A"; } });
+check(bb.toString()==="A", "A.prototype override");
+var q = {};
+var qq = Object.create(q);
+check(lookups(5, function() { return qq.hasOwnProperty("x"); })===false, "Object.create hasOwnProperty");
+Object.assign(q, { hasOwnProperty : function() { return "q"; } });
+check(qq.hasOwnProperty("x")==="q", "Object.create override");
+
+result = ok;
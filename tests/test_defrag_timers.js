@@ -0,0 +1,25 @@
+// E.defrag() with timers and watches - timerArray/watchArray are referenced from C so mustn't move
+var fired = [];
+setTimeout(function(){ fired.push("t"); }, 100);
+var iv = setInterval(function(){ fired.push("i"); }, 40);
+var long = setTimeout(function(){ fired.push("never"); }, 100000);
+var w = setWatch(function(){}, D5, {repeat:true});
+
+setTimeout(function() {
+  // leave a big gap at the start of memory so defrag moves things
+  var s = "";
+  for (var i=0;i<3000;i++) s += "ab";
+  s = undefined;
+  E.defrag();
+  setTimeout(function(){ fired.push("after"); }, 20);
+}, 1);
+
+setTimeout(function() {
+  clearInterval(iv);
+  clearTimeout(long);
+  clearWatch(w);
+  E.defrag();
+  result = fired.indexOf("t")>=0 && fired.indexOf("after")>=0 &&
+           fired.indexOf("i")>=0 && fired.indexOf("never")<0 &&
+           E.getErrorFlags().length==0;
+}, 300);
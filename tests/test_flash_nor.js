@@ -0,0 +1,30 @@
+// Flash (emulated by a file on Linux) behaves like NOR flash - writes can
+// only clear bits, and only erasing a page sets them again
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+var f = require("Flash");
+s.eraseAll();
+var area = f.getFree()[0];
+var addr = area.addr + area.length - 1024; // last page - Storage won't be using it
+var page = f.getPage(addr);
+test(page.addr, addr);
+f.erasePage(addr);
+test(f.read(4,addr).join(","), "255,255,255,255");
+f.write([0xF0,0x0F,0xAA,0x55], addr);
+test(f.read(4,addr).join(","), "240,15,170,85");
+f.write([0x0F,0xFF,0x0F,0xFF], addr);
+test(f.read(4,addr).join(","), "0,15,10,85");
+f.erasePage(addr);
+test(f.read(4,addr).join(","), "255,255,255,255");
+// Storage reads see the same data
+s.write("a","Hello World");
+test(s.read("a"), "Hello World");
+s.eraseAll();
+
+result = tests==testsPass;
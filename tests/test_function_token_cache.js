@@ -0,0 +1,43 @@
+// Functions may execute a cached tokenised copy of their code (ESPR_FUNCTION_TOKEN_CACHE)
+// Check that results and function text are unchanged by calling them
+E.setFlags({pretokenise:0}); // an earlier test may have left this on, and line numbers are checked below
+
+function sum(a) {
+  // add up all the numbers
+  var n = 0;
+  for (var i in a) n += a[i];
+  for (var j=0;j<a.length;j++) if (typeof a[j]=="string") n+=1;
+  return n;
+}
+var before = sum.toString();
+var size = E.getSizeOf(sum);
+var results = [];
+results.push(sum([1,2,3])==6);
+results.push(sum([1,2,3])==6); // second call uses the cached code
+results.push(sum([])==0);
+results.push(sum.toString()==before);
+// the tokenised copy isn't stored in the function
+results.push(E.getSizeOf(sum)==size);
+
+// errors give the position in the original code
+function err(a) {
+  var x = a;
+  return x.foo.bar;
+}
+var stacks = [];
+for (var n=0;n<2;n++) try { err(1); } catch (e) { stacks.push(e.stack); }
+results.push(stacks[1]==stacks[0] && stacks[1].indexOf("line 2 col")>=0 && stacks[1].indexOf("  return x.foo.bar;")>=0);
+
+// 'for in' where the body is never executed
+function empty() { var n=0; for (var k in {}) { n++; } return n+1; }
+results.push(empty()==1 && empty()==1);
+
+// break inside the first iteration of 'for in'
+function brk() { var n=0; for (var k in {a:1,b:2}) { n++; break; } return n; }
+results.push(brk()==1 && brk()==1);
+
+// regex/divide detection and spacing after tokenising
+function re(x) { return /a+/.test(x) ? x.length/2 : - -x; }
+results.push(re("aa")==1 && re("aa")==1 && re(3)==3);
+
+result = results.every(x=>x);
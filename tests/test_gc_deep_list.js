@@ -0,0 +1,20 @@
+// Garbage collection of structures too deep to mark recursively (see JSVAR_GC_MARK_STACK_SIZE)
+var i, node, head, count = 0, base, used, after;
+base = process.memory().usage;
+
+// doubly linked, so reference counting alone can't free it
+head = { n : 0 };
+node = head;
+for (i=1;i<2000;i++) {
+  node.next = { n : i, prev : node };
+  node = node.next;
+}
+node = undefined;
+used = process.memory().usage; // GC - but everything is still reachable
+for (node=head;node;node=node.next) if (node.n==count) count++;
+node = undefined;
+
+head = undefined;
+after = process.memory().usage;
+
+result = count==2000 && used > base+2000 && after < base+20;
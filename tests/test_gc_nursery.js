@@ -0,0 +1,22 @@
+// Short-lived garbage is freed by garbage collecting just the nursery (see JSVAR_NURSERY_SIZE)
+var i, base, after, keep = [], sum = 0;
+base = process.memory().usage;
+
+function mk(i) {
+  var o = { i : i, s : "string"+i };
+  o.self = o; // cyclic, so reference counting alone can't free it
+  return o;
+}
+// old objects that link to new ones must keep them alive
+for (i=0;i<5000;i++) {
+  var o = mk(i);
+  if (i%100==0) keep.push(o);
+}
+o = undefined;
+for (i=0;i<keep.length;i++)
+  if (keep[i].self===keep[i] && keep[i].s=="string"+keep[i].i) sum += keep[i].i;
+
+keep = undefined;
+after = process.memory().usage;
+
+result = sum==122500 && after < base+20;
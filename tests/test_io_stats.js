@@ -0,0 +1,34 @@
+// E.getIOStats - overflowing the IO queue via the loopback device
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var st = E.getIOStats(true);
+test(st.ioUsed < st.ioSize, true);
+test(st.ioSize > 0, true);
+test(st.txSize > 0, true);
+E.getErrorFlags(); // clear
+
+var data = "";
+for (var i=0;i<20;i++) data += "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmn";
+while (data.length < st.ioSize*8) data += data; // more than the queue can hold
+var got = 0;
+LoopbackB.on('data', function(d) { got += d.length; });
+LoopbackA.write(data); // this goes straight into the IO queue, so some will be lost
+test(E.getErrorFlags().indexOf("FIFO_FULL")>=0, true);
+
+setTimeout(function() {
+  st = E.getIOStats(true);
+  test(got < data.length, true);
+  if (st.dropped!==undefined) { // only with ESPR_IO_STATS
+    test(st.ioHighWater, st.ioSize-1);
+    test(st.dropped.LoopbackB, data.length-got);
+    st = E.getIOStats();
+    test(st.ioHighWater, 0);
+    test(JSON.stringify(st.dropped), "{}");
+  }
+  result = tests==testsPass;
+}, 10);
@@ -0,0 +1,26 @@
+// JSON.parse reads the string directly rather than using the lexer
+
+var r = [];
+function fails(s) {
+  try { JSON.parse(s); } catch (e) { return e instanceof SyntaxError; }
+  return false;
+}
+
+var o = JSON.parse(' { "a" : [1, -2, 3.5, -1e3, 2E-2, 0x10, true, false, null],\n "b":{"c":"d\\n\\t\\"\\\\\\u0041\\x42\\101"}, "5":"five", "":[] } ');
+r.push(o.a.length==9 && o.a[0]===1 && o.a[1]===-2 && o.a[2]===3.5 && o.a[3]===-1000 && o.a[4]===0.02);
+r.push(o.a[5]===16 && o.a[6]===true && o.a[7]===false && o.a[8]===null);
+r.push(o.b.c=="d\n\t\"\\ABA");
+r.push(o[5]=="five" && Object.keys(o).length==4 && Array.isArray(o[""]) && o[""].length==0);
+r.push(JSON.parse("'single'")=="single");
+r.push(JSON.parse("/* comment */ [1, // two\n2]").length==2);
+r.push(JSON.parse("[1,]").length==1 && JSON.parse("{\"a\":1,}").a==1); // trailing commas allowed, as before
+r.push(JSON.parse("[]").length==0 && Object.keys(JSON.parse("{}")).length==0);
+r.push(JSON.parse("1234567890123")==1234567890123);
+r.push(JSON.parse('"end" trailing')=="end");
+var big = [];
+for (var i=0;i<50;i++) big.push({n:i, s:"str"+i, l:[i,i*2]});
+r.push(JSON.stringify(JSON.parse(JSON.stringify(big)))==JSON.stringify(big));
+r.push(fails("") && fails("[1,2") && fails('{"a" 1}') && fails('"unterminated') && fails("undefined") && fails("trueish") && fails("[1 2]") && fails("/* open"));
+
+result = r.every(x=>x);
+if (!result) print(r);
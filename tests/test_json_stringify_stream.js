@@ -0,0 +1,48 @@
+// JSON can be written in chunks to Storage/streams without creating the whole string
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed: "+JSON.stringify(a)+" != "+JSON.stringify(b));
+}
+
+var s = require("Storage");
+s.eraseAll();
+var big = [];
+for (var i=0;i<40;i++) big.push({n:i, s:"string "+i, a:[i,i/2,null], t:true});
+var json = JSON.stringify(big);
+
+test(s.writeJSON("big", big), true);
+test(s.read("big"), json);
+// writing the same thing again is fine (and doesn't rewrite the file)
+var free = s.getFree();
+test(s.writeJSON("big", big), true);
+test(s.getFree(), free);
+test(s.read("big"), json);
+big[39].s = "changed";
+test(s.writeJSON("big", big), true);
+test(s.read("big"), JSON.stringify(big));
+json = JSON.stringify(big);
+test(s.write("obj", {a:1}), true);
+test(s.read("obj"), '{"a":1}');
+test(s.writeJSON("short", "x"), true);
+test(s.readJSON("short"), "x");
+
+// Any object with a 'write' method
+var chunks = [];
+var dst = { write : function(d) { chunks.push(d); } };
+test(JSON.stringifyTo(big, dst), json.length);
+test(chunks.join(""), json);
+test(chunks.every(c=>c.length<=128), true);
+chunks = [];
+JSON.stringifyTo({a:[1,2]}, dst, 2);
+test(chunks.join(""), JSON.stringify({a:[1,2]},null,2));
+// StorageFile
+JSON.stringifyTo(big, s.open("log","w"));
+test(s.open("log","r").read(100000), JSON.stringify(big));
+var threw = false;
+try { JSON.stringifyTo(big, {}); } catch (e) { threw = true; }
+test(threw, true);
+
+s.eraseAll();
+result = tests==testsPass;
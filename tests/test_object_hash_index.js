@@ -0,0 +1,49 @@
+// Lookups in objects with lots of keys (which may use a hash index - see JSVAR_HASH_INDEX_THRESHOLD)
+var ok = true;
+function check(cond, msg) {
+  if (!cond) { console.log("FAIL: "+msg); ok = false; }
+}
+
+var o = {};
+var i;
+for (i=0;i<300;i++) o["key"+i] = i;
+for (i=0;i<300;i++) check(o["key"+i]===i, "lookup key"+i);
+check(o.key299===299, "o.key299");
+check(o.nothere===undefined, "missing key");
+check(!("nothere" in o), "missing key 'in'");
+check(Object.keys(o).length==300, "300 keys");
+
+// delete every other key
+for (i=0;i<300;i+=2) delete o["key"+i];
+for (i=0;i<300;i++) check(o["key"+i]===((i&1)?i:undefined), "after delete key"+i);
+check(Object.keys(o).length==150, "150 keys");
+// add them back, with different values
+for (i=0;i<300;i+=2) o["key"+i] = -i;
+for (i=0;i<300;i++) check(o["key"+i]===((i&1)?i:-i), "after re-add key"+i);
+check(Object.keys(o)[0]=="key1" && Object.keys(o)[299]=="key298", "key order");
+// assigning to existing keys doesn't add more
+for (i=0;i<300;i++) o["key"+i] = i*2;
+check(Object.keys(o).length==300, "300 keys after assign");
+check(o.key150===300, "o.key150");
+
+// free the object and make a new one
+o = undefined;
+var p = {};
+for (i=0;i<100;i++) p["k"+i] = i;
+check(p.k50===50 && p.key50===undefined, "new object");
+Object.keys(p).forEach(function(k) { delete p[k]; });
+check(Object.keys(p).length==0 && p.k1===undefined, "all deleted");
+p.k1 = "a";
+check(p.k1==="a", "add after delete");
+
+// short and long names, and integer-like keys
+var q = {};
+for (i=0;i<100;i++) q[i] = i;
+q[""] = "empty";
+q.aVeryLongPropertyNameThatWillNeedStringExtensions = "long";
+for (i=0;i<100;i++) check(q[i]===i && q[""+i]===i, "int key "+i);
+check(q[""]==="empty", "empty key");
+check(q.aVeryLongPropertyNameThatWillNeedStringExtensions==="long", "long key");
+check(q.aVeryLongPropertyNameThatWillNeedStringExtensionz===undefined, "long key mismatch");
+
+result = ok;
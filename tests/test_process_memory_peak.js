@@ -0,0 +1,12 @@
+// process.memory() reports the peak memory use since it was last called, and the number of GCs
+var a, i, m1, m2, m3;
+m1 = process.memory();
+a = [];
+for (i=0;i<500;i++) a.push({i:i});
+a = undefined;
+m2 = process.memory();
+m3 = process.memory();
+
+result = m2.peak >= m1.usage+500 && m2.usage < m1.usage+100 && // peak includes the array we freed
+         m3.peak < m1.usage+100 && // peak was reset by the last call
+         m2.gccount == m1.gccount+1 && m3.gccount == m2.gccount+1;
@@ -0,0 +1,41 @@
+// save() with ESPR_VARIMAGE_BLOCK_SIZE only rewrites the blocks that changed,
+// and load() puts the image back together from them
+var s = require("Storage");
+
+function getBlocks() {
+  return s.list(/^\.varimg\d+$/).sort().map(function(f) { return s.read(f); });
+}
+
+// After load() we only have what was saved, so the results are kept in Storage
+function onInit() {
+  var r = s.readJSON("savetest",1);
+  if (!r) return; // called after save()
+  clearTimeout(); // don't run the steps below again
+  result = r.blocks>1 && r.changed>0 && r.changed<r.blocks &&
+           counter==2 && data.length==200 && data[199]=="item 199";
+  if (!result) console.log(r, counter);
+}
+
+s.eraseAll();
+var counter = 1;
+var data = [];
+for (var i=0;i<200;i++) data.push("item "+i);
+var before;
+
+setTimeout(function() {
+  save();
+}, 10);
+setTimeout(function() {
+  if (s.list(/^\.varimg0$/).length) // only when saving in blocks
+    before = getBlocks();
+  counter = 2;
+  save();
+}, 100);
+setTimeout(function() {
+  if (!before) { result = 1; return; }
+  var after = getBlocks();
+  var changed = after.filter(function(b,i) { return b!==before[i]; }).length;
+  s.writeJSON("savetest", { blocks : after.length, changed : changed });
+  counter = 3; // not saved, so load() should put it back to 2
+  load();
+}, 200);
@@ -0,0 +1,93 @@
+// Writing several Storage files at once with beginBatch/commitBatch
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+s.write("a", "Old A");
+s.write("b", "Old B");
+s.write("c", "Unchanged");
+var hashC = s.hash(/^c$/); // includes the address of the file
+
+s.beginBatch();
+s.write("a", "New A");
+s.write("c", "Unchanged");
+s.writeJSON("d", {x:1});
+var arr = [65,66,67];
+s.write("e", arr);
+arr[0] = 90; // changed after write - shouldn't matter
+// nothing is written until we commit
+test(s.read("a"), "Old A");
+test(s.read("d"), undefined);
+test(s.commitBatch(), true);
+test(s.read("a"), "New A");
+test(s.read("b"), "Old B");
+test(s.read("c"), "Unchanged");
+test(s.hash(/^c$/), hashC); // not rewritten
+test(JSON.stringify(s.readJSON("d")), '{"x":1}');
+test(s.read("e"), "ABC");
+test(JSON.stringify(s.list().sort()), '["a","b","c","d","e"]');
+// writes go straight to flash again after a commit
+s.write("f", "F");
+test(s.read("f"), "F");
+
+// cancelBatch throws everything away
+s.beginBatch();
+s.write("a", "Cancelled");
+s.cancelBatch();
+test(s.read("a"), "New A");
+var ok = true;
+try { s.commitBatch(); } catch (e) { ok = false; }
+test(ok, false);
+
+// Can't write part of a file in a batch
+s.beginBatch();
+ok = true;
+try { s.write("g", "Hello", 0, 10); } catch (e) { ok = false; }
+test(ok, false);
+s.cancelBatch();
+
+// If there isn't space for the whole batch, nothing changes
+var big = "";
+for (var i=0;i<16;i++) big += "0123456789abcdef";
+for (var i=0;i<7;i++) big += big; // 32k
+s.beginBatch();
+s.write("a", "Too big A");
+for (var i=0;i<9;i++) s.write("big"+i, big); // more than all of Storage
+ok = true;
+try { s.commitBatch(); } catch (e) { ok = false; }
+test(ok, false);
+test(s.read("a"), "New A");
+test(JSON.stringify(s.list().sort()), '["a","b","c","d","e","f"]');
+// but a smaller batch still works afterwards
+s.beginBatch();
+s.write("big0", big);
+s.write("b", "New B");
+test(s.commitBatch(), true);
+test(s.read("big0"), big);
+test(s.read("b"), "New B");
+s.compact();
+test(s.read("big0"), big);
+test(JSON.stringify(s.list().sort()), '["a","b","big0","c","d","e","f"]');
+
+// writeJSON in a batch always writes JSON, whatever the type
+s.beginBatch();
+s.writeJSON("arr", [1,2,3]);
+s.writeJSON("str", "hello");
+s.writeJSON("num", 42);
+s.writeJSON("obj", {a:1});
+test(s.commitBatch(), true);
+test(s.read("arr"), "[1,2,3]");
+test(JSON.stringify(s.readJSON("arr")), "[1,2,3]");
+test(s.read("str"), '"hello"');
+test(s.readJSON("str"), "hello");
+test(s.read("num"), "42");
+test(s.readJSON("num"), 42);
+test(s.readJSON("obj").a, 1);
+s.eraseAll();
+
+result = tests==testsPass;
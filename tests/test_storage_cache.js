@@ -0,0 +1,55 @@
+// Looking up lots of Storage files (and files that don't exist) while
+// creating/erasing them, so any cached addresses must stay correct.
+// The Linux build uses ESPR_STORAGE_INDEX_SIZE, which replaces the
+// ESPR_USE_STORAGE_CACHE cache - so this tests the index. To test the cache,
+// build for Linux with -DESPR_STORAGE_INDEX_SIZE=0 -DESPR_USE_STORAGE_CACHE=32
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+s.writeJSON("settings.json", {a:1});
+for (var i=0;i<40;i++) s.write("f"+i, "File "+i);
+// files that don't exist
+test(s.read("missing"), undefined);
+test(s.read("missing"), undefined);
+s.write("missing", "Now here");
+test(s.read("missing"), "Now here");
+s.erase("missing");
+test(s.read("missing"), undefined);
+// lots of different files, with one being used all the time
+var bad = 0;
+for (var j=0;j<3;j++) {
+  for (var i=0;i<40;i++) {
+    if (s.read("f"+i)!=="File "+i) bad++;
+    if (s.read("nf"+i)!==undefined) bad++;
+    if (s.readJSON("settings.json").a!==1) bad++;
+  }
+}
+test(bad, 0);
+// list fills in entries as it goes
+test(s.list(/^f/).length, 40);
+bad = 0;
+for (var i=0;i<40;i++) if (s.read("f"+i)!=="File "+i) bad++;
+test(bad, 0);
+// files moved by compaction
+for (var i=0;i<40;i+=2) s.erase("f"+i);
+s.compact();
+bad = 0;
+for (var i=0;i<40;i++) if (s.read("f"+i)!==((i&1) ? "File "+i : undefined)) bad++;
+test(bad, 0);
+// files replaced in a batch
+s.beginBatch();
+s.write("f1", "New 1");
+s.write("f0", "New 0");
+s.commitBatch();
+test(s.read("f1"), "New 1");
+test(s.read("f0"), "New 0");
+s.eraseAll();
+test(s.read("f1"), undefined);
+
+result = tests==testsPass;
@@ -0,0 +1,22 @@
+// Compacting when the last file goes right up to the end of Storage
+// must still erase the space that's freed up at the end
+var s = require("Storage");
+s.eraseAll();
+var data = "";
+for (var i=0;i<60;i++) data += "0123456789abcdef"; // 960 bytes
+var n = 0, lengths = [];
+while (s.getFree() > 100) {
+  lengths[n] = Math.min(960, s.getFree()-40);
+  s.write("f"+n, (data+n).substr(0,lengths[n]));
+  n++;
+}
+for (var i=0;i<n;i+=2) s.erase("f"+i);
+s.compact();
+// write new files into the space freed at the end
+var bad = 0;
+for (var i=0;i<20;i++) s.write("new"+i, "Hello "+i);
+for (var i=0;i<20;i++) if (s.read("new"+i)!=="Hello "+i) bad++;
+for (var i=1;i<n;i+=2) if (s.read("f"+i)!==(data+i).substr(0,lengths[i])) bad++;
+result = bad==0 && s.list().length == 20+Math.floor(n/2);
+if (!result) print(n, bad, s.list().length);
+s.eraseAll();
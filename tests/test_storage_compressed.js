@@ -0,0 +1,50 @@
+// Files written with Storage.writeCompressed, read back whole and in parts
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+var free0 = s.getFree();
+var data = "";
+for (var i=0;i<300;i++) data += "Line "+i+" of some quite compressible text\n";
+test(s.writeCompressed("comp", data), true);
+var free = s.getFree();
+test(s.read("comp"), data);
+test(s.read("comp").length, data.length);
+// reads that start and end in different blocks
+test(s.read("comp", 0, 10), data.substr(0, 10));
+test(s.read("comp", 1020, 10), data.substr(1020, 10));
+test(s.read("comp", 5000, 3000), data.substr(5000, 3000));
+test(s.read("comp", data.length-5), data.substr(data.length-5));
+test(s.read("comp", data.length+100), "");
+// it uses less space than writing it normally
+s.write("plain", data);
+test(free0-free < free-s.getFree(), true);
+test(s.read("plain"), data);
+// JSON and ArrayBuffers
+var obj = {a:[1,2,3], b:"Hello", c:data.substr(0,2000)};
+test(s.writeCompressed("json", obj), true);
+test(JSON.stringify(s.readJSON("json")), JSON.stringify(obj));
+var ab = new Uint8Array(s.readArrayBuffer("comp"));
+test(ab.length, data.length);
+test(ab[5], data.charCodeAt(5));
+// Data that doesn't compress gets written normally
+var rnd = "";
+for (var i=0;i<500;i++) rnd += String.fromCharCode(Math.random()*256);
+test(s.writeCompressed("rnd", rnd), true);
+test(s.read("rnd"), rnd);
+// Can overwrite with a normal file, and erase
+s.write("comp", "Hello");
+test(s.read("comp"), "Hello");
+test(s.writeCompressed("comp", data), true);
+test(s.read("comp", 100, 50), data.substr(100, 50));
+s.erase("comp");
+test(s.read("comp"), undefined);
+test(s.list().indexOf("json")>=0, true);
+s.eraseAll();
+
+result = tests==testsPass;
@@ -0,0 +1,46 @@
+// Appending to a long StorageFile and getting its length, with the
+// end of the file remembered between opens
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+var line = "The quick brown fox jumps over the lazy dog\n"; // 44 bytes
+var f = s.open("log","w");
+for (var i=0;i<100;i++) f.write(line);
+test(f.getLength(), 4400);
+test(s.open("log","r").getLength(), 4400);
+// reopen for append a few times
+for (var j=0;j<5;j++) {
+  f = s.open("log","a");
+  test(f.getLength(), 4400+j*440);
+  for (var i=0;i<10;i++) f.write(line);
+}
+test(s.open("log","a").getLength(), 6600);
+// check the contents are all there
+f = s.open("log","r");
+var n=0, l, bad=0;
+while ((l=f.readLine())!==undefined) { n++; if (l!=line) bad++; }
+test(n, 150);
+test(bad, 0);
+// other files don't get confused
+f = s.open("log2","a");
+test(f.getLength(), 0);
+f.write("Hello");
+test(s.open("log2","a").getLength(), 5);
+test(s.open("log","a").getLength(), 6600);
+// erase and recreate
+s.open("log","r").erase();
+test(s.open("log","a").getLength(), 0);
+f = s.open("log","a");
+f.write("Hi\n");
+test(s.open("log","a").getLength(), 3);
+s.eraseAll();
+test(s.open("log","a").getLength(), 0);
+test(s.open("log2","a").getLength(), 0);
+
+result = tests==testsPass;
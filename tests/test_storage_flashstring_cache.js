@@ -0,0 +1,48 @@
+// Flash Strings from Storage.read must see changes to flash, even if
+// the same area was read (and possibly cached) before it changed
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+// Reading a file that's only partly written, then writing the rest
+s.write("a", "Hello", 0, 14);
+test(s.read("a").substr(0,5), "Hello");
+test(s.read("a").charCodeAt(6), 255);
+s.write("a", " World!!!", 5);
+test(s.read("a"), "Hello World!!!");
+// Reading past the end of a file into empty space, then creating a file there
+s.write("b", "Before");
+test(s.read("b")+"", "Before");
+s.write("c", "After");
+test(s.read("c")+"", "After");
+// The same address used for different data
+s.eraseAll();
+s.write("x", "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA");
+test(s.read("x")+"", "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA");
+s.eraseAll();
+s.write("x", "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB");
+test(s.read("x")+"", "BBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBBB");
+// Code in a file, iterated over in different places by the lexer
+var code = "(function() { var t=0; for (var i=0;i<10;i++) { t+=i; } return t+'"+"x".repeat(200)+"'; })";
+s.write("code.js", code);
+test(eval(s.read("code.js"))(), "45"+"x".repeat(200));
+// Files moved by compaction
+var data = [];
+for (var i=0;i<20;i++) {
+  data.push(String.fromCharCode(65+i).repeat(100+i));
+  s.write("f"+i, data[i]);
+}
+for (var i=0;i<20;i++) test(s.read("f"+i)+"", data[i]);
+for (var i=0;i<20;i+=2) s.erase("f"+i);
+s.compact();
+var bad = 0;
+for (var i=1;i<20;i+=2) if (s.read("f"+i)+""!==data[i]) bad++;
+test(bad, 0);
+s.eraseAll();
+
+result = tests==testsPass;
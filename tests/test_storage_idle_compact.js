@@ -0,0 +1,27 @@
+// When Storage gets full it's compacted a bit at a time from idle, and
+// files can be read and written in between
+var s = require("Storage");
+s.eraseAll();
+var data = "";
+for (var i=0;i<60;i++) data += "0123456789abcdef"; // 960 bytes
+var free = s.getFree();
+var count = Math.floor(free / (data.length+40)) - 4; // fill it up
+for (var i=0;i<count;i++) s.write("f"+i, data+i);
+for (var i=0;i<count;i+=2) s.erase("f"+i);
+var fullFree = s.getFree();
+
+var n=0, bad=0;
+var iv = setInterval(function() {
+  // check a few files each time (comparing them all is slow enough to leave no idle time)
+  for (var i=n%8;i<count;i+=8) if (s.read("f"+i)!==((i&1)?data+i:undefined)) bad++;
+  s.write("new"+n, "hello"+n);
+  n++;
+  if (n==40) {
+    clearInterval(iv);
+    for (var i=0;i<n;i++) if (s.read("new"+i)!=="hello"+i) bad++;
+    for (var i=0;i<count;i++) if (s.read("f"+i)!==((i&1)?data+i:undefined)) bad++;
+    result = bad==0 && fullFree<16384 && s.getFree() > free/3;
+    if (!result) print(bad, fullFree, s.getFree());
+    s.eraseAll();
+  }
+}, 50);
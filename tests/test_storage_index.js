@@ -0,0 +1,51 @@
+// Finding files in Storage via the index must give the same results as scanning
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed: "+JSON.stringify(a)+" != "+JSON.stringify(b));
+}
+
+var s = require("Storage");
+s.eraseAll();
+test(s.read("a"), undefined);
+for (var i=0;i<100;i++) s.write("f"+i, "data"+i);
+test(s.read("f0"), "data0");
+test(s.read("f99"), "data99");
+test(s.read("f100"), undefined);
+// overwrite, erase, recreate
+s.write("f5", "changed");
+test(s.read("f5"), "changed");
+s.erase("f6");
+test(s.read("f6"), undefined);
+s.write("f6", "back");
+test(s.read("f6"), "back");
+s.erase("f7");
+// files written a bit at a time
+s.write("big", "Hello", 0, 11);
+s.write("big", " World", 5);
+test(s.read("big"), "Hello World");
+// compaction moves files around
+s.compact();
+test(s.read("f5"), "changed");
+test(s.read("f6"), "back");
+test(s.read("f7"), undefined);
+test(s.read("f50"), "data50");
+test(s.read("big"), "Hello World");
+var ok = true;
+for (var i=0;i<100;i++) if (i!=5 && i!=6 && i!=7 && s.read("f"+i)!=="data"+i) ok=false;
+test(ok, true);
+// StorageFile
+var f = s.open("log","w");
+for (var i=0;i<200;i++) f.write("line "+i+"\n");
+f = s.open("log","r");
+test(f.readLine(), "line 0\n");
+test(s.open("log","r").getLength(), 7*10 + 8*90 + 9*100);
+test(s.list(/^f/).length, 99);
+s.eraseAll();
+test(s.read("f0"), undefined);
+s.write("f0", "new");
+test(s.read("f0"), "new");
+
+s.eraseAll();
+result = tests==testsPass;
@@ -0,0 +1,49 @@
+// Storage.getStats
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed", a, b);
+}
+
+var s = require("Storage");
+s.eraseAll();
+var st = s.getStats(true);
+test(st.fileCount, 0);
+test(st.trashCount, 0);
+test(st.freeBytes, st.totalBytes);
+s.write("a", "Hello");
+s.write("b", "World!!!");
+s.write("a", "Hello again");
+st = s.getStats();
+test(st.fileCount, 2);
+test(st.trashCount, 1);
+test(st.fileBytes, 32+12 + 32+8); // headers + aligned data
+test(st.trashBytes, 32+8);
+test(st.totalBytes-st.freeBytes, st.fileBytes+st.trashBytes);
+var hasStats = st.written!==undefined; // only with ESPR_STORAGE_STATS
+if (hasStats) {
+  test(st.written >= 5+8+11+32*3, true);
+  test(st.compactWritten, 0);
+  s.getStats(true);
+  s.read("a"); s.read("a"); s.read("nothere");
+  st = s.getStats();
+  test(st.lookups, 3);
+  test(st.cacheHits<=st.lookups, true);
+}
+s.compact();
+if (hasStats) {
+  st = s.getStats(true);
+  test(st.compactions>0, true);
+  test(st.compactWritten>0, true);
+  test(st.erases>0, true);
+  test(st.pageErases[0]>0, true);
+  test(E.sum(st.pageErases), st.erases);
+  st = s.getStats();
+  test(st.erases, 0);
+}
+test(s.read("a"), "Hello again");
+test(s.getStats().trashCount, 0);
+s.eraseAll();
+
+result = tests==testsPass;
@@ -0,0 +1,25 @@
+// Appending to long strings uses the remembered end of the string (see JSVAR_STRING_TAIL_CACHE_SIZE)
+var i, s = "", t = "", ok = true;
+for (i=0;i<1000;i++) {
+  s += "X";
+  if (s.length != i+1) ok = false;
+}
+for (i=0;i<500;i++) t += String.fromCharCode(65+(i%26));
+s += "!";
+ok = ok && s.length==1001 && s[1000]=="!" && s.substr(998)=="XX!";
+ok = ok && t.length==500 && t[499]==String.fromCharCode(65+(499%26));
+
+// free strings and make new ones, which may reuse the same variables
+for (var j=0;j<5;j++) {
+  var a = "";
+  for (i=0;i<300;i++) a += j;
+  a += "end";
+  if (a.length!=303 || a.substr(300)!="end" || a[0]!=""+j) ok = false;
+  a = undefined;
+  var o = {};
+  o[t] = 1; // use a long string as a name
+  t += "Z";
+  if (t.length!=501+j || t[t.length-1]!="Z") ok = false;
+}
+
+result = ok;
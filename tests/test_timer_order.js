@@ -0,0 +1,42 @@
+// Timers fire in the order they are due, and still all fire when there are more
+// than fit in the heap (with ESPR_TIMER_HEAP_SIZE) so we go back to scanning
+var results = [];
+var intervals = 0, cleared = 0;
+
+function runTest(count, checkOrder, done) {
+  var got = [];
+  var delays = [];
+  /* Timers are added in a jumbled order, in groups due 60ms apart. setTimeout
+  counts from when it is called, which could be a lot later than we expect if
+  the machine is busy - so remember the earliest and latest time each timer
+  could be due, and check that no timer fires before one that must have been
+  due earlier. */
+  for (var i=0;i<count;i++) delays.push(10 + (((i*37)%count)%10)*60);
+  delays.forEach(function(d) {
+    var earliest = getTime()*1000 + d;
+    setTimeout(function() { got.push([earliest, latest]); }, d);
+    var latest = getTime()*1000 + d;
+  });
+  // a timeout that removes another timeout that's due later
+  var victim = setTimeout(function() { cleared++; }, 500);
+  setTimeout(function() { clearTimeout(victim); }, 0);
+  // an interval that changes the timers from its callback
+  var iv = setInterval(function() {
+    intervals++;
+    setTimeout(function(){}, 1);
+    if (intervals>=5) clearInterval(iv);
+  }, 3);
+  setTimeout(function() {
+    var inOrder = got.every(function(due,i) { return i==0 || got[i-1][0] <= due[1]+1; });
+    results.push(got.length==count && (inOrder || !checkOrder) && cleared==0 && intervals==5);
+    intervals = 0;
+    done();
+  }, 800);
+}
+
+runTest(50, true, function() {
+  // when scanning, timers due in the same idle loop fire in the order they were added
+  runTest(300, false, function() {
+    result = results[0] && results[1];
+  });
+});